@@ -0,0 +1,119 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Broadcasts events to BENCH_NROF_HSMS HSMs using the event bus, first from a
+ * single thread, then in parallel slices.
+ */
+
+#include "mbb/hsm.h"
+#include "mbb/bus.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "clock.inc"
+
+#define BENCH_NROF_HSMS		100000
+#define BENCH_MAX_THREADS	8
+#define BENCH_ITERATIONS	100
+
+enum {
+	BENCH_EVENT_RELOAD = MHSM_EVENT_CUSTOM
+};
+
+typedef struct {
+	uint32_t reloads;
+} bench_context_t;
+
+MHSM_DEFINE_STATE(bench_state, NULL);
+
+mhsm_state_t *bench_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	bench_context_t *ctx = (bench_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case BENCH_EVENT_RELOAD:
+			ctx->reloads++;
+			break;
+	}
+
+	return &bench_state;
+}
+
+static mhsm_hsm_t hsms[BENCH_NROF_HSMS];
+static bench_context_t contexts[BENCH_NROF_HSMS];
+static mhsm_hsm_t *subscribers[BENCH_NROF_HSMS];
+static mhsm_bus_topic_t topic;
+static mhsm_bus_t bus;
+
+typedef struct {
+	pthread_t thread;
+	size_t slice;
+	size_t nrof_slices;
+} bench_worker_t;
+
+static void *worker(void *arg)
+{
+	bench_worker_t *w = (bench_worker_t*) arg;
+	int i;
+
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		mhsm_bus_publish_slice(&bus, 0, BENCH_EVENT_RELOAD, 0, w->slice, w->nrof_slices);
+
+	return NULL;
+}
+
+int main(void)
+{
+	bench_worker_t workers[BENCH_MAX_THREADS];
+	double start;
+	size_t nrof_threads, i;
+	char name[64];
+
+	mhsm_bus_initialise(&bus, &topic, 1);
+	mhsm_bus_initialise_topic(&bus, 0, BENCH_EVENT_RELOAD, BENCH_EVENT_RELOAD, subscribers, BENCH_NROF_HSMS);
+
+	for (i = 0; i < BENCH_NROF_HSMS; i++) {
+		mhsm_initialise(hsms + i, contexts + i, &bench_state);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+		mhsm_bus_subscribe(&bus, 0, hsms + i);
+	}
+
+	start = bench_now();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		mhsm_bus_publish(&bus, BENCH_EVENT_RELOAD, 0);
+	bench_report("publish, 100k subscribers", BENCH_ITERATIONS, bench_now() - start);
+
+	for (nrof_threads = 2; nrof_threads <= BENCH_MAX_THREADS; nrof_threads *= 2) {
+		start = bench_now();
+		for (i = 0; i < nrof_threads; i++) {
+			workers[i].slice = i;
+			workers[i].nrof_slices = nrof_threads;
+			pthread_create(&workers[i].thread, NULL, worker, workers + i);
+		}
+		for (i = 0; i < nrof_threads; i++)
+			pthread_join(workers[i].thread, NULL);
+
+		snprintf(name, sizeof(name), "publish, 100k subscribers, %d threads", (int) nrof_threads);
+		bench_report(name, BENCH_ITERATIONS, bench_now() - start);
+	}
+
+	return EXIT_SUCCESS;
+}
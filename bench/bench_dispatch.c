@@ -0,0 +1,112 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures dispatching events to an HSM of three nested states, handled
+ * events alternating with sibling transitions. Built twice: bench_dispatch is
+ * linked to libmbb.a, bench_dispatch_inline includes the header-only build of
+ * mbb/mbb.h, letting the compiler inline the dispatching functions.
+ */
+
+#ifdef BENCH_INLINE
+# define MBB_IMPLEMENTATION
+# define MBB_STATIC
+# include "mbb/mbb.h"
+# define BENCH_BUILD "header-only"
+#else
+# include "mbb/hsm.h"
+# define BENCH_BUILD "libmbb.a"
+#endif
+#include <stdlib.h>
+
+#include "clock.inc"
+
+#define BENCH_ITERATIONS	10000000UL
+
+enum {
+	BENCH_EVENT_PING = MHSM_EVENT_CUSTOM,
+	BENCH_EVENT_TOGGLE
+};
+
+static unsigned long pings;
+
+MHSM_DEFINE_STATE(top, NULL);
+MHSM_DEFINE_STATE(a, &top);
+MHSM_DEFINE_STATE(a1, &a);
+MHSM_DEFINE_STATE(a2, &a);
+
+mhsm_state_t *top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	if (event.id == MHSM_EVENT_INITIAL)
+		return &a;
+
+	return &top;
+}
+
+mhsm_state_t *a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	if (event.id == MHSM_EVENT_INITIAL)
+		return &a1;
+
+	return &a;
+}
+
+mhsm_state_t *a1_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case BENCH_EVENT_PING:
+			pings++;
+			return MHSM_HANDLED;
+		case BENCH_EVENT_TOGGLE:
+			return &a2;
+	}
+
+	return &a1;
+}
+
+mhsm_state_t *a2_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case BENCH_EVENT_PING:
+			pings++;
+			return MHSM_HANDLED;
+		case BENCH_EVENT_TOGGLE:
+			return &a1;
+	}
+
+	return &a2;
+}
+
+int main(void)
+{
+	mhsm_hsm_t hsm;
+	unsigned long i;
+	double start;
+
+	mhsm_initialise(&hsm, NULL, &top);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		mhsm_dispatch_event(&hsm, i % 4 == 3 ? BENCH_EVENT_TOGGLE : BENCH_EVENT_PING);
+	bench_report("dispatch (" BENCH_BUILD ")", BENCH_ITERATIONS, bench_now() - start);
+
+	return pings > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
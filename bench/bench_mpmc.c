@@ -0,0 +1,190 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Passes events from 1 to BENCH_MAX_THREADS producer threads to as many
+ * consumer threads, through an MQUE queue protected by a mutex and through an
+ * MMPMC queue.
+ */
+
+#include "mbb/queue.h"
+#include "mbb/mpmc.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "clock.inc"
+
+#define BENCH_NROF_EVENTS	4000000UL
+#define BENCH_CAPACITY		1024
+#define BENCH_MAX_THREADS	4
+
+static MQUE_DEFINE_STRUCT(uint32_t, BENCH_CAPACITY) locked_queue = MQUE_INITIALISER;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static MMPMC_DEFINE_STRUCT(uint32_t, BENCH_CAPACITY) queue;
+static unsigned long events_per_producer;
+static int done;
+static unsigned long sum;
+
+static void *locked_producer(void *arg)
+{
+	unsigned long i = 0;
+
+	(void) arg;
+
+	while (i < events_per_producer) {
+		bool full;
+
+		pthread_mutex_lock(&lock);
+		full = MQUE_IS_FULL(&locked_queue);
+		if (!full)
+			MQUE_ENQUEUE(&locked_queue, (uint32_t) i++);
+		pthread_mutex_unlock(&lock);
+
+		if (full) sched_yield();
+	}
+
+	return NULL;
+}
+
+static void *locked_consumer(void *arg)
+{
+	unsigned long partial = 0;
+
+	(void) arg;
+
+	for (;;) {
+		int finished = __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+		bool empty;
+
+		pthread_mutex_lock(&lock);
+		empty = MQUE_IS_EMPTY(&locked_queue);
+		if (!empty) {
+			partial += MQUE_HEAD(&locked_queue);
+			MQUE_DEQUEUE(&locked_queue);
+		}
+		pthread_mutex_unlock(&lock);
+
+		if (empty) {
+			if (finished) break;
+			sched_yield();
+		}
+	}
+
+	__atomic_fetch_add(&sum, partial, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+static void *producer(void *arg)
+{
+	unsigned long i = 0;
+
+	(void) arg;
+
+	while (i < events_per_producer) {
+		bool ok;
+
+		MMPMC_TRY_ENQUEUE(&queue, (uint32_t) i, ok);
+		if (ok)
+			i++;
+		else
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	unsigned long partial = 0;
+
+	(void) arg;
+
+	for (;;) {
+		int finished = __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+		uint32_t event;
+		bool ok;
+
+		MMPMC_TRY_DEQUEUE(&queue, event, ok);
+		if (ok) {
+			partial += event;
+		} else {
+			if (finished) break;
+			sched_yield();
+		}
+	}
+
+	__atomic_fetch_add(&sum, partial, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+static int run(const char *name, size_t nrof_threads,
+		void *(*produce)(void*), void *(*consume)(void*))
+{
+	pthread_t producers[BENCH_MAX_THREADS], consumers[BENCH_MAX_THREADS];
+	unsigned long expected;
+	double start;
+	char label[64];
+	size_t i;
+
+	events_per_producer = BENCH_NROF_EVENTS / nrof_threads;
+	expected = nrof_threads * ((events_per_producer - 1) * events_per_producer / 2);
+	done = 0;
+	sum = 0;
+
+	start = bench_now();
+	for (i = 0; i < nrof_threads; i++) {
+		pthread_create(consumers + i, NULL, consume, NULL);
+		pthread_create(producers + i, NULL, produce, NULL);
+	}
+	for (i = 0; i < nrof_threads; i++)
+		pthread_join(producers[i], NULL);
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < nrof_threads; i++)
+		pthread_join(consumers[i], NULL);
+
+	snprintf(label, sizeof(label), "%s, %d:%d threads", name, (int) nrof_threads, (int) nrof_threads);
+	bench_report(label, nrof_threads * events_per_producer, bench_now() - start);
+
+	if (sum == expected)
+		return 0;
+
+	fprintf(stderr, "checksum mismatch: %lu != %lu\n", sum, expected);
+
+	return -1;
+}
+
+int main(void)
+{
+	size_t nrof_threads;
+
+	for (nrof_threads = 1; nrof_threads <= BENCH_MAX_THREADS; nrof_threads *= 2) {
+		if (run("mutex, MQUE", nrof_threads, locked_producer, locked_consumer) != 0)
+			return EXIT_FAILURE;
+
+		MMPMC_INITIALISE(&queue);
+		if (run("MMPMC", nrof_threads, producer, consumer) != 0)
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares greedy and consuming event propagation in a hierarchy of
+ * BENCH_DEPTH nested states. The innermost state handles the event.
+ */
+
+#include "mbb/hsm.h"
+#include <stdlib.h>
+
+#include "clock.inc"
+
+#define BENCH_DEPTH		8
+#define BENCH_ITERATIONS	10000000UL
+
+enum {
+	BENCH_EVENT_PING = MHSM_EVENT_CUSTOM
+};
+
+static unsigned long handler_calls;
+
+MHSM_DEFINE_STATE(s0, NULL);
+MHSM_DEFINE_STATE(s1, &s0);
+MHSM_DEFINE_STATE(s2, &s1);
+MHSM_DEFINE_STATE(s3, &s2);
+MHSM_DEFINE_STATE(s4, &s3);
+MHSM_DEFINE_STATE(s5, &s4);
+MHSM_DEFINE_STATE(s6, &s5);
+MHSM_DEFINE_STATE(s7, &s6);
+
+#define BENCH_COMPOSITE_FUN(STATE, SUBSTATE) \
+mhsm_state_t *STATE##_fun(mhsm_hsm_t *hsm, mhsm_event_t event) \
+{ \
+	handler_calls++; \
+	if (event.id == MHSM_EVENT_INITIAL) \
+		return &SUBSTATE; \
+	return &STATE; \
+}
+
+BENCH_COMPOSITE_FUN(s0, s1)
+BENCH_COMPOSITE_FUN(s1, s2)
+BENCH_COMPOSITE_FUN(s2, s3)
+BENCH_COMPOSITE_FUN(s3, s4)
+BENCH_COMPOSITE_FUN(s4, s5)
+BENCH_COMPOSITE_FUN(s5, s6)
+BENCH_COMPOSITE_FUN(s6, s7)
+
+mhsm_state_t *s7_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	handler_calls++;
+
+	switch (event.id) {
+		case BENCH_EVENT_PING:
+			return MHSM_HANDLED;
+	}
+
+	return &s7;
+}
+
+static void run(const char *name, uint8_t mode)
+{
+	mhsm_hsm_t hsm;
+	unsigned long i;
+	double start;
+
+	mhsm_initialise(&hsm, NULL, &s0);
+	mhsm_set_propagation(&hsm, mode);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	handler_calls = 0;
+	start = bench_now();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		mhsm_dispatch_event(&hsm, BENCH_EVENT_PING);
+	bench_report(name, BENCH_ITERATIONS, bench_now() - start);
+	printf("%-40s %12.2f handler calls/event\n", "", (double) handler_calls / BENCH_ITERATIONS);
+}
+
+int main(void)
+{
+	printf("hierarchy depth: %d\n", BENCH_DEPTH);
+	run("greedy propagation", MHSM_PROPAGATION_GREEDY);
+	run("consuming propagation", MHSM_PROPAGATION_CONSUME);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Replays recorded event traces into session HSMs registered by key.
+ *
+ *   bench_replay                       record synthetic traffic, replay it
+ *   bench_replay record TRACE          record synthetic traffic into TRACE
+ *   bench_replay replay TRACE [SPEED]  replay TRACE, as fast as possible if
+ *                                      SPEED is 0 (default), at the original
+ *                                      pace if SPEED is 1
+ *
+ * The checksum printed after replaying depends on the final states and
+ * contexts of all HSMs only, so it can be compared between versions.
+ */
+
+#include "mbb/hsm.h"
+#include "mbb/registry.h"
+#include "mbb/trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.inc"
+
+#define BENCH_NROF_SESSIONS	10000
+#define BENCH_NROF_SHARDS	4
+#define BENCH_ENTRIES_PER_SHARD	8192
+#define BENCH_NROF_EVENTS	2000000UL
+
+enum {
+	BENCH_EVENT_CONNECT = MHSM_EVENT_CUSTOM,
+	BENCH_EVENT_REQUEST,
+	BENCH_EVENT_RESPONSE,
+	BENCH_EVENT_DISCONNECT
+};
+
+typedef struct {
+	uint32_t requests;
+	uint32_t bytes;
+} bench_context_t;
+
+MHSM_DEFINE_STATE(bench_idle, NULL);
+MHSM_DEFINE_STATE(bench_connected, NULL);
+MHSM_DEFINE_STATE(bench_ready, &bench_connected);
+MHSM_DEFINE_STATE(bench_busy, &bench_connected);
+
+mhsm_state_t *bench_idle_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case BENCH_EVENT_CONNECT:
+			return &bench_connected;
+	}
+
+	return &bench_idle;
+}
+
+mhsm_state_t *bench_connected_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &bench_ready;
+		case BENCH_EVENT_DISCONNECT:
+			return &bench_idle;
+	}
+
+	return &bench_connected;
+}
+
+mhsm_state_t *bench_ready_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	bench_context_t *ctx = (bench_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case BENCH_EVENT_REQUEST:
+			ctx->requests++;
+			return &bench_busy;
+	}
+
+	return &bench_ready;
+}
+
+mhsm_state_t *bench_busy_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	bench_context_t *ctx = (bench_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case BENCH_EVENT_REQUEST:
+			/* one request at a time */
+			return NULL;
+		case BENCH_EVENT_RESPONSE:
+			ctx->bytes += event.arg;
+			return &bench_ready;
+	}
+
+	return &bench_busy;
+}
+
+static mhsm_registry_shard_t shards[BENCH_NROF_SHARDS];
+static mhsm_registry_entry_t entries[BENCH_NROF_SHARDS * BENCH_ENTRIES_PER_SHARD];
+static mhsm_hsm_t hsms[BENCH_NROF_SESSIONS];
+static bench_context_t contexts[BENCH_NROF_SESSIONS];
+static mhsm_registry_t registry;
+
+static void setup(void)
+{
+	uint64_t key;
+
+	mhsm_registry_initialise(&registry, shards, BENCH_NROF_SHARDS, entries, BENCH_ENTRIES_PER_SHARD);
+	memset(contexts, 0, sizeof(contexts));
+
+	for (key = 0; key < BENCH_NROF_SESSIONS; key++) {
+		mhsm_initialise(hsms + key, contexts + key, &bench_idle);
+		mhsm_dispatch_event(hsms + key, MHSM_EVENT_INITIAL);
+		mhsm_registry_insert(&registry, key, hsms + key);
+	}
+}
+
+static unsigned long checksum(void)
+{
+	unsigned long sum = 0;
+	size_t i;
+
+	for (i = 0; i < BENCH_NROF_SESSIONS; i++)
+		sum = sum * 31 + contexts[i].requests * 7 + contexts[i].bytes
+			+ (mhsm_current_state(hsms + i) == &bench_busy);
+
+	return sum;
+}
+
+/* random traffic, mostly requests and responses of connected sessions */
+static int record(FILE *file)
+{
+	mhsm_trace_recorder_t recorder;
+	unsigned long seed = 42;
+	unsigned long i;
+	uint64_t key;
+	uint32_t r;
+
+	setup();
+	if (mhsm_trace_open_recorder(&recorder, file) != 0)
+		return -1;
+	mhsm_registry_set_hook(&registry, mhsm_trace_hook, &recorder);
+
+	for (i = 0; i < BENCH_NROF_EVENTS; i++) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		r = (uint32_t) (seed >> 33);
+		key = r % BENCH_NROF_SESSIONS;
+
+		if (mhsm_is_in(hsms + key, &bench_idle))
+			mhsm_registry_dispatch(&registry, key, BENCH_EVENT_CONNECT, 0);
+		else if (r % 100 == 0)
+			mhsm_registry_dispatch(&registry, key, BENCH_EVENT_DISCONNECT, 0);
+		else if (r % 2)
+			mhsm_registry_dispatch(&registry, key, BENCH_EVENT_REQUEST, 0);
+		else
+			mhsm_registry_dispatch(&registry, key, BENCH_EVENT_RESPONSE, r % 1500);
+	}
+
+	printf("recorded %lu events, checksum %lx\n", (unsigned long) recorder.nrof_records, checksum());
+
+	return recorder.error ? -1 : 0;
+}
+
+static int replay(FILE *file, double speed)
+{
+	mhsm_trace_reader_t reader;
+	double start;
+	long n;
+
+	setup();
+	if (mhsm_trace_open_reader(&reader, file) != 0)
+		return -1;
+
+	start = bench_now();
+	n = mhsm_trace_replay(&reader, &registry, speed);
+	if (n < 0)
+		return -1;
+	bench_report(speed > 0 ? "replay, paced" : "replay", n, bench_now() - start);
+	printf("skipped %lu events, checksum %lx\n", (unsigned long) reader.skipped, checksum());
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *file;
+	int ret;
+
+	if (argc == 1) {
+		file = tmpfile();
+		if (file == NULL || record(file) != 0)
+			return EXIT_FAILURE;
+		rewind(file);
+		ret = replay(file, 0);
+	} else if (argc == 3 && strcmp(argv[1], "record") == 0) {
+		file = fopen(argv[2], "wb");
+		if (file == NULL)
+			return EXIT_FAILURE;
+		ret = record(file);
+	} else if ((argc == 3 || argc == 4) && strcmp(argv[1], "replay") == 0) {
+		file = fopen(argv[2], "rb");
+		if (file == NULL)
+			return EXIT_FAILURE;
+		ret = replay(file, argc == 4 ? atof(argv[3]) : 0);
+	} else {
+		fprintf(stderr, "usage: %s [record TRACE | replay TRACE [SPEED]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fclose(file);
+
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
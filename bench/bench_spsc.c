@@ -0,0 +1,165 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Hands events from a producer thread to a consumer thread, through an MQUE
+ * queue protected by a mutex and through an MSPSC queue, publishing single
+ * events and batches.
+ */
+
+#include "mbb/queue.h"
+#include "mbb/spsc.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "clock.inc"
+
+#define BENCH_NROF_EVENTS	10000000UL
+#define BENCH_CAPACITY		1024
+#define BENCH_BATCH		32
+
+static MQUE_DEFINE_STRUCT(uint32_t, BENCH_CAPACITY) locked_queue = MQUE_INITIALISER;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static MSPSC_DEFINE_STRUCT(uint32_t, BENCH_CAPACITY) queue = MSPSC_INITIALISER;
+static size_t batch;
+
+static void *locked_producer(void *arg)
+{
+	unsigned long i = 0;
+
+	(void) arg;
+
+	while (i < BENCH_NROF_EVENTS) {
+		pthread_mutex_lock(&lock);
+		while (i < BENCH_NROF_EVENTS && !MQUE_IS_FULL(&locked_queue))
+			MQUE_ENQUEUE(&locked_queue, (uint32_t) i++);
+		pthread_mutex_unlock(&lock);
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+static unsigned long locked_consume(void)
+{
+	unsigned long n = 0, sum = 0;
+
+	while (n < BENCH_NROF_EVENTS) {
+		pthread_mutex_lock(&lock);
+		while (!MQUE_IS_EMPTY(&locked_queue)) {
+			sum += MQUE_HEAD(&locked_queue);
+			MQUE_DEQUEUE(&locked_queue);
+			n++;
+		}
+		pthread_mutex_unlock(&lock);
+		sched_yield();
+	}
+
+	return sum;
+}
+
+static void *producer(void *arg)
+{
+	unsigned long i = 0;
+	size_t staged = 0;
+
+	(void) arg;
+
+	while (i < BENCH_NROF_EVENTS) {
+		if (MSPSC_IS_FULL(&queue)) {
+			MSPSC_PUBLISH(&queue);
+			staged = 0;
+			sched_yield();
+			continue;
+		}
+
+		MSPSC_STAGE(&queue, (uint32_t) i++);
+
+		if (++staged == batch) {
+			MSPSC_PUBLISH(&queue);
+			staged = 0;
+		}
+	}
+
+	MSPSC_PUBLISH(&queue);
+
+	return NULL;
+}
+
+static unsigned long consume(void)
+{
+	unsigned long n = 0, sum = 0;
+
+	while (n < BENCH_NROF_EVENTS) {
+		if (MSPSC_IS_EMPTY(&queue)) {
+			sched_yield();
+			continue;
+		}
+
+		sum += MSPSC_HEAD(&queue);
+		MSPSC_DEQUEUE(&queue);
+		n++;
+	}
+
+	return sum;
+}
+
+static int check(unsigned long sum)
+{
+	unsigned long expected = (BENCH_NROF_EVENTS - 1) * BENCH_NROF_EVENTS / 2;
+
+	if (sum == expected)
+		return 0;
+
+	fprintf(stderr, "checksum mismatch: %lu != %lu\n", sum, expected);
+
+	return -1;
+}
+
+int main(void)
+{
+	pthread_t thread;
+	unsigned long sum;
+	double start;
+	char name[64];
+
+	start = bench_now();
+	pthread_create(&thread, NULL, locked_producer, NULL);
+	sum = locked_consume();
+	pthread_join(thread, NULL);
+	bench_report("mutex, MQUE", BENCH_NROF_EVENTS, bench_now() - start);
+	if (check(sum) != 0) return EXIT_FAILURE;
+
+	for (batch = 1; batch <= BENCH_BATCH; batch *= BENCH_BATCH) {
+		MSPSC_INITIALISE(&queue);
+
+		start = bench_now();
+		pthread_create(&thread, NULL, producer, NULL);
+		sum = consume();
+		pthread_join(thread, NULL);
+
+		snprintf(name, sizeof(name), "MSPSC, batches of %d", (int) batch);
+		bench_report(name, BENCH_NROF_EVENTS, bench_now() - start);
+		if (check(sum) != 0) return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs BENCH_NROF_HSMS HSMs restarting a timer with a random period on every
+ * timeout for ten simulated seconds, ticking in steps of 1 ms. The periodic
+ * backend scans all timers of all HSMs on every tick, the simulation backend
+ * only looks at the earliest deadline of its heap.
+ */
+
+#include "mbb/hsm.h"
+#include "mbb/timer_periodic.h"
+#include "mbb/timer_sim.h"
+#include <stdlib.h>
+
+#include "clock.inc"
+
+#define BENCH_NROF_HSMS		10000
+#define BENCH_DURATION		(10 * MTMR_ONE_SEC)
+
+enum {
+	BENCH_EVENT_TIMEOUT = MHSM_EVENT_CUSTOM
+};
+
+typedef struct {
+	/* the context must start with the timers of either backend */
+	union {
+		mtmr_prd_t prd[MTMR_NROF_TIMERS(BENCH_EVENT_TIMEOUT)];
+		mtmr_sim_t sim[MTMR_NROF_TIMERS(BENCH_EVENT_TIMEOUT)];
+	} timers;
+	uint32_t period;
+	unsigned long timeouts;
+} bench_context_t;
+
+MHSM_DEFINE_STATE(bench_state, NULL);
+
+mhsm_state_t *bench_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	bench_context_t *ctx = (bench_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case BENCH_EVENT_TIMEOUT:
+			ctx->timeouts++;
+			/* fall through */
+		case MHSM_EVENT_ENTRY:
+			mhsm_start_timer(hsm, BENCH_EVENT_TIMEOUT, ctx->period);
+			break;
+	}
+
+	return &bench_state;
+}
+
+static mhsm_hsm_t hsms[BENCH_NROF_HSMS];
+static bench_context_t contexts[BENCH_NROF_HSMS];
+static mtmr_sim_t *heap[BENCH_NROF_HSMS];
+
+static void initialise(void)
+{
+	size_t i;
+
+	srand(1);
+
+	for (i = 0; i < BENCH_NROF_HSMS; i++) {
+		contexts[i].period = 1 + rand() % MTMR_ONE_SEC;
+		contexts[i].timeouts = 0;
+		mhsm_initialise(hsms + i, contexts + i, &bench_state);
+	}
+}
+
+static unsigned long timeouts(void)
+{
+	unsigned long sum = 0;
+	size_t i;
+
+	for (i = 0; i < BENCH_NROF_HSMS; i++)
+		sum += contexts[i].timeouts;
+
+	return sum;
+}
+
+int main(void)
+{
+	mtmr_sim_clock_t clock;
+	unsigned long msecs, prd_timeouts;
+	double start;
+	size_t i;
+
+	initialise();
+	for (i = 0; i < BENCH_NROF_HSMS; i++) {
+		mtmr_prd_initialise_timers(hsms + i, MTMR_NROF_TIMERS(BENCH_EVENT_TIMEOUT));
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+	}
+
+	start = bench_now();
+	for (msecs = 0; msecs < BENCH_DURATION; msecs++)
+		for (i = 0; i < BENCH_NROF_HSMS; i++)
+			mtmr_prd_increment_timers(hsms + i, MTMR_NROF_TIMERS(BENCH_EVENT_TIMEOUT), 1);
+	bench_report("periodic, 10k timers, per 1 ms tick", BENCH_DURATION, bench_now() - start);
+	prd_timeouts = timeouts();
+
+	initialise();
+	mtmr_sim_initialise_clock(&clock, heap, BENCH_NROF_HSMS);
+	for (i = 0; i < BENCH_NROF_HSMS; i++) {
+		mtmr_sim_initialise_timers(hsms + i, MTMR_NROF_TIMERS(BENCH_EVENT_TIMEOUT), &clock);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+	}
+
+	start = bench_now();
+	for (msecs = 0; msecs < BENCH_DURATION; msecs++)
+		mtmr_sim_advance(&clock, 1);
+	bench_report("heap, 10k timers, per 1 ms tick", BENCH_DURATION, bench_now() - start);
+
+	if (timeouts() != prd_timeouts) {
+		fprintf(stderr, "timeouts differ: %lu != %lu\n", timeouts(), prd_timeouts);
+		return EXIT_FAILURE;
+	}
+
+	printf("timeouts: %lu\n", prd_timeouts);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "async.h"
+#include "types.h"
+#include "queue.h"
+#include "hsm.h"
+#include "debug.h"
+#ifdef MHSM_LATENCY
+# include "clock.h"
+#endif
+
+static void _lock(mhsm_async_loop_t *loop)
+{
+	if (loop->lock != NULL)
+		loop->lock(loop->hook_arg);
+}
+
+static void _unlock(mhsm_async_loop_t *loop)
+{
+	if (loop->unlock != NULL)
+		loop->unlock(loop->hook_arg);
+}
+
+void mhsm_async_initialise_loop(mhsm_async_loop_t *loop)
+{
+	MQUE_INITIALISE(&loop->completions);
+	loop->lock = NULL;
+	loop->unlock = NULL;
+	loop->notify = NULL;
+	loop->hook_arg = NULL;
+}
+
+void mhsm_async_set_hooks(mhsm_async_loop_t *loop, void (*lock)(void*), void (*unlock)(void*), void (*notify)(void*), void *arg)
+{
+	loop->lock = lock;
+	loop->unlock = unlock;
+	loop->notify = notify;
+	loop->hook_arg = arg;
+}
+
+int mhsm_async_run(mhsm_async_loop_t *loop)
+{
+	mhsm_async_completion_t completion;
+	mhsm_async_t *operation;
+	int ndispatched = 0;
+
+	while (1) {
+		_lock(loop);
+		if (MQUE_IS_EMPTY(&loop->completions)) {
+			_unlock(loop);
+			break;
+		}
+		completion = MQUE_HEAD(&loop->completions);
+		MQUE_DEQUEUE(&loop->completions);
+		_unlock(loop);
+
+		operation = completion.operation;
+
+		/* drop completions of cancelled or restarted operations */
+		if (!operation->pending || operation->token != completion.token) {
+			MDBG_PRINT2("dropping stale completion (%d, %d)\n", (int) operation->event_id, (int) completion.result);
+			continue;
+		}
+
+		operation->pending = 0;
+		mhsm_dispatch_posted_event(operation->hsm, operation->event_id, completion.result, completion.posted);
+		ndispatched++;
+	}
+
+	return ndispatched;
+}
+
+void mhsm_async_initialise(mhsm_async_t *operation, mhsm_async_loop_t *loop, mhsm_hsm_t *hsm, uint32_t event_id)
+{
+	operation->loop = loop;
+	operation->hsm = hsm;
+	operation->event_id = event_id;
+	operation->token = 0;
+	operation->pending = 0;
+}
+
+uint32_t mhsm_async_start(mhsm_async_t *operation)
+{
+	/* a pending operation is superseded */
+	operation->token++;
+	operation->pending = 1;
+
+	return operation->token;
+}
+
+void mhsm_async_cancel(mhsm_async_t *operation)
+{
+	operation->pending = 0;
+}
+
+bool mhsm_async_is_pending(mhsm_async_t *operation)
+{
+	return operation->pending;
+}
+
+int mhsm_async_complete(mhsm_async_t *operation, uint32_t token, int32_t result)
+{
+	mhsm_async_loop_t *loop = operation->loop;
+	mhsm_async_completion_t completion;
+
+	completion.operation = operation;
+	completion.token = token;
+	completion.result = result;
+#ifdef MHSM_LATENCY
+	completion.posted = MCLK_NOW();
+#else
+	completion.posted = 0;
+#endif
+
+	_lock(loop);
+	if (MQUE_IS_FULL(&loop->completions)) {
+		_unlock(loop);
+		MDBG_PRINT_LN("completion queue too short");
+		return -1;
+	}
+	MQUE_ENQUEUE(&loop->completions, completion);
+	_unlock(loop);
+
+	if (loop->notify != NULL)
+		loop->notify(loop->hook_arg);
+
+	return 0;
+}
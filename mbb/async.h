@@ -0,0 +1,77 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_ASYNC_H
+#define MBB_ASYNC_H
+
+#include "types.h"
+#include "queue.h"
+#include "hsm.h"
+
+/* 
+ * Asynchronous operations started by event processing functions.
+ *
+ * The completion of an operation is delivered to its HSM as an event by
+ * mhsm_async_run(), which is called by the thread dispatching the HSM's
+ * events. mhsm_async_complete() may be called from any thread if lock hooks
+ * are set.
+ */
+
+#ifndef MHSM_ASYNC_QUEUE_LENGTH
+# define MHSM_ASYNC_QUEUE_LENGTH 32
+#endif
+
+typedef struct mhsm_async_loop_s mhsm_async_loop_t;
+
+typedef struct {
+	mhsm_async_loop_t *loop;
+	mhsm_hsm_t *hsm;
+	uint32_t event_id;
+	uint32_t token;
+	bool pending;
+} mhsm_async_t;
+
+typedef struct {
+	mhsm_async_t *operation;
+	uint32_t token;
+	int32_t result;
+	/* MCLK_NOW() at completion if MHSM_LATENCY is defined, 0 otherwise */
+	uint64_t posted;
+} mhsm_async_completion_t;
+
+struct mhsm_async_loop_s {
+	MQUE_DEFINE_STRUCT(mhsm_async_completion_t, MHSM_ASYNC_QUEUE_LENGTH) completions;
+	void (*lock)(void *arg);
+	void (*unlock)(void *arg);
+	void (*notify)(void *arg);
+	void *hook_arg;
+};
+
+void mhsm_async_initialise_loop(mhsm_async_loop_t *loop);
+void mhsm_async_set_hooks(mhsm_async_loop_t *loop, void (*lock)(void*), void (*unlock)(void*), void (*notify)(void*), void *arg);
+int mhsm_async_run(mhsm_async_loop_t *loop);
+
+void mhsm_async_initialise(mhsm_async_t *operation, mhsm_async_loop_t *loop, mhsm_hsm_t *hsm, uint32_t event_id);
+uint32_t mhsm_async_start(mhsm_async_t *operation);
+void mhsm_async_cancel(mhsm_async_t *operation);
+bool mhsm_async_is_pending(mhsm_async_t *operation);
+int mhsm_async_complete(mhsm_async_t *operation, uint32_t token, int32_t result);
+
+#endif /* MBB_ASYNC_H */
@@ -0,0 +1,182 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bus.h"
+#include "types.h"
+#include "hsm.h"
+#include "debug.h"
+
+static int _publish_range(mhsm_bus_topic_t *topic, uint32_t id, int32_t arg, size_t first, size_t last)
+{
+	mhsm_hsm_t **subscribers = topic->subscribers;
+	int ret = 0;
+	size_t i;
+
+	for (i = first; i < last; i++)
+		if (subscribers[i] != NULL && mhsm_dispatch_event_arg(subscribers[i], id, arg) != 0)
+			ret = -1;
+
+	return ret;
+}
+
+/* remove the subscribers unsubscribed during a publish, keeping their order */
+static void _compact(mhsm_bus_topic_t *topic)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < topic->count; i++)
+		if (topic->subscribers[i] != NULL)
+			topic->subscribers[n++] = topic->subscribers[i];
+
+	topic->count = n;
+	topic->unsubscribed = 0;
+}
+
+/* handlers may unsubscribe any subscriber, the removal is deferred until the publish ends */
+static int _publish_topic(mhsm_bus_topic_t *topic, uint32_t id, int32_t arg)
+{
+	int ret;
+
+	topic->publishing++;
+	ret = _publish_range(topic, id, arg, 0, topic->count);
+	if (--topic->publishing == 0 && topic->unsubscribed)
+		_compact(topic);
+
+	return ret;
+}
+
+void mhsm_bus_initialise(mhsm_bus_t *bus, mhsm_bus_topic_t *topics, size_t nrof_topics)
+{
+	size_t i;
+
+	bus->topics = topics;
+	bus->nrof_topics = nrof_topics;
+
+	for (i = 0; i < nrof_topics; i++)
+		mhsm_bus_initialise_topic(bus, i, 0, 0, NULL, 0);
+}
+
+void mhsm_bus_initialise_topic(mhsm_bus_t *bus, size_t topic, uint32_t first_id, uint32_t last_id, mhsm_hsm_t **subscribers, size_t capacity)
+{
+	mhsm_bus_topic_t *t;
+
+	MDBG_ASSERT(topic < bus->nrof_topics);
+	MDBG_ASSERT(first_id <= last_id);
+
+	t = bus->topics + topic;
+	t->first_id = first_id;
+	t->last_id = last_id;
+	t->subscribers = subscribers;
+	t->capacity = capacity;
+	t->count = 0;
+	t->publishing = 0;
+	t->unsubscribed = 0;
+}
+
+int mhsm_bus_subscribe(mhsm_bus_t *bus, size_t topic, mhsm_hsm_t *hsm)
+{
+	mhsm_bus_topic_t *t;
+
+	MDBG_ASSERT(topic < bus->nrof_topics);
+	if (topic >= bus->nrof_topics)
+		return -1;
+
+	t = bus->topics + topic;
+	if (t->count == t->capacity) {
+		MDBG_PRINT1("topic %d full\n", (int) topic);
+		return -1;
+	}
+
+	t->subscribers[t->count++] = hsm;
+
+	return 0;
+}
+
+int mhsm_bus_unsubscribe(mhsm_bus_t *bus, size_t topic, mhsm_hsm_t *hsm)
+{
+	mhsm_bus_topic_t *t;
+	size_t i;
+
+	MDBG_ASSERT(topic < bus->nrof_topics);
+	if (topic >= bus->nrof_topics)
+		return -1;
+
+	t = bus->topics + topic;
+	for (i = 0; i < t->count; i++) {
+		if (t->subscribers[i] != hsm)
+			continue;
+
+		if (t->publishing > 0) {
+			t->subscribers[i] = NULL;
+			t->unsubscribed = 1;
+		} else {
+			/* keep the array contiguous, the order does not matter */
+			t->subscribers[i] = t->subscribers[--t->count];
+		}
+
+		return 0;
+	}
+
+	return -1;
+}
+
+int mhsm_bus_publish(mhsm_bus_t *bus, uint32_t id, int32_t arg)
+{
+	int ret = 0;
+	size_t i;
+
+	for (i = 0; i < bus->nrof_topics; i++) {
+		mhsm_bus_topic_t *t = bus->topics + i;
+
+		if (id < t->first_id || id > t->last_id)
+			continue;
+
+		if (_publish_topic(t, id, arg) != 0)
+			ret = -1;
+	}
+
+	return ret;
+}
+
+int mhsm_bus_publish_topic(mhsm_bus_t *bus, size_t topic, uint32_t id, int32_t arg)
+{
+	mhsm_bus_topic_t *t;
+
+	MDBG_ASSERT(topic < bus->nrof_topics);
+	if (topic >= bus->nrof_topics)
+		return -1;
+
+	t = bus->topics + topic;
+
+	return _publish_topic(t, id, arg);
+}
+
+int mhsm_bus_publish_slice(mhsm_bus_t *bus, size_t topic, uint32_t id, int32_t arg, size_t slice, size_t nrof_slices)
+{
+	mhsm_bus_topic_t *t;
+
+	MDBG_ASSERT(topic < bus->nrof_topics && slice < nrof_slices);
+	if (topic >= bus->nrof_topics || slice >= nrof_slices)
+		return -1;
+
+	t = bus->topics + topic;
+
+	return _publish_range(t, id, arg, t->count * slice / nrof_slices, t->count * (slice + 1) / nrof_slices);
+}
@@ -0,0 +1,58 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_BUS_H
+#define MBB_BUS_H
+
+#include "types.h"
+#include "hsm.h"
+
+/* 
+ * Event bus broadcasting events to many HSMs.
+ *
+ * HSMs subscribe to topics. Each topic covers a range of event ids and keeps
+ * its subscribers in a contiguous array provided by the application.
+ */
+
+typedef struct {
+	uint32_t first_id;
+	uint32_t last_id;
+	mhsm_hsm_t **subscribers;
+	size_t capacity;
+	size_t count;
+	/* nesting depth of publishes, subscribers unsubscribed meanwhile are NULL */
+	size_t publishing;
+	bool unsubscribed;
+} mhsm_bus_topic_t;
+
+typedef struct {
+	mhsm_bus_topic_t *topics;
+	size_t nrof_topics;
+} mhsm_bus_t;
+
+void mhsm_bus_initialise(mhsm_bus_t *bus, mhsm_bus_topic_t *topics, size_t nrof_topics);
+void mhsm_bus_initialise_topic(mhsm_bus_t *bus, size_t topic, uint32_t first_id, uint32_t last_id, mhsm_hsm_t **subscribers, size_t capacity);
+int mhsm_bus_subscribe(mhsm_bus_t *bus, size_t topic, mhsm_hsm_t *hsm);
+int mhsm_bus_unsubscribe(mhsm_bus_t *bus, size_t topic, mhsm_hsm_t *hsm);
+int mhsm_bus_publish(mhsm_bus_t *bus, uint32_t id, int32_t arg);
+int mhsm_bus_publish_topic(mhsm_bus_t *bus, size_t topic, uint32_t id, int32_t arg);
+int mhsm_bus_publish_slice(mhsm_bus_t *bus, size_t topic, uint32_t id, int32_t arg, size_t slice, size_t nrof_slices);
+
+#endif /* MBB_BUS_H */
@@ -0,0 +1,49 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_CLOCK_H
+#define MBB_CLOCK_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 
+ * Cheap monotonic clock used for instrumentation.
+ *
+ * mclk_now() returns nanoseconds of CLOCK_MONOTONIC_RAW if available,
+ * CLOCK_MONOTONIC otherwise. Define MCLK_NOW() to use a system-specific
+ * clock instead, e.g. a cycle counter, in which case all durations are
+ * measured in its ticks.
+ */
+
+#ifndef MCLK_NOW
+# define MCLK_NOW() mclk_now()
+#endif
+
+uint64_t mclk_now(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBB_CLOCK_H */
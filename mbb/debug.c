@@ -18,11 +18,12 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include "types.h"
 #include <time.h>
 #include <stdio.h>
 #include <stdarg.h>
 
-int mdbg_printf(const char *format, ...)
+MBB_API int mdbg_printf(const char *format, ...)
 {
 	va_list ap;
 	int ret;
@@ -33,7 +34,7 @@ int mdbg_printf(const char *format, ...)
 	return ret;
 }
 
-int mdbg_timestamp(char *out, int size)
+MBB_API int mdbg_timestamp(char *out, int size)
 {
 	time_t current_time;
 	struct tm *bdtime;
@@ -21,14 +21,20 @@
 #ifndef MBB_DEBUG_H
 #define MBB_DEBUG_H
 
+#include "types.h"
+
 #ifndef NDEBUG
 
 # include <assert.h>
 # include <errno.h>
 # include <string.h>
 
+# ifdef __cplusplus
+extern "C" {
+# endif
+
 # ifndef MDBG_PRINTF
-int mdbg_printf(const char *format, ...);
+MBB_API int mdbg_printf(const char *format, ...);
 #  define MDBG_PRINTF mdbg_printf
 # endif
 
@@ -37,10 +43,14 @@ int mdbg_printf(const char *format, ...);
  * format to a string: 2015-02-10T13:22:35.102
  */
 # ifndef MDBG_TIMESTAMP
-int mdbg_timestamp(char *out, int size);
+MBB_API int mdbg_timestamp(char *out, int size);
 #  define MDBG_TIMESTAMP mdbg_timestamp
 # endif
 
+# ifdef __cplusplus
+}
+# endif
+
 # define MDBG_PRINT_PREFIX() do { \
 	char timestamp[24]; \
 	if (MDBG_TIMESTAMP(timestamp, sizeof(timestamp)) != 0) break; \
@@ -0,0 +1,168 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_HEAP_H
+#define MBB_HEAP_H
+
+#include "types.h"
+
+/* 
+ * Type-safe fixed-capacity binary min-heaps, e.g. for deadline ordered timers
+ * or prioritised events.
+ *
+ * The order is defined by a LESS(A, B) macro or function comparing two
+ * elements, which all macros changing the heap take as an argument. They also
+ * take a MOVED(ELEMENT, INDEX) macro or function which is called whenever an
+ * element is placed at an index, so elements can remember their position for
+ * MHEAP_UPDATE() and MHEAP_REMOVE(). Pass MHEAP_NOT_MOVED if you don't need
+ * it.
+ *
+ * Example:
+ *
+ * #define LESS(A, B) ((A) < (B))
+ *
+ * {
+ *	MHEAP_DEFINE_STRUCT(int, 5) deadlines;
+ *
+ *	MHEAP_INITIALISE(&deadlines);
+ *
+ *	MHEAP_PUSH(&deadlines, 4, LESS, MHEAP_NOT_MOVED);
+ *	MHEAP_PUSH(&deadlines, 2, LESS, MHEAP_NOT_MOVED);
+ *	MHEAP_PUSH(&deadlines, 3, LESS, MHEAP_NOT_MOVED);
+ *
+ *	while (!MHEAP_IS_EMPTY(&deadlines)) {
+ *		printf("deadline: %d\n", MHEAP_PEEK(&deadlines));
+ *		MHEAP_POP(&deadlines, LESS, MHEAP_NOT_MOVED);
+ *	}
+ * }
+ *
+ * Output:
+ *
+ * deadline: 2
+ * deadline: 3
+ * deadline: 4
+ */
+
+/* 
+ * The spare element holds the element being sifted, so the macros don't have
+ * to name its type.
+ */
+#define MHEAP_DEFINE_STRUCT(TYPE, CAPACITY) \
+struct { \
+	size_t count; \
+	size_t capacity; \
+	TYPE spare; \
+	TYPE data[CAPACITY]; \
+}
+
+/* a heap whose elements are stored in a buffer provided by the application */
+#define MHEAP_DEFINE_BUFFER_STRUCT(TYPE) \
+struct { \
+	size_t count; \
+	size_t capacity; \
+	TYPE spare; \
+	TYPE *data; \
+}
+
+#define MHEAP_INITIALISE(H) do { \
+	(H)->count = 0; \
+	(H)->capacity = sizeof((H)->data) / sizeof((H)->data[0]); \
+} while (0)
+
+#define MHEAP_INITIALISE_BUFFER(H, BUFFER, CAPACITY) do { \
+	(H)->count = 0; \
+	(H)->capacity = (CAPACITY); \
+	(H)->data = (BUFFER); \
+} while (0)
+
+#define MHEAP_NOT_MOVED(ELEMENT, INDEX) ((void) 0)
+
+#define MHEAP_CAPACITY(H) (H)->capacity
+
+#define MHEAP_COUNT(H) (H)->count
+
+#define MHEAP_IS_FULL(H) (MHEAP_COUNT(H) == MHEAP_CAPACITY(H))
+
+#define MHEAP_IS_EMPTY(H) (MHEAP_COUNT(H) == 0)
+
+#define MHEAP_PEEK(H) ((H)->data[0])
+
+#define MHEAP_AT(H, INDEX) ((H)->data[INDEX])
+
+#define MHEAP__PLACE(H, INDEX, ELEMENT, MOVED) do { \
+	(H)->data[INDEX] = ELEMENT; \
+	MOVED((H)->data[INDEX], INDEX); \
+} while (0)
+
+#define MHEAP__SIFT_UP(H, INDEX, LESS, MOVED) do { \
+	size_t mheap_i = (INDEX); \
+	(H)->spare = (H)->data[mheap_i]; \
+	while (mheap_i > 0 && LESS((H)->spare, (H)->data[(mheap_i - 1) / 2])) { \
+		MHEAP__PLACE(H, mheap_i, (H)->data[(mheap_i - 1) / 2], MOVED); \
+		mheap_i = (mheap_i - 1) / 2; \
+	} \
+	MHEAP__PLACE(H, mheap_i, (H)->spare, MOVED); \
+} while (0)
+
+#define MHEAP__SIFT_DOWN(H, INDEX, LESS, MOVED) do { \
+	size_t mheap_i = (INDEX), mheap_child; \
+	(H)->spare = (H)->data[mheap_i]; \
+	while ((mheap_child = 2 * mheap_i + 1) < (H)->count) { \
+		if (mheap_child + 1 < (H)->count && \
+				LESS((H)->data[mheap_child + 1], (H)->data[mheap_child])) \
+			mheap_child++; \
+		if (!LESS((H)->data[mheap_child], (H)->spare)) break; \
+		MHEAP__PLACE(H, mheap_i, (H)->data[mheap_child], MOVED); \
+		mheap_i = mheap_child; \
+	} \
+	MHEAP__PLACE(H, mheap_i, (H)->spare, MOVED); \
+} while (0)
+
+#define MHEAP_PUSH(H, ELEMENT, LESS, MOVED) do { \
+	if (MHEAP_IS_FULL(H)) break; \
+	(H)->data[(H)->count] = ELEMENT; \
+	(H)->count += 1; \
+	MHEAP__SIFT_UP(H, (H)->count - 1, LESS, MOVED); \
+} while (0)
+
+/* restores the order after the element at INDEX has been changed */
+#define MHEAP_UPDATE(H, INDEX, LESS, MOVED) do { \
+	size_t mheap_u = (INDEX); \
+	if (mheap_u > 0 && LESS((H)->data[mheap_u], (H)->data[(mheap_u - 1) / 2])) \
+		MHEAP__SIFT_UP(H, mheap_u, LESS, MOVED); \
+	else \
+		MHEAP__SIFT_DOWN(H, mheap_u, LESS, MOVED); \
+} while (0)
+
+/* cheaper than MHEAP_UPDATE if the element's key has not increased */
+#define MHEAP_DECREASE_KEY(H, INDEX, LESS, MOVED) MHEAP__SIFT_UP(H, INDEX, LESS, MOVED)
+
+#define MHEAP_REMOVE(H, INDEX, LESS, MOVED) do { \
+	size_t mheap_r = (INDEX); \
+	if (mheap_r >= (H)->count) break; \
+	(H)->count -= 1; \
+	if (mheap_r == (H)->count) break; \
+	MHEAP__PLACE(H, mheap_r, (H)->data[(H)->count], MOVED); \
+	MHEAP_UPDATE(H, mheap_r, LESS, MOVED); \
+} while (0)
+
+#define MHEAP_POP(H, LESS, MOVED) MHEAP_REMOVE(H, 0, LESS, MOVED)
+
+#endif /* MBB_HEAP_H */
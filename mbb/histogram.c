@@ -0,0 +1,132 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "histogram.h"
+#include "types.h"
+#include "debug.h"
+#include <string.h>
+
+#define _SUB_BUCKETS (1u << MHST_SUB_BUCKET_BITS)
+#define _MAX_VALUE ((((uint64_t) 1) << MHST_VALUE_BITS) - 1)
+
+static unsigned _msb(uint64_t value)
+{
+#ifdef __GNUC__
+	return 63 - __builtin_clzll(value);
+#else
+	unsigned msb = 0;
+
+	while (value >>= 1)
+		msb++;
+
+	return msb;
+#endif
+}
+
+static size_t _bucket(uint64_t value)
+{
+	unsigned shift;
+
+	if (value > _MAX_VALUE)
+		value = _MAX_VALUE;
+
+	if (value < _SUB_BUCKETS)
+		return (size_t) value;
+
+	shift = _msb(value) - MHST_SUB_BUCKET_BITS;
+
+	return ((size_t) (shift + 1) << MHST_SUB_BUCKET_BITS) + (size_t) ((value >> shift) - _SUB_BUCKETS);
+}
+
+/* the largest value counted in a bucket */
+static uint64_t _upper_bound(size_t bucket)
+{
+	size_t group = bucket >> MHST_SUB_BUCKET_BITS;
+	unsigned shift;
+
+	if (group == 0)
+		return bucket;
+
+	shift = group - 1;
+
+	return ((((uint64_t) (bucket & (_SUB_BUCKETS - 1))) + _SUB_BUCKETS) << shift) + (((uint64_t) 1) << shift) - 1;
+}
+
+void mhst_reset(mhst_histogram_t *histogram)
+{
+	memset(histogram, 0, sizeof(*histogram));
+}
+
+void mhst_record(mhst_histogram_t *histogram, uint64_t value)
+{
+	histogram->counts[_bucket(value)]++;
+	histogram->total++;
+	if (value > histogram->max)
+		histogram->max = value;
+}
+
+void mhst_merge(mhst_histogram_t *dst, const mhst_histogram_t *src)
+{
+	size_t i;
+
+	for (i = 0; i < MHST_NROF_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+
+	dst->total += src->total;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+uint32_t mhst_count(const mhst_histogram_t *histogram)
+{
+	return histogram->total;
+}
+
+uint64_t mhst_max(const mhst_histogram_t *histogram)
+{
+	return histogram->max;
+}
+
+uint64_t mhst_quantile(const mhst_histogram_t *histogram, uint32_t per_mille)
+{
+	uint64_t rank, seen = 0;
+	uint64_t bound;
+	size_t i;
+
+	MDBG_ASSERT(per_mille <= 1000);
+
+	if (histogram->total == 0)
+		return 0;
+
+	/* smallest rank covering per_mille of the values */
+	rank = ((uint64_t) histogram->total * per_mille + 999) / 1000;
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < MHST_NROF_BUCKETS; i++) {
+		seen += histogram->counts[i];
+		if (seen >= rank)
+			break;
+	}
+
+	bound = _upper_bound(i);
+
+	return bound < histogram->max ? bound : histogram->max;
+}
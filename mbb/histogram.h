@@ -0,0 +1,58 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_HISTOGRAM_H
+#define MBB_HISTOGRAM_H
+
+#include "types.h"
+
+/* 
+ * Fixed-memory log-linear histograms.
+ *
+ * Each power of two is split into 2^MHST_SUB_BUCKET_BITS equally wide
+ * buckets, so the relative error of a quantile is at most
+ * 1 / 2^MHST_SUB_BUCKET_BITS. Values of 2^MHST_VALUE_BITS and above are
+ * counted in the last bucket.
+ */
+
+#ifndef MHST_SUB_BUCKET_BITS
+# define MHST_SUB_BUCKET_BITS 3
+#endif
+
+#ifndef MHST_VALUE_BITS
+# define MHST_VALUE_BITS 32
+#endif
+
+#define MHST_NROF_BUCKETS ((MHST_VALUE_BITS - MHST_SUB_BUCKET_BITS + 1) << MHST_SUB_BUCKET_BITS)
+
+typedef struct {
+	uint32_t counts[MHST_NROF_BUCKETS];
+	uint32_t total;
+	uint64_t max;
+} mhst_histogram_t;
+
+void mhst_reset(mhst_histogram_t *histogram);
+void mhst_record(mhst_histogram_t *histogram, uint64_t value);
+void mhst_merge(mhst_histogram_t *dst, const mhst_histogram_t *src);
+uint32_t mhst_count(const mhst_histogram_t *histogram);
+uint64_t mhst_max(const mhst_histogram_t *histogram);
+uint64_t mhst_quantile(const mhst_histogram_t *histogram, uint32_t per_mille);
+
+#endif /* MBB_HISTOGRAM_H */
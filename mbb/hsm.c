@@ -22,6 +22,40 @@
 #include "types.h"
 #include "queue.h"
 #include "debug.h"
+#include <string.h>
+#if defined(MHSM_LATENCY) || defined(MHSM_PROFILE)
+# include "clock.h"
+#endif
+#ifdef MHSM_LATENCY
+# include "latency.h"
+#endif
+#ifdef MHSM_PROFILE
+# include "profile.h"
+#endif
+#ifdef MHSM_COMPACT
+# include "pool.h"
+#endif
+
+#ifdef MHSM_STATISTICS
+# define _COUNT(HSM, COUNTER) ((HSM)->stats.COUNTER++)
+#else
+# define _COUNT(HSM, COUNTER) ((void) 0)
+#endif
+
+#ifdef MHSM_COMPACT
+/* queues of deferred events, taken by HSMs while events are queued */
+static MPOOL_DEFINE_STRUCT(mhsm_event_queue_t, MHSM_COMPACT_QUEUES) _queues = MPOOL_INITIALISER;
+
+/* distinct timer callbacks of HSMs without a type */
+static int (*_timer_callbacks[MHSM_COMPACT_CALLBACKS])(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs);
+
+/* spin lock guarding the pool and the table */
+# ifndef MHSM_COMPACT_LOCK
+static char _lock;
+#  define MHSM_COMPACT_LOCK() do {} while (__atomic_test_and_set(&_lock, __ATOMIC_ACQUIRE))
+#  define MHSM_COMPACT_UNLOCK() __atomic_clear(&_lock, __ATOMIC_RELEASE)
+# endif
+#endif
 
 static mhsm_state_t *_find_least_common_ancestor(mhsm_state_t *a, mhsm_state_t *b)
 {
@@ -38,10 +72,13 @@ static mhsm_state_t *_find_least_common_ancestor(mhsm_state_t *a, mhsm_state_t *
 	return NULL;
 }
 
-static mhsm_state_t *_enter_state(mhsm_hsm_t *hsm, mhsm_state_t *from, mhsm_state_t *to);
-
 static mhsm_state_t *_local_dispatch(mhsm_hsm_t *hsm, mhsm_state_t *state, mhsm_event_t event)
 {
+#ifdef MHSM_LATENCY
+	mhsm_state_t *result;
+	uint64_t start;
+#endif
+
 	MDBG_ASSERT(state != NULL);
 	if (state == NULL)
 		return NULL;
@@ -64,229 +101,791 @@ static mhsm_state_t *_local_dispatch(mhsm_hsm_t *hsm, mhsm_state_t *state, mhsm_
 	}
 #endif
 
+#ifdef MHSM_LATENCY
+	if (hsm->latency != NULL) {
+		start = MCLK_NOW();
+		result = state->event_processing_function(hsm, event);
+		mhsm_latency_record(hsm->latency, state, event.id, MCLK_NOW() - start);
+
+		return result;
+	}
+#endif
+
 	return state->event_processing_function(hsm, event);
 }
 
-static mhsm_state_t *_transition(mhsm_hsm_t *hsm, mhsm_state_t *from, mhsm_state_t *to)
+/* dispatch ENTRY, INITIAL, or EXIT, returns the target of a triggered transition or NULL */
+static mhsm_state_t *_local_dispatch_pseudo(mhsm_hsm_t *hsm, mhsm_state_t *state, uint32_t id)
 {
-	mhsm_state_t *least_common_ancestor, *result;
+	mhsm_event_t event;
+	mhsm_state_t *result;
+
+	event.id = id;
+	event.arg = 0;
+
+	if (id == MHSM_EVENT_ENTRY)
+		_COUNT(hsm, entries);
+	else if (id == MHSM_EVENT_EXIT)
+		_COUNT(hsm, exits);
 
-	MDBG_ASSERT(to != NULL);
-	if (to == NULL) 
-		/* Run, Forrest, run! */
+	result = _local_dispatch(hsm, state, event);
+	if (result == state || result == MHSM_HANDLED)
 		return NULL;
 
-	MDBG_PRINT2("transition from %s to %s\n", from->name, to->name);
+	MDBG_ASSERT(result != NULL);
 
-	/* dispatch exit events */
-	if (mhsm_is_ancestor(from, to)) {
-		least_common_ancestor = from;
-	} else {
-		if (mhsm_is_ancestor(to, from))
+	return result;
+}
+
+#if MHSM_MAX_STATES > 0
+# define _WORD(STATE) (((STATE)->index - 1) / 32)
+# define _BIT(STATE) ((uint32_t) 1 << (((STATE)->index - 1) % 32))
+
+/*
+ * Update the set of active states when changing from the state from (NULL if
+ * none) to the state to: the bits of the states exited are cleared, those of
+ * the states entered are set, the common superstates are not touched.
+ */
+static void _update_active_states(mhsm_hsm_t *hsm, mhsm_state_t *from, mhsm_state_t *to)
+{
+	mhsm_state_t *state;
+
+	for (state = from; state != NULL; state = state->parent) {
+		if (state == to || mhsm_is_ancestor(state, to))
+			break;
+		if (state->index != 0)
+			hsm->active_states[_WORD(state)] &= ~_BIT(state);
+	}
+
+	/* the states still active are the common superstates */
+	for (state = to; state != NULL; state = state->parent) {
+		if (state->index == 0)
+			continue;
+		if (hsm->active_states[_WORD(state)] & _BIT(state))
+			break;
+		hsm->active_states[_WORD(state)] |= _BIT(state);
+	}
+}
+
+/* number the states of the subtree of state in pre-order */
+static void _index_subtree(mhsm_state_t **states, size_t nrof_states, mhsm_state_t *state, uint16_t *next)
+{
+	size_t i;
+
+	state->index = (*next)++;
+	for (i = 0; i < nrof_states; i++)
+		if (states[i]->parent == state && states[i]->index == 0)
+			_index_subtree(states, nrof_states, states[i], next);
+	state->last = *next - 1;
+}
+#endif
+
+/* make state the current state at the end of a transition */
+static void _set_current_state(mhsm_hsm_t *hsm, mhsm_state_t *state)
+{
+#ifdef MHSM_PROFILE
+	uint64_t now;
+
+	if (hsm->profile != NULL) {
+		now = MCLK_NOW();
+
+		/* entered == 0 before the initial transition */
+		if (hsm->entered == 0) {
+			mhsm_profile_record_transition(hsm->profile, NULL, state);
+			hsm->entered = now;
+		} else {
+			mhsm_profile_record_residency(hsm->profile, hsm->current_state, now - hsm->entered);
+			mhsm_profile_record_transition(hsm->profile, hsm->current_state, state);
+			hsm->entered = now;
+		}
+	}
+#endif
+#if MHSM_MAX_STATES > 0
+	_update_active_states(hsm, hsm->current_state, state);
+#endif
+
+	hsm->current_state = state;
+}
+
+/*
+ * Transition from the active state from (NULL if no state is active yet) to
+ * the state to. Transitions triggered by ENTRY, INITIAL, or EXIT events are
+ * performed in the same loop rather than recursively, so the stack usage is
+ * bounded. The state reached is stored as the HSM's current state.
+ *
+ * Returns -1 if the transition was aborted because the transition chain got
+ * longer than MHSM_MAX_TRANSITION_CHAIN or the entry path got longer than
+ * MHSM_MAX_NESTING_DEPTH, 0 otherwise.
+ */
+static int _transition(mhsm_hsm_t *hsm, mhsm_state_t *from, mhsm_state_t *to)
+{
+	mhsm_state_t *path[MHSM_MAX_NESTING_DEPTH];
+	mhsm_state_t *least_common_ancestor, *next;
+	int chain = 0;
+	int depth;
+
+	_COUNT(hsm, transitions);
+
+	while (1) {
+		MDBG_ASSERT(to != NULL);
+		if (to == NULL)
+			/* Run, Forrest, run! */
+			break;
+
+		if (from != NULL)
+			MDBG_PRINT2("transition from %s to %s\n", from->name, to->name);
+
+		if (mhsm_is_ancestor(from, to))
+			least_common_ancestor = from;
+		else if (mhsm_is_ancestor(to, from))
 			least_common_ancestor = to;
 		else
 			least_common_ancestor = _find_least_common_ancestor(from, to);
 
-		while (from != least_common_ancestor) {
-			mhsm_event_t event;
+		/* dispatch exit events */
+		next = NULL;
+		while (next == NULL && from != least_common_ancestor) {
+			next = _local_dispatch_pseudo(hsm, from, MHSM_EVENT_EXIT);
+			if (next == NULL)
+				from = from->parent;
+			else
+				MDBG_PRINT2("dispatching the exit event to %s triggered a new transition to %s\n", from->name, next->name);
+		}
+
+		if (next == NULL) {
+			if (least_common_ancestor == to) {
+				_set_current_state(hsm, to);
+				return 0;
+			}
 
-			event.id = MHSM_EVENT_EXIT;
-			result = _local_dispatch(hsm, from, event);
-			if (result != from) {
-				MDBG_PRINT_S(result->name);
-				return _transition(hsm, from, result);
+			/* record path to target state */
+			for (depth = 0; to != least_common_ancestor; to = to->parent) {
+				if (depth == MHSM_MAX_NESTING_DEPTH) {
+					MDBG_PRINT_LN("MHSM_MAX_NESTING_DEPTH exceeded");
+					break;
+				}
+				path[depth++] = to;
 			}
 
-			from = from->parent;
+			if (to != least_common_ancestor)
+				break;
+
+			/* dispatch entry events */
+			while (next == NULL && depth > 0) {
+				from = path[--depth];
+				next = _local_dispatch_pseudo(hsm, from, MHSM_EVENT_ENTRY);
+				if (next != NULL)
+					MDBG_PRINT2("dispatching the entry event to %s triggered a new transition to %s\n", from->name, next->name);
+			}
+		}
+
+		if (next == NULL) {
+			/* initial transition */
+			next = _local_dispatch_pseudo(hsm, from, MHSM_EVENT_INITIAL);
+			if (next == NULL) {
+				_set_current_state(hsm, from);
+				return 0;
+			}
+
+			MDBG_PRINT2("initial transition to %s in composite state %s\n", next->name, from->name);
+
+			/* descending into substates is not a chained transition */
+			if (mhsm_is_ancestor(from, next)) {
+				to = next;
+				continue;
+			}
 		}
+
+		if (++chain > MHSM_MAX_TRANSITION_CHAIN) {
+			MDBG_PRINT_LN("MHSM_MAX_TRANSITION_CHAIN exceeded");
+			break;
+		}
+
+		_COUNT(hsm, transitions);
+		to = next;
 	}
 
-	if (least_common_ancestor == to)
-		return least_common_ancestor;
+	/* aborted, stay in the state reached so far */
+	if (from != NULL)
+		_set_current_state(hsm, from);
 
-	return _enter_state(hsm, least_common_ancestor, to);
+	return -1;
 }
 
-static mhsm_state_t *_enter_state(mhsm_hsm_t *hsm, mhsm_state_t *from, mhsm_state_t *to)
+/* time stamp of queued events, 0 if queueing delays are not measured */
+static uint64_t _now(mhsm_hsm_t *hsm)
 {
-	mhsm_state_t *current;
-
-	MDBG_ASSERT(mhsm_is_ancestor(from, to));
-	if (!mhsm_is_ancestor(from, to))
-		return from;
+#ifdef MHSM_LATENCY
+	if (hsm->latency != NULL)
+		return MCLK_NOW();
+#endif
 
-	MDBG_ASSERT(to != NULL);
-	if (to == NULL)
-		return from;
+	return 0;
+}
 
-	if (to == from)
-		return to;
+/* the queue of events of the given priority, NULL if compact HSMs have none */
+static mhsm_event_queue_t *_lane(mhsm_hsm_t *hsm, uint8_t priority)
+{
+#if MHSM_PRIORITY_LEVELS > 1
+	if (priority > 0)
+		return &hsm->priority_events[priority - 1];
+#endif
 
-	/* link path to target state */
-	for (current = to; current->parent != from; current = current->parent) {
-		current->parent->current_substate = current;
-	}
+#ifdef MHSM_COMPACT
+	if (hsm->deferred_events == 0)
+		return NULL;
 
-	/* dispatch parent entry events */
-	while (current != to) {
-		mhsm_event_t event;
-		mhsm_state_t *result;
+	return &_queues.slots[hsm->deferred_events - 1].object;
+#else
+	return &hsm->deferred_events;
+#endif
+}
 
-		event.id = MHSM_EVENT_ENTRY;
-		result = _local_dispatch(hsm, current, event);
-		if (result != current) {
-			MDBG_PRINT2("dispatching the entry event to %s triggered a new transition to %s\n", current->name, result->name);
-			return _transition(hsm, current, result);
-		}
+static size_t _lane_length(mhsm_hsm_t *hsm, uint8_t priority)
+{
+	mhsm_event_queue_t *lane = _lane(hsm, priority);
 
-		current = current->current_substate;
-		current->parent->current_substate = NULL;
-	} 
+	return lane != NULL ? MQUE_LENGTH(lane) : 0;
+}
 
-	/* initial transition */
-	while (1) {
-		mhsm_event_t event;
-		mhsm_state_t *target; 
-
-		event.id = MHSM_EVENT_ENTRY;
-		target = _local_dispatch(hsm, to, event);
-		if (target != to) {
-			MDBG_PRINT2("transition interrupted by %s, new target: %s\n", to->name, target->name);
-			return _transition(hsm, to, target);
+/* like _lane(), but compact HSMs take a queue from the pool, NULL if it is exhausted */
+static mhsm_event_queue_t *_take_lane(mhsm_hsm_t *hsm, uint8_t priority)
+{
+#ifdef MHSM_COMPACT
+	mhsm_event_queue_t *lane;
+
+	if (hsm->deferred_events == 0) {
+		MHSM_COMPACT_LOCK();
+		MPOOL_ALLOC(&_queues, lane);
+		MHSM_COMPACT_UNLOCK();
+		if (lane == NULL) {
+			MDBG_PRINT_LN("MHSM_COMPACT_QUEUES exhausted");
+			return NULL;
 		}
 
-		event.id = MHSM_EVENT_INITIAL;
-		target = _local_dispatch(hsm, to, event);
-		if (target == to) 
-			break;
-		else
-			MDBG_PRINT2("intial transition to %s in composite state %s\n", target->name, to->name);
-
-		to = target;
+		MQUE_INITIALISE(lane);
+		hsm->deferred_events = (uint16_t) (MPOOL_INDEX(&_queues, lane) + 1);
 	}
+#endif
 
-	return to;
+	return _lane(hsm, priority);
 }
 
-static int _defer_event_arg(mhsm_hsm_t *hsm, uint32_t id, int32_t arg)
+/* compact HSMs return empty queues to the pool */
+static void _release_lane(mhsm_hsm_t *hsm, uint8_t priority)
 {
-	mhsm_event_t event;
+#ifdef MHSM_COMPACT
+	mhsm_event_queue_t *lane = _lane(hsm, priority);
+
+	if (lane != NULL && MQUE_LENGTH(lane) == 0) {
+		MHSM_COMPACT_LOCK();
+		MPOOL_FREE(&_queues, lane);
+		MHSM_COMPACT_UNLOCK();
+		hsm->deferred_events = 0;
+	}
+#endif
+}
+
+/* returns -1 if the queue is full */
+static int _enqueue(mhsm_hsm_t *hsm, mhsm_event_t event, uint64_t stamp, uint8_t priority)
+{
+	mhsm_event_queue_t *lane = _take_lane(hsm, priority);
+
+	if (lane == NULL || MQUE_IS_FULL(lane))
+		return -1;
 
-	if (MQUE_IS_FULL(&hsm->deferred_events)) {
+	MQUE_ENQUEUE(lane, event);
+#ifdef MHSM_LATENCY
+	hsm->deferred_stamps[priority][lane->last] = stamp;
+#endif
+
+	return 0;
+}
+
+static int _defer_event(mhsm_hsm_t *hsm, mhsm_event_t event, uint64_t stamp, uint8_t priority)
+{
+	if (_enqueue(hsm, event, stamp, priority) != 0) {
 		MDBG_PRINT_LN("event queue too short");
+		_COUNT(hsm, dropped);
 		return -1;
 	}
 
-	event.id = id;
-	event.arg = arg;
-
-	MQUE_ENQUEUE(&hsm->deferred_events, event);
+	_COUNT(hsm, deferred);
+#ifdef MHSM_STATISTICS
+	if (mhsm_queue_length(hsm) > hsm->stats.max_queue_depth)
+		hsm->stats.max_queue_depth = mhsm_queue_length(hsm);
+#endif
 
 	MDBG_PRINT3("defered event (%d, %d) in %s\n", (int) event.id, (int) event.arg, hsm->current_state->name);
 
 	return 0;
 }
 
-static mhsm_state_t *_dispatch_event(mhsm_hsm_t *hsm, mhsm_state_t *state, mhsm_event_t event)
+/*
+ * Select the priority of the next queued event to dispatch, given the number
+ * of events per priority still to be dispatched. After MHSM_PRIORITY_BURST
+ * events of higher priorities in a row, the lowest waiting priority gets its
+ * turn. The count is kept across dispatch calls, so bounded drains cannot
+ * starve lower priorities either. Returns -1 if no event is left.
+ */
+static int _select_lane(mhsm_hsm_t *hsm, int *pending)
+{
+	int highest = -1, lowest = -1;
+	int p;
+
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++) {
+		if (pending[p] == 0)
+			continue;
+		if (lowest < 0)
+			lowest = p;
+		highest = p;
+	}
+
+#if MHSM_PRIORITY_LEVELS > 1
+	if (highest == lowest) {
+		hsm->burst = 0;
+		return highest;
+	}
+
+	if (++hsm->burst > MHSM_PRIORITY_BURST) {
+		hsm->burst = 0;
+		return lowest;
+	}
+#endif
+
+	return highest;
+}
+
+static bool _any_pending(int *pending)
+{
+	int p;
+
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+		if (pending[p] > 0)
+			return 1;
+
+	return 0;
+}
+
+/* consume one event of the budget, false if it is used up */
+static bool _take_budget(mhsm_budget_t *budget)
+{
+	if (budget == NULL)
+		return 1;
+
+	if (budget->events == 0)
+		return 0;
+
+	if (budget->now != NULL && budget->now() >= budget->deadline)
+		return 0;
+
+	budget->events--;
+
+	return 1;
+}
+
+/*
+ * Dispatch an event to the current state and its superstates.
+ * Returns 1 if the event was deferred, -1 on error, 0 otherwise.
+ */
+static int _dispatch_event(mhsm_hsm_t *hsm, mhsm_event_t event)
 {
+	mhsm_state_t *state = hsm->current_state;
 	mhsm_state_t *target = state;
 	mhsm_state_t *current;
 	mhsm_state_t *result;
+#ifdef MHSM_STATISTICS
+	bool handled = 0;
+#endif
 
 	/* catch special INITIAL event */
 	if (event.id == MHSM_EVENT_INITIAL) {
-		return _enter_state(hsm, NULL, state);
+		return _transition(hsm, NULL, state);
 	}
 
-	/* dispatch event to all active states */
+	_COUNT(hsm, dispatched);
+
+	/* dispatch event to active states */
 	for (current = state; current != NULL; current = current->parent) {
 		result = _local_dispatch(hsm, current, event);
 
-		/* greedy transition selection */
-		if (result != current && target == state) 
-			target = result;
+		if (result == MHSM_HANDLED) {
+#ifdef MHSM_STATISTICS
+			handled = 1;
+#endif
+			if (hsm->propagation == MHSM_PROPAGATION_CONSUME)
+				break;
+			continue;
+		}
+
+		if (result != current) {
+			/* greedy transition selection */
+			if (target == state) 
+				target = result;
+
+			/* a transition or deferral consumes the event */
+			if (hsm->propagation == MHSM_PROPAGATION_CONSUME)
+				break;
+		}
 	}
 
-	/* return if the event was deferred */
-	if (target == NULL) return NULL;
+	if (target == NULL) {
+		MDBG_PRINT2("event %d was defered by %s\n", event.id, state->name);
+		return 1;
+	}
 
-	if (target != state) 
+	if (target != state) {
+		_COUNT(hsm, handled);
 		return _transition(hsm, state, target);
+	}
 
-	return state;
+#ifdef MHSM_STATISTICS
+	if (handled)
+		_COUNT(hsm, handled);
+#endif
+
+	return 0;
 }
 
-void mhsm_initialise(mhsm_hsm_t *hsm, void *context, mhsm_state_t *initial_state)
+/*
+ * Dispatch an event and (re-)enqueue it if it is deferred. If pending is not
+ * NULL, it is set to the number of events per priority enqueued before the
+ * event itself. stamp is the time the event was queued first, 0 if it was not
+ * queued.
+ */
+static int _process_event(mhsm_hsm_t *hsm, mhsm_event_t event, uint64_t stamp, uint8_t priority, int *pending)
 {
-	MQUE_INITIALISE(&hsm->deferred_events);
+	uint64_t now = _now(hsm);
+	int status;
+	int p;
+
+	status = _dispatch_event(hsm, event);
+
+	if (pending != NULL)
+		for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+			pending[p] = _lane_length(hsm, p);
+
+	if (status > 0) {
+		if (_defer_event(hsm, event, stamp != 0 ? stamp : now, priority) != 0)
+			return -1;
+		return 1;
+	}
+#ifdef MHSM_LATENCY
+	if (stamp != 0 && now != 0)
+		mhsm_latency_record_delay(hsm->latency, event.id, now - stamp);
+#endif
+
+	return status < 0 ? -1 : 0;
+}
+
+/*
+ * Dispatch the given number of queued events per priority once, higher
+ * priorities first, as long as the budget (NULL for none) lasts. deferred is
+ * the number of events deferred again before. Returns -1 on
+ * error, 1 if queued events other than those deferred again are left, i.e.
+ * the budget ran out or new events were queued meanwhile, 0 otherwise.
+ */
+static int _drain(mhsm_hsm_t *hsm, int *pending, mhsm_budget_t *budget, size_t deferred)
+{
+	mhsm_event_t event;
+	mhsm_event_queue_t *lane;
+	uint64_t stamp;
+	int ret = 0;
+	int status;
+	int p;
+
+	while (_any_pending(pending) && _take_budget(budget)) {
+		p = _select_lane(hsm, pending);
+		pending[p]--;
+		lane = _lane(hsm, p);
+		event = MQUE_HEAD(lane);
+#ifdef MHSM_LATENCY
+		stamp = hsm->deferred_stamps[p][lane->first];
+#else
+		stamp = 0;
+#endif
+		MQUE_DEQUEUE(lane);
+		_release_lane(hsm, p);
+
+		status = _process_event(hsm, event, stamp, p, NULL);
+		if (status < 0)
+			ret = -1;
+		else if (status > 0)
+			deferred++;
+	}
+
+	if (ret != 0)
+		return -1;
+
+	return mhsm_queue_length(hsm) > deferred;
+}
+
+MBB_API void mhsm_initialise(mhsm_hsm_t *hsm, void *context, mhsm_state_t *initial_state)
+{
+	int p;
+
+#ifdef MHSM_COMPACT
+	hsm->deferred_events = 0;
+#endif
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+		if (_lane(hsm, p) != NULL)
+			MQUE_INITIALISE(_lane(hsm, p));
 	hsm->context = context;
 	hsm->current_state = initial_state;
+#if MHSM_MAX_STATES > 0
+	memset(hsm->active_states, 0, sizeof(hsm->active_states));
+	_update_active_states(hsm, NULL, initial_state);
+#endif
 	hsm->in_transition = 0;
+	hsm->backlog = 0;
+	hsm->propagation = MHSM_PROPAGATION_GREEDY;
+#ifndef MHSM_COMPACT
 	hsm->start_timer_callback = NULL;
+#else
+	hsm->timer_callback = 0;
+#endif
+#if MHSM_PRIORITY_LEVELS > 1
+	hsm->burst = 0;
+#endif
+#ifdef MHSM_LATENCY
+	hsm->latency = NULL;
+#endif
+#ifdef MHSM_PROFILE
+	hsm->profile = NULL;
+	hsm->entered = 0;
+#endif
+#ifdef MHSM_STATISTICS
+	mhsm_reset_stats(hsm);
+#endif
 }
 
-void mhsm_dispatch_event(mhsm_hsm_t *hsm, uint32_t id)
+MBB_API int mhsm_dispatch_event(mhsm_hsm_t *hsm, uint32_t id)
 {
-	mhsm_dispatch_event_arg(hsm, id, 0);
+	return mhsm_dispatch_event_arg(hsm, id, 0);
 }
 
-void mhsm_dispatch_event_arg(mhsm_hsm_t *hsm, uint32_t id, int32_t arg)
-{	
-	mhsm_event_t event;
-	mhsm_state_t *new_state;
-	int nevents;
-	int i;
+MBB_API int mhsm_dispatch_event_arg(mhsm_hsm_t *hsm, uint32_t id, int32_t arg)
+{
+	return mhsm_dispatch_posted_event(hsm, id, arg, 0);
+}
 
-	MDBG_ASSERT(hsm->current_state != NULL);
+/*
+ * Dispatch an event while queued events have not been dispatched yet, e.g.
+ * left over by a budget. The event is queued behind them, so events are
+ * dispatched in the order they were posted, and the queue is drained once. The
+ * events queued afterwards, including those deferred again, are drained once
+ * more, so deferred events see the transitions triggered by the event. Returns
+ * like _drain().
+ */
+static int _dispatch_behind(mhsm_hsm_t *hsm, mhsm_event_t event, uint64_t stamp, uint8_t priority, mhsm_budget_t *budget)
+{
+	int pending[MHSM_PRIORITY_LEVELS];
+	int ret;
+	int p;
 
-	if (hsm->in_transition) {
-		_defer_event_arg(hsm, id, arg);
-		return;
+	if (_enqueue(hsm, event, stamp, priority) != 0) {
+		MDBG_PRINT_LN("event queue too short");
+		_COUNT(hsm, dropped);
+		return -1;
 	}
 
 	hsm->in_transition = 1;
 
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+		pending[p] = _lane_length(hsm, p);
+
+	ret = _drain(hsm, pending, budget, 0);
+	if (ret >= 0 && !_any_pending(pending)) {
+		for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+			pending[p] = _lane_length(hsm, p);
+
+		ret = _drain(hsm, pending, budget, 0);
+	}
+
+	hsm->backlog = ret > 0;
+	hsm->in_transition = 0;
+
+	return ret;
+}
+
+static int _dispatch(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, uint64_t posted, uint8_t priority, mhsm_budget_t *budget)
+{
+	mhsm_event_t event;
+	int pending[MHSM_PRIORITY_LEVELS];
+	int ret, status;
+
+	MDBG_ASSERT(hsm->current_state != NULL);
+
 	event.id = id;
 	event.arg = arg;
 
-	new_state = _dispatch_event(hsm, hsm->current_state, event);
-	if (new_state == NULL) {
-		MDBG_PRINT2("event %d was defered by %s\n", event.id, hsm->current_state->name);
+	if (hsm->in_transition)
+		return _defer_event(hsm, event, posted != 0 ? posted : _now(hsm), priority);
 
-		/* (re-)enqueue event */
-		if (_defer_event_arg(hsm, event.id, event.arg) != 0)
-			MDBG_PRINT_LN("(re-)enqueing defered event failed");
+	/* events only deferred by their states do not hold back the event */
+	if (hsm->backlog) {
+		ret = _dispatch_behind(hsm, event, posted != 0 ? posted : _now(hsm), priority, budget);
+		return ret < 0 ? -1 : budget != NULL ? ret : 0;
+	}
 
-		return;
+	if (!_take_budget(budget)) {
+		/* left to the next call */
+		if (_defer_event(hsm, event, posted != 0 ? posted : _now(hsm), priority) != 0)
+			return -1;
+		hsm->backlog = 1;
+		return 1;
 	}
 
-	hsm->current_state = new_state;
+	hsm->in_transition = 1;
 
-	nevents = MQUE_LENGTH(&hsm->deferred_events);
-	for (i = 0; i < nevents; i++) {
-		MDBG_ASSERT(!MQUE_IS_EMPTY(&hsm->deferred_events));
-		if (MQUE_IS_EMPTY(&hsm->deferred_events)) break;
+	ret = _process_event(hsm, event, posted, priority, pending);
+	status = _drain(hsm, pending, budget, ret > 0);
 
-		hsm->current_state = _dispatch_event(hsm, hsm->current_state, MQUE_HEAD(&hsm->deferred_events));
-		MDBG_ASSERT(hsm->current_state != NULL);
+	hsm->backlog = status > 0;
+	hsm->in_transition = 0;
 
-		MQUE_DEQUEUE(&hsm->deferred_events);
-	}
+	if (ret < 0 || status < 0)
+		return -1;
+
+	return budget != NULL ? status : 0;
+}
+
+MBB_API int mhsm_dispatch_posted_event(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, uint64_t posted)
+{
+	return _dispatch(hsm, id, arg, posted, 0, NULL);
+}
+
+MBB_API int mhsm_dispatch_event_prio(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, uint8_t priority)
+{
+	MDBG_ASSERT(priority < MHSM_PRIORITY_LEVELS);
+	if (priority >= MHSM_PRIORITY_LEVELS)
+		priority = MHSM_PRIORITY_LEVELS - 1;
+
+	return _dispatch(hsm, id, arg, 0, priority, NULL);
+}
+
+/*
+ * Dispatch an event and queued events as long as the budget lasts, consuming
+ * it. Returns -1 on error, 1 if work is left for mhsm_drain(), 0 otherwise.
+ */
+MBB_API int mhsm_dispatch_event_budget(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, mhsm_budget_t *budget)
+{
+	return _dispatch(hsm, id, arg, 0, 0, budget);
+}
+
+/* dispatch queued events as long as the budget lasts, returns like mhsm_dispatch_event_budget() */
+MBB_API int mhsm_drain(mhsm_hsm_t *hsm, mhsm_budget_t *budget)
+{
+	int pending[MHSM_PRIORITY_LEVELS];
+	int ret;
+	int p;
+
+	MDBG_ASSERT(!hsm->in_transition);
+	if (hsm->in_transition)
+		return -1;
 
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+		pending[p] = _lane_length(hsm, p);
+
+	hsm->in_transition = 1;
+	ret = _drain(hsm, pending, budget, 0);
+	hsm->backlog = ret > 0;
 	hsm->in_transition = 0;
+
+	return ret;
 }
 
-void *mhsm_context(mhsm_hsm_t *hsm)
+MBB_API void *mhsm_context(mhsm_hsm_t *hsm)
 {
 	return hsm->context;
 }
 
-mhsm_state_t *mhsm_current_state(mhsm_hsm_t *hsm)
+/* number of queued events of all priorities */
+MBB_API size_t mhsm_queue_length(mhsm_hsm_t *hsm)
+{
+	size_t length = 0;
+	int p;
+
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+		length += _lane_length(hsm, p);
+
+	return length;
+}
+
+/* the queue of events of priority 0, NULL if compact HSMs have no events queued */
+MBB_API mhsm_event_queue_t *mhsm_deferred_events(mhsm_hsm_t *hsm)
+{
+	return _lane(hsm, 0);
+}
+
+/* drop the queued events of all priorities */
+/*
+ * Empty the queues. Compact HSMs keep or take a queue if keep is true, e.g.
+ * because events are about to be queued, and return it to the pool otherwise.
+ * Returns -1 without changing anything if no queue is left, 0 otherwise.
+ */
+MBB_API int mhsm_clear_queues(mhsm_hsm_t *hsm, bool keep)
+{
+	int p;
+
+	if (keep && _take_lane(hsm, 0) == NULL)
+		return -1;
+
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++) {
+		if (_lane(hsm, p) == NULL)
+			continue;
+
+		MQUE_INITIALISE(_lane(hsm, p));
+		if (!keep)
+			_release_lane(hsm, p);
+	}
+
+	hsm->backlog = 0;
+
+	return 0;
+}
+
+/* number of queues compact HSMs can still take from the pool */
+MBB_API size_t mhsm_free_queues(void)
+{
+#ifdef MHSM_COMPACT
+	size_t n;
+
+	MHSM_COMPACT_LOCK();
+	n = MPOOL_CAPACITY(&_queues) - MPOOL_COUNT(&_queues);
+	MHSM_COMPACT_UNLOCK();
+
+	return n;
+#else
+	return SIZE_MAX;
+#endif
+}
+
+/*
+ * Queue an event without dispatching it, e.g. when restoring a snapshot.
+ * Returns -1 if the queue is full, 0 otherwise.
+ */
+MBB_API int mhsm_queue_event(mhsm_hsm_t *hsm, mhsm_event_t event, uint8_t priority)
+{
+	MDBG_ASSERT(priority < MHSM_PRIORITY_LEVELS);
+	if (priority >= MHSM_PRIORITY_LEVELS)
+		return -1;
+
+	if (_enqueue(hsm, event, 0, priority) != 0)
+		return -1;
+
+	/* not known to be deferred by a state */
+	hsm->backlog = 1;
+
+	return 0;
+}
+
+MBB_API mhsm_state_t *mhsm_current_state(mhsm_hsm_t *hsm)
 {
 	return hsm->current_state;
 }
 
-bool mhsm_is_ancestor(mhsm_state_t *ancestor, mhsm_state_t *target)
+MBB_API bool mhsm_is_ancestor(mhsm_state_t *ancestor, mhsm_state_t *target)
 {
 	MDBG_ASSERT(target != NULL);
 	if (target == NULL)
@@ -295,6 +894,11 @@ bool mhsm_is_ancestor(mhsm_state_t *ancestor, mhsm_state_t *target)
 	if (ancestor == NULL)
 		return 1;
 
+#if MHSM_MAX_STATES > 0
+	if (ancestor->index != 0 && target->index != 0)
+		return ancestor->index < target->index && target->index <= ancestor->last;
+#endif
+
 	while (target->parent != NULL) {
 		if (target->parent == ancestor) 
 			return 1;
@@ -305,22 +909,233 @@ bool mhsm_is_ancestor(mhsm_state_t *ancestor, mhsm_state_t *target)
 	return 0;
 }
 
-bool mhsm_is_in(mhsm_hsm_t *hsm, mhsm_state_t *state)
+MBB_API bool mhsm_is_in(mhsm_hsm_t *hsm, mhsm_state_t *state)
 {
+#if MHSM_MAX_STATES > 0
+	if (state->index != 0)
+		return MHSM_IS_ACTIVE(hsm, state);
+#endif
+
 	return mhsm_current_state(hsm) == state || mhsm_is_ancestor(state, mhsm_current_state(hsm));
 }
 
-void mhsm_set_timer_callback(mhsm_hsm_t *hsm, int (*callback)(mhsm_hsm_t*, uint32_t, uint32_t))
+#ifdef MHSM_STATISTICS
+MBB_API const mhsm_stats_t *mhsm_stats(mhsm_hsm_t *hsm)
+{
+	return &hsm->stats;
+}
+
+MBB_API void mhsm_reset_stats(mhsm_hsm_t *hsm)
+{
+	memset(&hsm->stats, 0, sizeof(hsm->stats));
+}
+
+MBB_API void mhsm_accumulate_stats(mhsm_stats_t *total, mhsm_hsm_t *hsm)
+{
+	const mhsm_stats_t *stats = &hsm->stats;
+
+	total->dispatched += stats->dispatched;
+	total->handled += stats->handled;
+	total->deferred += stats->deferred;
+	total->dropped += stats->dropped;
+	total->transitions += stats->transitions;
+	total->entries += stats->entries;
+	total->exits += stats->exits;
+	if (stats->max_queue_depth > total->max_queue_depth)
+		total->max_queue_depth = stats->max_queue_depth;
+}
+#endif
+
+#ifdef MHSM_LATENCY
+MBB_API void mhsm_set_latency(mhsm_hsm_t *hsm, mhsm_latency_t *latency)
+{
+	hsm->latency = latency;
+}
+#endif
+
+#ifdef MHSM_PROFILE
+MBB_API void mhsm_set_profile(mhsm_hsm_t *hsm, mhsm_profile_t *profile)
+{
+	hsm->profile = profile;
+	hsm->entered = 0;
+}
+
+MBB_API void mhsm_flush_profile(mhsm_hsm_t *hsm)
+{
+	uint64_t now;
+
+	if (hsm->profile == NULL || hsm->entered == 0)
+		return;
+
+	now = MCLK_NOW();
+	mhsm_profile_record_residency(hsm->profile, hsm->current_state, now - hsm->entered);
+	hsm->entered = now;
+}
+#endif
+
+/*
+ * Make state the current state without dispatching EXIT and ENTRY events,
+ * e.g. when restoring a snapshot.
+ */
+MBB_API void mhsm_restore_current_state(mhsm_hsm_t *hsm, mhsm_state_t *state)
+{
+#if MHSM_MAX_STATES > 0
+	memset(hsm->active_states, 0, sizeof(hsm->active_states));
+	_update_active_states(hsm, NULL, state);
+#endif
+
+	hsm->current_state = state;
+}
+
+#if MHSM_MAX_STATES > 0
+/*
+ * Number the given states, so mhsm_is_in() and mhsm_is_ancestor() are
+ * constant time for them. The parents of the states have to be part of the
+ * list or have been indexed together by an earlier call, at most
+ * MHSM_MAX_STATES states are indexed in total. Has to be called before the
+ * HSMs using the states are initialised. Returns -1 if the states could not be
+ * indexed, 0 otherwise.
+ */
+MBB_API int mhsm_index_states(mhsm_state_t **states, size_t nrof_states)
+{
+	/* indexes are unique across calls, so states of different HSMs never match */
+	static uint16_t nrof_indexed = 0;
+	uint16_t next = nrof_indexed + 1;
+	size_t n = 0;
+	size_t i;
+
+	for (i = 0; i < nrof_states; i++) {
+		if (states[i]->index != 0)
+			continue;
+		/* an indexed parent's range cannot grow */
+		if (states[i]->parent != NULL && states[i]->parent->index != 0)
+			return -1;
+		n++;
+	}
+
+	if (nrof_indexed + n > MHSM_MAX_STATES)
+		return -1;
+
+	for (i = 0; i < nrof_states; i++)
+		if (states[i]->parent == NULL && states[i]->index == 0)
+			_index_subtree(states, nrof_states, states[i], &next);
+
+	for (i = 0; i < nrof_states; i++) {
+		if (states[i]->index != 0)
+			continue;
+
+		/* a parent is missing, undo this call */
+		for (i = 0; i < nrof_states; i++)
+			if (states[i]->index > nrof_indexed)
+				states[i]->index = 0;
+		return -1;
+	}
+
+	nrof_indexed = next - 1;
+
+	return 0;
+}
+#endif
+
+MBB_API void mhsm_set_propagation(mhsm_hsm_t *hsm, uint8_t mode)
+{
+	MDBG_ASSERT(mode == MHSM_PROPAGATION_GREEDY || mode == MHSM_PROPAGATION_CONSUME);
+
+	hsm->propagation = mode;
+}
+
+typedef int _timer_callback_t(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs);
+
+#ifdef MHSM_COMPACT
+/* the type of a state, inherited from its superstates, NULL if it has none */
+static mhsm_type_t *_type(mhsm_state_t *state)
 {
+	for (; state != NULL; state = state->parent)
+		if (state->type != NULL)
+			return state->type;
+
+	return NULL;
+}
+
+/* set the type of a state and its substates without types of their own */
+MBB_API void mhsm_set_type(mhsm_state_t *state, mhsm_type_t *type)
+{
+	state->type = type;
+}
+#endif
+
+static _timer_callback_t *_timer_callback(mhsm_hsm_t *hsm)
+{
+#ifdef MHSM_COMPACT
+	mhsm_type_t *type = _type(hsm->current_state);
+
+	if (type != NULL)
+		return type->start_timer_callback;
+
+	return hsm->timer_callback != 0 ? _timer_callbacks[hsm->timer_callback - 1] : NULL;
+#else
+	return hsm->start_timer_callback;
+#endif
+}
+
+/*
+ * Compact HSMs set the callback of their type, so they have to be initialised.
+ * Returns -1 if the callback of a compact HSM without a type does not fit into
+ * the table of MHSM_COMPACT_CALLBACKS callbacks, 0 otherwise.
+ */
+MBB_API int mhsm_set_timer_callback(mhsm_hsm_t *hsm, int (*callback)(mhsm_hsm_t*, uint32_t, uint32_t))
+{
+#ifdef MHSM_COMPACT
+	mhsm_type_t *type = _type(hsm->current_state);
+	int i;
+
+	if (type != NULL) {
+		type->start_timer_callback = callback;
+		return 0;
+	}
+
+	hsm->timer_callback = 0;
+	if (callback == NULL)
+		return 0;
+
+	MHSM_COMPACT_LOCK();
+	for (i = 0; i < MHSM_COMPACT_CALLBACKS; i++) {
+		if (_timer_callbacks[i] == NULL)
+			_timer_callbacks[i] = callback;
+
+		if (_timer_callbacks[i] == callback) {
+			MHSM_COMPACT_UNLOCK();
+			hsm->timer_callback = (uint8_t) (i + 1);
+			return 0;
+		}
+	}
+	MHSM_COMPACT_UNLOCK();
+
+	MDBG_PRINT_LN("MHSM_COMPACT_CALLBACKS exceeded");
+	MDBG_ASSERT(i < MHSM_COMPACT_CALLBACKS);
+
+	return -1;
+#else
 	hsm->start_timer_callback = callback;
+
+	return 0;
+#endif
 }
 
-int mhsm_start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs)
+MBB_API int mhsm_start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs)
 {
-	if (hsm->start_timer_callback == NULL) {
+	_timer_callback_t *callback = _timer_callback(hsm);
+
+	if (callback == NULL) {
 		MDBG_PRINT_LN("start_timer_callback uninitialised");
 		return -1;
 	}
 
-	return hsm->start_timer_callback(hsm, event_id, period_msecs);
+	return callback(hsm, event_id, period_msecs);
+}
+
+/* whether the HSM's timers have been initialised, i.e. it has a timer callback */
+MBB_API bool mhsm_uses_timers(mhsm_hsm_t *hsm)
+{
+	return _timer_callback(hsm) != NULL;
 }
@@ -25,6 +25,10 @@
 #include "types.h"
 #include "queue.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* HSM, state, and event types */
 typedef struct mhsm_hsm_s mhsm_hsm_t;
 typedef struct mhsm_state_s mhsm_state_t;
@@ -38,14 +42,27 @@ typedef mhsm_state_t *mhsm_event_processing_fun_t(mhsm_hsm_t *hsm, mhsm_event_t
 # define MHSM_DEFINE_STATE(STATE, PARENT) \
   const char STATE##_name[] = #STATE; \
   mhsm_state_t *STATE##_fun(mhsm_hsm_t *hsm, mhsm_event_t event); \
-  mhsm_state_t STATE = { STATE##_fun, PARENT, NULL, STATE##_name }
+  mhsm_state_t STATE = { STATE##_fun, PARENT, STATE##_name }
 #else /* NDEBUG */
 # define MHSM_DEFINE_STATE(STATE, PARENT) \
   mhsm_state_t *STATE##_fun(mhsm_hsm_t *hsm, mhsm_event_t event); \
-  mhsm_state_t STATE = { STATE##_fun, PARENT, NULL, }
+  mhsm_state_t STATE = { STATE##_fun, PARENT, }
 #endif
 
 
+/* 
+ * Budget of a dispatch call, consumed by the events dispatched. Several calls
+ * may share a budget.
+ */
+typedef struct {
+	/* number of events left */
+	uint32_t events;
+	/* no events are dispatched once now() returns deadline or later */
+	uint64_t deadline;
+	/* NULL if there is no deadline */
+	uint64_t (*now)(void);
+} mhsm_budget_t;
+
 /* Common events */
 enum {
 	MHSM_EVENT_ENTRY,
@@ -55,30 +72,226 @@ enum {
 	MHSM_EVENT_CUSTOM
 };
 
-void mhsm_initialise(mhsm_hsm_t *hsm, void *context, mhsm_state_t *initial_state);
-void mhsm_dispatch_event(mhsm_hsm_t *hsm, uint32_t id);
-void mhsm_dispatch_event_arg(mhsm_hsm_t *hsm, uint32_t id, int32_t arg);
-void *mhsm_context(mhsm_hsm_t *hsm);
-mhsm_state_t *mhsm_current_state(mhsm_hsm_t *hsm);
-bool mhsm_is_ancestor(mhsm_state_t *ancestor, mhsm_state_t *target);
-bool mhsm_is_in(mhsm_hsm_t *hsm, mhsm_state_t *state);
-void mhsm_set_timer_callback(mhsm_hsm_t *hsm, int (*callback)(mhsm_hsm_t*, uint32_t, uint32_t));
-int mhsm_start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs);
+/* Event propagation modes */
+enum {
+	/* every active state sees every event, the innermost transition wins */
+	MHSM_PROPAGATION_GREEDY,
+	/* propagation stops at the first state handling the event */
+	MHSM_PROPAGATION_CONSUME
+};
+
+/* 
+ * Returned by event processing functions to indicate that an event was handled
+ * without triggering a transition. It is never dereferenced, and being a
+ * constant rather than the address of a state it is the same in all
+ * translation units, even if MBB_STATIC gives each of them its own HSM core.
+ */
+#define MHSM_HANDLED ((mhsm_state_t*) 1)
+
+MBB_API void mhsm_initialise(mhsm_hsm_t *hsm, void *context, mhsm_state_t *initial_state);
+MBB_API int mhsm_dispatch_event(mhsm_hsm_t *hsm, uint32_t id);
+MBB_API int mhsm_dispatch_event_arg(mhsm_hsm_t *hsm, uint32_t id, int32_t arg);
+MBB_API int mhsm_dispatch_posted_event(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, uint64_t posted);
+MBB_API int mhsm_dispatch_event_prio(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, uint8_t priority);
+MBB_API int mhsm_dispatch_event_budget(mhsm_hsm_t *hsm, uint32_t id, int32_t arg, mhsm_budget_t *budget);
+MBB_API int mhsm_drain(mhsm_hsm_t *hsm, mhsm_budget_t *budget);
+MBB_API void *mhsm_context(mhsm_hsm_t *hsm);
+MBB_API size_t mhsm_queue_length(mhsm_hsm_t *hsm);
+MBB_API mhsm_state_t *mhsm_current_state(mhsm_hsm_t *hsm);
+MBB_API bool mhsm_is_ancestor(mhsm_state_t *ancestor, mhsm_state_t *target);
+MBB_API bool mhsm_is_in(mhsm_hsm_t *hsm, mhsm_state_t *state);
+MBB_API void mhsm_restore_current_state(mhsm_hsm_t *hsm, mhsm_state_t *state);
+MBB_API void mhsm_set_propagation(mhsm_hsm_t *hsm, uint8_t mode);
+MBB_API int mhsm_set_timer_callback(mhsm_hsm_t *hsm, int (*callback)(mhsm_hsm_t*, uint32_t, uint32_t));
+MBB_API int mhsm_start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs);
+MBB_API bool mhsm_uses_timers(mhsm_hsm_t *hsm);
 
 #ifndef MHSM_EVENT_QUEUE_LENGTH
 # define MHSM_EVENT_QUEUE_LENGTH 5
 #endif
 
+/* 
+ * Number of event priorities, each having its own queue of
+ * MHSM_EVENT_QUEUE_LENGTH events. Queued events of higher priorities are
+ * dispatched first, 0 is the lowest priority.
+ */
+#ifndef MHSM_PRIORITY_LEVELS
+# define MHSM_PRIORITY_LEVELS 1
+#endif
+
+/* 
+ * Maximum number of queued events of higher priorities dispatched in a row
+ * while events of lower priorities are waiting.
+ */
+#ifndef MHSM_PRIORITY_BURST
+# define MHSM_PRIORITY_BURST 4
+#endif
+
+#ifdef MHSM_STATISTICS
+/* Per-HSM counters, wrapping around on overflow */
+typedef struct {
+	/* events dispatched to the active states, deferred events count again */
+	uint32_t dispatched;
+	/* events triggering a transition or returning MHSM_HANDLED */
+	uint32_t handled;
+	uint32_t deferred;
+	/* events which could not be deferred because the queue was full */
+	uint32_t dropped;
+	uint32_t transitions;
+	uint32_t entries;
+	uint32_t exits;
+	uint32_t max_queue_depth;
+} mhsm_stats_t;
+
+MBB_API const mhsm_stats_t *mhsm_stats(mhsm_hsm_t *hsm);
+MBB_API void mhsm_reset_stats(mhsm_hsm_t *hsm);
+MBB_API void mhsm_accumulate_stats(mhsm_stats_t *total, mhsm_hsm_t *hsm);
+#endif
+
+/* Handler latency table, see mbb/latency.h */
+typedef struct mhsm_latency_s mhsm_latency_t;
+
+#ifdef MHSM_LATENCY
+MBB_API void mhsm_set_latency(mhsm_hsm_t *hsm, mhsm_latency_t *latency);
+#endif
+
+/* State residency profile, see mbb/profile.h */
+typedef struct mhsm_profile_s mhsm_profile_t;
+
+#ifdef MHSM_PROFILE
+MBB_API void mhsm_set_profile(mhsm_hsm_t *hsm, mhsm_profile_t *profile);
+MBB_API void mhsm_flush_profile(mhsm_hsm_t *hsm);
+#endif
+
+/* maximum number of nested states entered by a single transition */
+#ifndef MHSM_MAX_NESTING_DEPTH
+# define MHSM_MAX_NESTING_DEPTH 16
+#endif
+
+/* maximum number of transitions triggered by ENTRY, INITIAL, or EXIT events */
+#ifndef MHSM_MAX_TRANSITION_CHAIN
+# define MHSM_MAX_TRANSITION_CHAIN 8
+#endif
+
+/* 
+ * Maximum number of states indexed by mhsm_index_states(), 0 to disable the
+ * per-HSM set of active states used by mhsm_is_in().
+ */
+#ifndef MHSM_MAX_STATES
+# define MHSM_MAX_STATES 0
+#endif
+
+#if MHSM_MAX_STATES > 0
+# if MHSM_MAX_STATES > 65535
+#  error "MHSM_MAX_STATES exceeds the range of state indexes"
+# endif
+MBB_API int mhsm_index_states(mhsm_state_t **states, size_t nrof_states);
+
+/* mhsm_is_in() for an indexed state as a single bit test */
+# define MHSM_IS_ACTIVE(HSM, STATE) \
+  (((HSM)->active_states[((STATE)->index - 1) / 32] >> (((STATE)->index - 1) % 32)) & 1)
+#endif
+
+/* 
+ * Compact HSMs for very high instance counts: the queues of deferred events
+ * are taken from a pool of MHSM_COMPACT_QUEUES queues shared by all HSMs while
+ * events are queued, and the timer callback is shared by all HSMs of a type.
+ */
+#ifdef MHSM_COMPACT
+# if MHSM_PRIORITY_LEVELS > 1 || defined(MHSM_LATENCY)
+#  error "MHSM_COMPACT excludes event priorities and MHSM_LATENCY"
+# endif
+# ifndef MHSM_COMPACT_QUEUES
+#  define MHSM_COMPACT_QUEUES 64
+# endif
+# if MHSM_COMPACT_QUEUES > 65535
+#  error "MHSM_COMPACT_QUEUES exceeds the range of queue indexes"
+# endif
+/*
+ * The pool and the table are shared by all threads dispatching events, e.g.
+ * owners of registry shards or publishers of bus slices, and guarded by a spin
+ * lock. Define MHSM_COMPACT_LOCK() and MHSM_COMPACT_UNLOCK() for compilers
+ * lacking the GCC __atomic builtins.
+ */
+/* number of distinct timer callbacks of HSMs without a type */
+# ifndef MHSM_COMPACT_CALLBACKS
+#  define MHSM_COMPACT_CALLBACKS 8
+# endif
+# if MHSM_COMPACT_CALLBACKS > 255
+#  error "MHSM_COMPACT_CALLBACKS exceeds the range of callback indexes"
+# endif
+
+/* Per machine type data shared by all HSMs of the type */
+typedef struct {
+	int (*start_timer_callback)(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs);
+} mhsm_type_t;
+
+/*
+ * The type of a top state is inherited by its substates. All HSMs in states
+ * of a type share the type's timer callback, so mhsm_set_timer_callback()
+ * sets it for all of them. HSMs in states without a type keep their own
+ * callback instead, referring to a table of up to MHSM_COMPACT_CALLBACKS
+ * distinct callbacks.
+ */
+MBB_API void mhsm_set_type(mhsm_state_t *state, mhsm_type_t *type);
+#endif
+
 /* Private API */
 #include "queue.h"
 
+typedef MQUE_DEFINE_STRUCT(mhsm_event_t, MHSM_EVENT_QUEUE_LENGTH) mhsm_event_queue_t;
+
+/* access to the queued events, e.g. for snapshots */
+MBB_API mhsm_event_queue_t *mhsm_deferred_events(mhsm_hsm_t *hsm);
+MBB_API int mhsm_clear_queues(mhsm_hsm_t *hsm, bool keep);
+MBB_API size_t mhsm_free_queues(void);
+MBB_API int mhsm_queue_event(mhsm_hsm_t *hsm, mhsm_event_t event, uint8_t priority);
+
 /* HSM struct */
 struct mhsm_hsm_s {
 	void *context;
 	mhsm_state_t *current_state;
-	MQUE_DEFINE_STRUCT(mhsm_event_t, MHSM_EVENT_QUEUE_LENGTH) deferred_events;
+#ifndef MHSM_COMPACT
+	/* events of priority 0 */
+	mhsm_event_queue_t deferred_events;
+#else
+	/* index of the queue in the shared pool plus one, 0 if no events are queued */
+	uint16_t deferred_events;
+#endif
 	bool in_transition;
+	/* queued events have not been dispatched yet, e.g. left over by a budget */
+	bool backlog;
+	uint8_t propagation;
+#ifndef MHSM_COMPACT
 	int (*start_timer_callback)(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs);
+#else
+	/* index of the callback of HSMs without a type plus one, 0 if none */
+	uint8_t timer_callback;
+#endif
+#if MHSM_PRIORITY_LEVELS > 1
+	/* events of priorities 1 to MHSM_PRIORITY_LEVELS - 1 */
+	mhsm_event_queue_t priority_events[MHSM_PRIORITY_LEVELS - 1];
+	/* events of higher priorities dispatched in a row */
+	uint8_t burst;
+#endif
+#if MHSM_MAX_STATES > 0
+	/* bit index - 1 is set for each active indexed state */
+	uint32_t active_states[(MHSM_MAX_STATES + 31) / 32];
+#endif
+#ifdef MHSM_LATENCY
+	mhsm_latency_t *latency;
+	/* MCLK_NOW() when the queued events were queued first, 0 if unknown */
+	uint64_t deferred_stamps[MHSM_PRIORITY_LEVELS][MHSM_EVENT_QUEUE_LENGTH];
+#endif
+#ifdef MHSM_PROFILE
+	mhsm_profile_t *profile;
+	/* MCLK_NOW() when the current state was entered, 0 if not yet */
+	uint64_t entered;
+#endif
+#ifdef MHSM_STATISTICS
+	/* last, so the fields used for dispatching share the first cache line */
+	mhsm_stats_t stats;
+#endif
 };
 
 /* state struct */
@@ -87,11 +300,23 @@ struct mhsm_state_s {
 	mhsm_event_processing_fun_t *event_processing_function;
 	/* s.parent != NULL => s is a substate */
 	mhsm_state_t *parent;
-	/* s.current_substate != NULL => dispatch entry event to current_substate */
-	mhsm_state_t *current_substate;
 #ifndef NDEBUG
 	const char *name;
 #endif
+#ifdef MHSM_COMPACT
+	/* NULL if the state shares the type of its parent */
+	mhsm_type_t *type;
+#endif
+#if MHSM_MAX_STATES > 0
+	/* pre-order position set by mhsm_index_states(), 0 if not indexed */
+	uint16_t index;
+	/* index of the last substate, so substates have indexes in (index, last] */
+	uint16_t last;
+#endif
 };
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* MBB_HSM_H */
@@ -0,0 +1,460 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_HSM_HPP
+#define MBB_HSM_HPP
+
+#include "debug.h"
+#include "hsm.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Header-only C++17 front-end for HSMs.
+ *
+ * States are types, the hierarchy is given by their parent member types and
+ * the list of states passed to mbb::machine. Parents, least common ancestors
+ * and initial states are resolved into constexpr tables at compile time, and
+ * all handlers are called from a single generated dispatch function, so they
+ * can be inlined instead of being called through function pointers.
+ *
+ * A machine embeds an mhsm_hsm_t in a single C state forwarding all events to
+ * the C++ handlers. Event queueing, deferral, statistics and the timer
+ * backends are those of the C implementation.
+ *
+ * struct top {
+ *	using initial = idle;
+ * };
+ *
+ * struct idle {
+ *	using parent = top;
+ *
+ *	static mbb::result handle(mbb::hsm<context_t> &m, const mbb::event &e)
+ *	{
+ *		return e.id == EVENT_GO ? mbb::transition<running> : mbb::unhandled;
+ *	}
+ * };
+ *
+ * mbb::machine<context_t, top, idle, running> machine(&context);
+ *
+ * machine.start();
+ * machine.dispatch(EVENT_GO);
+ */
+
+namespace mbb {
+
+using event = mhsm_event_t;
+
+/* parent of top-level states */
+struct root {};
+
+/* a unique address per state, identifying transition targets */
+template <class State>
+inline constexpr char state_tag = 0;
+
+class result {
+public:
+	enum kind_t : uint8_t { UNHANDLED, HANDLED, DEFERRED, TRANSITION };
+
+	constexpr result(kind_t kind, const void *target = nullptr) : kind_(kind), target_(target) {}
+
+	constexpr kind_t kind() const { return kind_; }
+	constexpr const void *target() const { return target_; }
+
+private:
+	kind_t kind_;
+	const void *target_;
+};
+
+/* results of handlers, correspond to returning the state, MHSM_HANDLED, and NULL */
+inline constexpr result unhandled { result::UNHANDLED };
+inline constexpr result handled { result::HANDLED };
+inline constexpr result deferred { result::DEFERRED };
+
+template <class State>
+inline constexpr result transition { result::TRANSITION, &state_tag<State> };
+
+/* the part of a machine visible to handlers */
+template <class Context>
+class hsm {
+public:
+	hsm(const hsm&) = delete;
+	hsm &operator=(const hsm&) = delete;
+
+	/* for the timer backends and the rest of the C API */
+	mhsm_hsm_t *c_hsm() { return &hsm_; }
+
+	Context &context() { return *static_cast<Context*>(mhsm_context(&hsm_)); }
+
+	int dispatch(uint32_t id, int32_t arg = 0) { return mhsm_dispatch_event_arg(&hsm_, id, arg); }
+
+	int start_timer(uint32_t id, uint32_t period_msecs) { return mhsm_start_timer(&hsm_, id, period_msecs); }
+
+	void set_propagation(uint8_t mode) { mhsm_set_propagation(&hsm_, mode); }
+
+protected:
+	hsm() = default;
+
+	/* the first member, so the C state can cast the mhsm_hsm_t back */
+	mhsm_hsm_t hsm_;
+	/* index of the current state, the number of states before starting */
+	uint16_t current_;
+};
+
+namespace detail {
+
+template <class State, class = void>
+struct parent_of { using type = root; };
+
+template <class State>
+struct parent_of<State, std::void_t<typename State::parent>> { using type = typename State::parent; };
+
+template <class State, class = void>
+struct initial_of { using type = void; };
+
+template <class State>
+struct initial_of<State, std::void_t<typename State::initial>> { using type = typename State::initial; };
+
+template <class State, class Hsm, class = void>
+struct has_handle : std::false_type {};
+
+template <class State, class Hsm>
+struct has_handle<State, Hsm, std::void_t<decltype(State::handle(std::declval<Hsm&>(), std::declval<const event&>()))>> : std::true_type {};
+
+template <class State, class Hsm, class = void>
+struct has_entry : std::false_type {};
+
+template <class State, class Hsm>
+struct has_entry<State, Hsm, std::void_t<decltype(State::entry(std::declval<Hsm&>()))>> : std::true_type {};
+
+template <class State, class Hsm, class = void>
+struct has_exit : std::false_type {};
+
+template <class State, class Hsm>
+struct has_exit<State, Hsm, std::void_t<decltype(State::exit(std::declval<Hsm&>()))>> : std::true_type {};
+
+} /* namespace detail */
+
+/*
+ * A machine of the given states, the first one being the initial state. Top
+ * level states have no parent member type or mbb::root as parent.
+ */
+template <class Context, class... States>
+class machine : public hsm<Context> {
+public:
+	/* the index of states not being part of the machine, e.g. mbb::root */
+	static constexpr std::size_t none = sizeof...(States);
+
+	template <class State>
+	static constexpr std::size_t index()
+	{
+		constexpr bool matches[] = { std::is_same_v<State, States>... };
+		std::size_t i = 0;
+
+		while (i < none && !matches[i])
+			i++;
+
+		return i;
+	}
+
+	static constexpr std::size_t parent(std::size_t state) { return parents_[state]; }
+
+	static constexpr std::size_t depth(std::size_t state) { return depths_[state]; }
+
+	/* as in the C implementation, the parent for a ~ b */
+	static constexpr std::size_t least_common_ancestor(std::size_t a, std::size_t b) { return lcas_[a][b]; }
+
+	explicit machine(Context *context)
+	{
+		static_assert(std::is_standard_layout_v<machine>, "the mhsm_hsm_t must be the first member");
+
+		mhsm_initialise(&this->hsm_, context, &c_state_);
+		this->current_ = none;
+	}
+
+	int start() { return mhsm_dispatch_event(&this->hsm_, MHSM_EVENT_INITIAL); }
+
+	std::size_t current() const { return this->current_; }
+
+	template <class State>
+	bool is_in() const
+	{
+		std::size_t state;
+
+		for (state = this->current_; state != none; state = parents_[state])
+			if (state == index<State>())
+				return true;
+
+		return false;
+	}
+
+private:
+	static_assert(sizeof...(States) > 0 && sizeof...(States) < UINT16_MAX, "too many states");
+
+	using states_t = std::tuple<States...>;
+	using sequence_t = std::index_sequence_for<States...>;
+
+	template <std::size_t I>
+	using nth_t = std::tuple_element_t<I, states_t>;
+
+	static constexpr std::array<std::size_t, none> parents_ = { index<typename detail::parent_of<States>::type>()... };
+
+	static_assert(((std::is_same_v<typename detail::parent_of<States>::type, root> ||
+			index<typename detail::parent_of<States>::type>() < none) && ...),
+			"every parent must be one of the machine's states");
+
+	static constexpr std::array<std::size_t, none> initials_ = { index<typename detail::initial_of<States>::type>()... };
+
+	static_assert(((std::is_void_v<typename detail::initial_of<States>::type> ||
+			index<typename detail::initial_of<States>::type>() < none) && ...),
+			"every initial state must be one of the machine's states");
+
+	static constexpr std::array<std::size_t, none> depths_ = [] {
+		std::array<std::size_t, none> depths {};
+
+		for (std::size_t i = 0; i < none; i++)
+			for (std::size_t p = parents_[i]; p != none && depths[i] <= none; p = parents_[p])
+				depths[i]++;
+
+		return depths;
+	}();
+
+	static constexpr bool is_ancestor(std::size_t ancestor, std::size_t state)
+	{
+		for (std::size_t p = parents_[state]; p != none; p = parents_[p])
+			if (p == ancestor)
+				return true;
+
+		return false;
+	}
+
+	static constexpr std::array<std::array<std::size_t, none>, none> lcas_ = [] {
+		std::array<std::array<std::size_t, none>, none> lcas {};
+
+		for (std::size_t a = 0; a < none; a++) {
+			for (std::size_t b = 0; b < none; b++) {
+				std::size_t lca = none;
+
+				if (is_ancestor(a, b)) {
+					lca = a;
+				} else if (is_ancestor(b, a)) {
+					lca = b;
+				} else {
+					for (std::size_t p = parents_[a]; p != none && lca == none; p = parents_[p])
+						if (is_ancestor(p, b))
+							lca = p;
+				}
+
+				lcas[a][b] = lca;
+			}
+		}
+
+		return lcas;
+	}();
+
+	static constexpr std::size_t max_depth_ = [] {
+		std::size_t max = 0;
+
+		for (std::size_t i = 0; i < none; i++)
+			if (depths_[i] > max)
+				max = depths_[i];
+
+		return max + 1;
+	}();
+
+	static constexpr bool valid_ = [] {
+		for (std::size_t i = 0; i < none; i++) {
+			if (depths_[i] >= none)
+				return false;
+			if (initials_[i] != none && !is_ancestor(i, initials_[i]))
+				return false;
+		}
+
+		return true;
+	}();
+
+	static_assert(valid_, "the hierarchy must be acyclic and initial states must be substates");
+
+	template <class State>
+	result call_handle(const event &e)
+	{
+		if constexpr (detail::has_handle<State, hsm<Context>>::value)
+			return State::handle(*this, e);
+		else
+			return unhandled;
+	}
+
+	template <class State>
+	void call_entry()
+	{
+		if constexpr (detail::has_entry<State, hsm<Context>>::value)
+			State::entry(*this);
+	}
+
+	template <class State>
+	void call_exit()
+	{
+		if constexpr (detail::has_exit<State, hsm<Context>>::value)
+			State::exit(*this);
+	}
+
+	/* the generated dispatch functions, selecting the handlers by index */
+	template <std::size_t... I>
+	result handle_at(std::size_t state, const event &e, std::index_sequence<I...>)
+	{
+		result r = unhandled;
+
+		(void) ((state == I && (r = call_handle<nth_t<I>>(e), true)) || ...);
+
+		return r;
+	}
+
+	template <std::size_t... I>
+	void entry_at(std::size_t state, std::index_sequence<I...>)
+	{
+		(void) ((state == I && (call_entry<nth_t<I>>(), true)) || ...);
+	}
+
+	template <std::size_t... I>
+	void exit_at(std::size_t state, std::index_sequence<I...>)
+	{
+		(void) ((state == I && (call_exit<nth_t<I>>(), true)) || ...);
+	}
+
+	template <std::size_t... I>
+	static std::size_t target_index(const void *tag, std::index_sequence<I...>)
+	{
+		std::size_t target = none;
+
+		(void) ((tag == &state_tag<nth_t<I>> && (target = I, true)) || ...);
+
+		return target;
+	}
+
+	/* enter the states below ancestor down to state */
+	void enter(std::size_t ancestor, std::size_t state)
+	{
+		std::size_t path[max_depth_];
+		std::size_t n = 0;
+
+		for (; state != ancestor; state = parents_[state])
+			path[n++] = state;
+
+		while (n > 0)
+			entry_at(path[--n], sequence_t());
+	}
+
+	/* the same sequence of exits, entries, and initial transitions as the C implementation */
+	void transition(std::size_t from, std::size_t to)
+	{
+		std::size_t lca = from == none ? none : lcas_[from][to];
+
+		for (; from != lca; from = parents_[from])
+			exit_at(from, sequence_t());
+
+		if (lca != to) {
+			enter(lca, to);
+
+			while (initials_[to] != none) {
+				enter(to, initials_[to]);
+				to = initials_[to];
+			}
+		}
+
+		this->current_ = static_cast<uint16_t>(to);
+	}
+
+	result process(const event &e)
+	{
+		bool consume = this->hsm_.propagation == MHSM_PROPAGATION_CONSUME;
+		bool was_handled = false;
+		result selected = unhandled;
+		std::size_t state, target;
+
+		for (state = this->current_; state != none; state = parents_[state]) {
+			result r = handle_at(state, e, sequence_t());
+
+			if (r.kind() == result::UNHANDLED)
+				continue;
+
+			if (r.kind() == result::HANDLED)
+				was_handled = true;
+			else if (selected.kind() == result::UNHANDLED)
+				/* the innermost transition or deferral wins */
+				selected = r;
+
+			if (consume)
+				break;
+		}
+
+		if (selected.kind() == result::TRANSITION) {
+			target = target_index(selected.target(), sequence_t());
+			MDBG_ASSERT(target != none);
+			if (target == none)
+				return unhandled;
+
+			transition(this->current_, target);
+
+			return selected;
+		}
+
+		if (selected.kind() == result::DEFERRED)
+			return deferred;
+
+		return was_handled ? handled : unhandled;
+	}
+
+	static mhsm_state_t *c_function(mhsm_hsm_t *c_hsm, mhsm_event_t e)
+	{
+		machine *m = reinterpret_cast<machine*>(c_hsm);
+
+		switch (e.id) {
+			case MHSM_EVENT_ENTRY:
+			case MHSM_EVENT_EXIT:
+				return &c_state_;
+			case MHSM_EVENT_INITIAL:
+				m->transition(none, 0);
+				return &c_state_;
+		}
+
+		switch (m->process(e).kind()) {
+			case result::DEFERRED:
+				return NULL;
+			case result::UNHANDLED:
+				return &c_state_;
+			default:
+				return MHSM_HANDLED;
+		}
+	}
+
+#ifndef NDEBUG
+	static inline mhsm_state_t c_state_ = { &c_function, NULL, "mbb::machine" };
+#else
+	static inline mhsm_state_t c_state_ = { &c_function, NULL };
+#endif
+};
+
+} /* namespace mbb */
+
+#endif /* MBB_HSM_HPP */
@@ -0,0 +1,136 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "latency.h"
+#include "types.h"
+#include "hsm.h"
+#include "histogram.h"
+#include "debug.h"
+
+static size_t _hash(mhsm_state_t *state, uint32_t event_id)
+{
+	uint64_t h = (uint64_t) (uintptr_t) state ^ ((uint64_t) event_id << 32);
+
+	h *= 0x9e3779b97f4a7c15ull;
+
+	return (size_t) (h >> 32);
+}
+
+int mhsm_latency_initialise(mhsm_latency_t *latency, mhsm_latency_entry_t *entries, size_t nrof_entries)
+{
+	if (nrof_entries == 0 || (nrof_entries & (nrof_entries - 1)) != 0) {
+		MDBG_PRINT_LN("number of entries must be a power of two");
+		return -1;
+	}
+
+	latency->entries = entries;
+	latency->mask = nrof_entries - 1;
+	latency->delays = NULL;
+	latency->nrof_delays = 0;
+	mhsm_latency_reset(latency);
+
+	return 0;
+}
+
+void mhsm_latency_reset(mhsm_latency_t *latency)
+{
+	size_t i;
+
+	for (i = 0; i <= latency->mask; i++)
+		latency->entries[i].state = NULL;
+
+	latency->count = 0;
+	mhst_reset(&latency->overflow);
+
+	for (i = 0; i < latency->nrof_delays; i++)
+		mhst_reset(latency->delays + i);
+	mhst_reset(&latency->delay_overflow);
+}
+
+void mhsm_latency_record(mhsm_latency_t *latency, mhsm_state_t *state, uint32_t event_id, uint64_t duration)
+{
+	mhsm_latency_entry_t *entry;
+	size_t i;
+
+	for (i = _hash(state, event_id) & latency->mask; ; i = (i + 1) & latency->mask) {
+		entry = latency->entries + i;
+
+		if (entry->state == state && entry->event_id == event_id)
+			break;
+
+		if (entry->state == NULL) {
+			/* keep one entry free to terminate probe sequences */
+			if (latency->count == latency->mask) {
+				mhst_record(&latency->overflow, duration);
+				return;
+			}
+
+			entry->state = state;
+			entry->event_id = event_id;
+			mhst_reset(&entry->histogram);
+			latency->count++;
+			break;
+		}
+	}
+
+	mhst_record(&entry->histogram, duration);
+}
+
+mhst_histogram_t *mhsm_latency_histogram(mhsm_latency_t *latency, mhsm_state_t *state, uint32_t event_id)
+{
+	mhsm_latency_entry_t *entry;
+	size_t i;
+
+	for (i = _hash(state, event_id) & latency->mask; latency->entries[i].state != NULL; i = (i + 1) & latency->mask) {
+		entry = latency->entries + i;
+		if (entry->state == state && entry->event_id == event_id)
+			return &entry->histogram;
+	}
+
+	return NULL;
+}
+
+void mhsm_latency_set_delays(mhsm_latency_t *latency, mhst_histogram_t *delays, size_t nrof_delays)
+{
+	size_t i;
+
+	latency->delays = delays;
+	latency->nrof_delays = nrof_delays;
+
+	for (i = 0; i < nrof_delays; i++)
+		mhst_reset(delays + i);
+	mhst_reset(&latency->delay_overflow);
+}
+
+void mhsm_latency_record_delay(mhsm_latency_t *latency, uint32_t event_id, uint64_t delay)
+{
+	if (event_id < latency->nrof_delays)
+		mhst_record(latency->delays + event_id, delay);
+	else
+		mhst_record(&latency->delay_overflow, delay);
+}
+
+mhst_histogram_t *mhsm_latency_delay_histogram(mhsm_latency_t *latency, uint32_t event_id)
+{
+	if (event_id >= latency->nrof_delays)
+		return NULL;
+
+	return latency->delays + event_id;
+}
@@ -0,0 +1,67 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_LATENCY_H
+#define MBB_LATENCY_H
+
+#include "types.h"
+#include "hsm.h"
+#include "histogram.h"
+
+/* 
+ * Handler latency histograms per (state, event) pair.
+ *
+ * If MHSM_LATENCY is defined every call of an event processing function of an
+ * HSM with a latency table is timed using MCLK_NOW() and recorded in the
+ * table. The table is an open-addressing hash table provided by the
+ * application. Pairs not fitting into it are recorded in a common overflow
+ * histogram. A table must only be used by a single thread.
+ *
+ * Optionally, the delays between queueing events and dispatching them are
+ * recorded per event id, too.
+ */
+
+typedef struct {
+	/* NULL if unused */
+	mhsm_state_t *state;
+	uint32_t event_id;
+	mhst_histogram_t histogram;
+} mhsm_latency_entry_t;
+
+struct mhsm_latency_s {
+	mhsm_latency_entry_t *entries;
+	size_t mask;
+	size_t count;
+	mhst_histogram_t overflow;
+	/* queueing delays indexed by event id */
+	mhst_histogram_t *delays;
+	size_t nrof_delays;
+	mhst_histogram_t delay_overflow;
+};
+
+int mhsm_latency_initialise(mhsm_latency_t *latency, mhsm_latency_entry_t *entries, size_t nrof_entries);
+void mhsm_latency_reset(mhsm_latency_t *latency);
+void mhsm_latency_record(mhsm_latency_t *latency, mhsm_state_t *state, uint32_t event_id, uint64_t duration);
+mhst_histogram_t *mhsm_latency_histogram(mhsm_latency_t *latency, mhsm_state_t *state, uint32_t event_id);
+void mhsm_latency_set_delays(mhsm_latency_t *latency, mhst_histogram_t *delays, size_t nrof_delays);
+void mhsm_latency_record_delay(mhsm_latency_t *latency, uint32_t event_id, uint64_t delay);
+mhst_histogram_t *mhsm_latency_delay_histogram(mhsm_latency_t *latency, uint32_t event_id);
+
+#endif /* MBB_LATENCY_H */
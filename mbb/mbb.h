@@ -0,0 +1,66 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_MBB_H
+#define MBB_MBB_H
+
+/*
+ * Header-only build of the HSM core: debugging functions, HSMs, and the
+ * periodic timer backend.
+ *
+ * Define MBB_IMPLEMENTATION in exactly one source file before including this
+ * header to compile the implementation into that file, so the compiler can
+ * inline the dispatching functions into the application's code. Additionally
+ * define MBB_STATIC to make all of them static, e.g. if several source files
+ * include the implementation or the application is also linked to libmbb.a.
+ * Each of these files then has its own copy of the core, so it must only
+ * dispatch events to HSMs of its own. MBB_STATIC is not supported by C++
+ * compilers.
+ *
+ * The instrumentation enabled by MHSM_LATENCY or MHSM_PROFILE and all other
+ * modules are still taken from libmbb.a.
+ */
+
+#ifdef MBB_STATIC
+# ifdef __GNUC__
+/* the application is not expected to use every function */
+#  define MBB_API static __attribute__((unused))
+# else
+#  define MBB_API static
+# endif
+#endif
+
+#include "types.h"
+#include "debug.h"
+#include "hsm.h"
+#include "timer_periodic.h"
+
+#endif /* MBB_MBB_H */
+
+#if defined(MBB_IMPLEMENTATION) && !defined(MBB_IMPLEMENTATION_INCLUDED)
+#define MBB_IMPLEMENTATION_INCLUDED
+
+#ifndef NDEBUG
+# include "debug.c"
+#endif
+#include "hsm.c"
+#include "timer_periodic.c"
+
+#endif /* MBB_IMPLEMENTATION */
@@ -0,0 +1,326 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "metrics.h"
+#include "types.h"
+#include "hsm.h"
+#include "clock.h"
+#include "timer_periodic.h"
+#include "debug.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __GNUC__
+# define _BARRIER() __sync_synchronize()
+#else
+# error "mbb/metrics.c needs a memory barrier for this compiler"
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+typedef struct {
+	char *buffer;
+	size_t size;
+	size_t pos;
+	bool overflow;
+} _cursor_t;
+
+static void _append(_cursor_t *c, const char *format, ...)
+{
+	va_list ap;
+	int n;
+
+	if (c->overflow)
+		return;
+
+	va_start(ap, format);
+	n = vsnprintf(c->buffer + c->pos, c->size - c->pos, format, ap);
+	va_end(ap);
+
+	if (n < 0 || (size_t) n >= c->size - c->pos)
+		c->overflow = 1;
+	else
+		c->pos += n;
+}
+
+static void _metric(_cursor_t *c, const char *name, const char *type, const char *help, double value)
+{
+	_append(c, "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name, type, name, value);
+}
+
+#ifdef MHSM_LATENCY
+static void _summary(_cursor_t *c, const char *name, const char *help, const mhst_histogram_t *histogram)
+{
+	_append(c, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+	_append(c, "%s{quantile=\"0.5\"} %llu\n", name, (unsigned long long) mhst_quantile(histogram, 500));
+	_append(c, "%s{quantile=\"0.99\"} %llu\n", name, (unsigned long long) mhst_quantile(histogram, 990));
+	_append(c, "%s{quantile=\"0.999\"} %llu\n", name, (unsigned long long) mhst_quantile(histogram, 999));
+	_append(c, "%s_count %lu\n", name, (unsigned long) mhst_count(histogram));
+}
+#endif
+
+static void _read(mhsm_metrics_source_t *source, mhsm_metrics_sample_t *sample)
+{
+	uint32_t sequence;
+
+	do {
+		while ((sequence = source->sequence) & 1)
+			;
+		_BARRIER();
+		memcpy(sample, &source->sample, sizeof(*sample));
+		_BARRIER();
+	} while (sequence != source->sequence);
+}
+
+static void _add(mhsm_metrics_sample_t *total, const mhsm_metrics_sample_t *sample)
+{
+	total->nrof_hsms += sample->nrof_hsms;
+	total->nrof_active_timers += sample->nrof_active_timers;
+	if (sample->queue_depth > total->queue_depth)
+		total->queue_depth = sample->queue_depth;
+#ifdef MHSM_STATISTICS
+	total->stats.dispatched += sample->stats.dispatched;
+	total->stats.handled += sample->stats.handled;
+	total->stats.deferred += sample->stats.deferred;
+	total->stats.dropped += sample->stats.dropped;
+	total->stats.transitions += sample->stats.transitions;
+	total->stats.entries += sample->stats.entries;
+	total->stats.exits += sample->stats.exits;
+	if (sample->stats.max_queue_depth > total->stats.max_queue_depth)
+		total->stats.max_queue_depth = sample->stats.max_queue_depth;
+#endif
+#ifdef MHSM_LATENCY
+	mhst_merge(&total->latency, &sample->latency);
+	mhst_merge(&total->delay, &sample->delay);
+#endif
+}
+
+void mhsm_metrics_reset_sample(mhsm_metrics_sample_t *sample)
+{
+	memset(sample, 0, sizeof(*sample));
+}
+
+void mhsm_metrics_add_hsm(mhsm_metrics_sample_t *sample, mhsm_hsm_t *hsm, size_t nrof_timers)
+{
+	mtmr_prd_t *timers = (mtmr_prd_t*) mhsm_context(hsm);
+	size_t i;
+
+	sample->nrof_hsms++;
+
+	for (i = 0; i < nrof_timers; i++)
+		if (timers[i].active)
+			sample->nrof_active_timers++;
+
+	if (mhsm_queue_length(hsm) > sample->queue_depth)
+		sample->queue_depth = mhsm_queue_length(hsm);
+
+#ifdef MHSM_STATISTICS
+	mhsm_accumulate_stats(&sample->stats, hsm);
+#endif
+}
+
+#ifdef MHSM_LATENCY
+void mhsm_metrics_add_latency(mhsm_metrics_sample_t *sample, mhsm_latency_t *latency)
+{
+	size_t i;
+
+	for (i = 0; i <= latency->mask; i++)
+		if (latency->entries[i].state != NULL)
+			mhst_merge(&sample->latency, &latency->entries[i].histogram);
+	mhst_merge(&sample->latency, &latency->overflow);
+
+	for (i = 0; i < latency->nrof_delays; i++)
+		mhst_merge(&sample->delay, latency->delays + i);
+	mhst_merge(&sample->delay, &latency->delay_overflow);
+}
+#endif
+
+void mhsm_metrics_initialise_source(mhsm_metrics_source_t *source)
+{
+	source->sequence = 0;
+	mhsm_metrics_reset_sample(&source->sample);
+}
+
+void mhsm_metrics_publish(mhsm_metrics_source_t *source, const mhsm_metrics_sample_t *sample)
+{
+	source->sequence++;
+	_BARRIER();
+	memcpy(&source->sample, sample, sizeof(*sample));
+	_BARRIER();
+	source->sequence++;
+}
+
+void mhsm_metrics_initialise_exporter(mhsm_metrics_exporter_t *exporter, mhsm_metrics_source_t *sources, size_t nrof_sources)
+{
+	exporter->sources = sources;
+	exporter->nrof_sources = nrof_sources;
+	mhsm_metrics_reset_sample(&exporter->total);
+	exporter->last_time = 0;
+	exporter->last_dispatched = 0;
+	exporter->events_per_second = 0;
+}
+
+void mhsm_metrics_collect(mhsm_metrics_exporter_t *exporter)
+{
+	mhsm_metrics_sample_t sample;
+	size_t i;
+#ifdef MHSM_STATISTICS
+	uint64_t now = mclk_now();
+#endif
+
+	mhsm_metrics_reset_sample(&exporter->total);
+
+	for (i = 0; i < exporter->nrof_sources; i++) {
+		_read(exporter->sources + i, &sample);
+		_add(&exporter->total, &sample);
+	}
+
+#ifdef MHSM_STATISTICS
+	if (exporter->last_time != 0 && now > exporter->last_time)
+		exporter->events_per_second = (double) (uint32_t) (exporter->total.stats.dispatched - exporter->last_dispatched) * 1e9 / (now - exporter->last_time);
+	exporter->last_time = now;
+	exporter->last_dispatched = exporter->total.stats.dispatched;
+#endif
+}
+
+int mhsm_metrics_format(mhsm_metrics_exporter_t *exporter, char *buffer, size_t size)
+{
+	mhsm_metrics_sample_t *total = &exporter->total;
+	_cursor_t c;
+
+	c.buffer = buffer;
+	c.size = size;
+	c.pos = 0;
+	c.overflow = 0;
+
+	_metric(&c, "mhsm_hsms", "gauge", "Number of HSMs.", total->nrof_hsms);
+	_metric(&c, "mhsm_active_timers", "gauge", "Number of active periodic timers.", total->nrof_active_timers);
+	_metric(&c, "mhsm_deferred_queue_depth", "gauge", "Maximum number of deferred events queued by an HSM.", total->queue_depth);
+#ifdef MHSM_STATISTICS
+	_metric(&c, "mhsm_events_per_second", "gauge", "Events dispatched per second since the last collection.", exporter->events_per_second);
+	_metric(&c, "mhsm_events_dispatched_total", "counter", "Events dispatched to active states.", total->stats.dispatched);
+	_metric(&c, "mhsm_events_handled_total", "counter", "Events triggering a transition or returning MHSM_HANDLED.", total->stats.handled);
+	_metric(&c, "mhsm_events_deferred_total", "counter", "Events deferred.", total->stats.deferred);
+	_metric(&c, "mhsm_events_dropped_total", "counter", "Events dropped because the deferred event queue was full.", total->stats.dropped);
+	_metric(&c, "mhsm_transitions_total", "counter", "State transitions.", total->stats.transitions);
+	_metric(&c, "mhsm_entries_total", "counter", "Entry events dispatched.", total->stats.entries);
+	_metric(&c, "mhsm_exits_total", "counter", "Exit events dispatched.", total->stats.exits);
+	_metric(&c, "mhsm_deferred_queue_depth_max", "gauge", "Maximum number of deferred events ever queued by an HSM.", total->stats.max_queue_depth);
+#endif
+#ifdef MHSM_LATENCY
+	_summary(&c, "mhsm_handler_latency", "Duration of event processing functions in clock ticks.", &total->latency);
+	_summary(&c, "mhsm_queueing_delay", "Delay of queued events until their dispatch in clock ticks.", &total->delay);
+#endif
+
+	if (c.overflow) {
+		MDBG_PRINT_LN("metrics buffer too small");
+		return -1;
+	}
+
+	return c.pos;
+}
+
+int mhsm_metrics_write_file(mhsm_metrics_exporter_t *exporter, const char *path)
+{
+	char buffer[MHSM_METRICS_BUFFER_SIZE];
+	char tmp_path[256];
+	FILE *file;
+	int length;
+
+	length = mhsm_metrics_format(exporter, buffer, sizeof(buffer));
+	if (length < 0)
+		return -1;
+
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int) sizeof(tmp_path))
+		return -1;
+
+	/* readers never see partially written files */
+	file = fopen(tmp_path, "w");
+	if (file == NULL)
+		return -1;
+
+	if (fwrite(buffer, 1, length, file) != (size_t) length) {
+		fclose(file);
+		remove(tmp_path);
+		return -1;
+	}
+
+	if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+		remove(tmp_path);
+		return -1;
+	}
+
+	return 0;
+}
+
+int mhsm_metrics_listen(const char *path)
+{
+	struct sockaddr_un address;
+	int fd;
+
+	if (strlen(path) >= sizeof(address.sun_path))
+		return -1;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0
+			|| listen(fd, 8) != 0
+			|| fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int mhsm_metrics_serve(mhsm_metrics_exporter_t *exporter, int listen_fd)
+{
+	char buffer[MHSM_METRICS_BUFFER_SIZE];
+	int nserved = 0;
+	int length;
+	int fd;
+
+	length = mhsm_metrics_format(exporter, buffer, sizeof(buffer));
+	if (length < 0)
+		return -1;
+
+	/* answer all pending connections, listen_fd is non-blocking */
+	while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+		if (send(fd, buffer, length, MSG_NOSIGNAL) == length)
+			nserved++;
+		close(fd);
+	}
+
+	return nserved;
+}
@@ -0,0 +1,92 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_METRICS_H
+#define MBB_METRICS_H
+
+#include "types.h"
+#include "hsm.h"
+#ifdef MHSM_LATENCY
+# include "histogram.h"
+# include "latency.h"
+#endif
+
+/* 
+ * Export of HSM metrics in the Prometheus text format.
+ *
+ * Each dispatching thread periodically fills a sample with the metrics of its
+ * HSMs and publishes it to its source. Publishing is a copy protected by a
+ * sequence lock, so it never blocks. An exporter running in another thread
+ * collects the latest samples of all sources, sums them up, and writes them
+ * to a file or to clients of a Unix socket.
+ */
+
+typedef struct {
+	uint32_t nrof_hsms;
+	uint32_t nrof_active_timers;
+	/* the maximum over all HSMs */
+	uint32_t queue_depth;
+#ifdef MHSM_STATISTICS
+	mhsm_stats_t stats;
+#endif
+#ifdef MHSM_LATENCY
+	mhst_histogram_t latency;
+	mhst_histogram_t delay;
+#endif
+} mhsm_metrics_sample_t;
+
+typedef struct {
+	/* odd while a sample is being published */
+	volatile uint32_t sequence;
+	mhsm_metrics_sample_t sample;
+} mhsm_metrics_source_t;
+
+typedef struct {
+	mhsm_metrics_source_t *sources;
+	size_t nrof_sources;
+	mhsm_metrics_sample_t total;
+	/* for computing rates */
+	uint64_t last_time;
+	uint32_t last_dispatched;
+	double events_per_second;
+} mhsm_metrics_exporter_t;
+
+/* dispatching threads */
+void mhsm_metrics_reset_sample(mhsm_metrics_sample_t *sample);
+void mhsm_metrics_add_hsm(mhsm_metrics_sample_t *sample, mhsm_hsm_t *hsm, size_t nrof_timers);
+#ifdef MHSM_LATENCY
+void mhsm_metrics_add_latency(mhsm_metrics_sample_t *sample, mhsm_latency_t *latency);
+#endif
+void mhsm_metrics_initialise_source(mhsm_metrics_source_t *source);
+void mhsm_metrics_publish(mhsm_metrics_source_t *source, const mhsm_metrics_sample_t *sample);
+
+/* exporting thread */
+void mhsm_metrics_initialise_exporter(mhsm_metrics_exporter_t *exporter, mhsm_metrics_source_t *sources, size_t nrof_sources);
+void mhsm_metrics_collect(mhsm_metrics_exporter_t *exporter);
+int mhsm_metrics_format(mhsm_metrics_exporter_t *exporter, char *buffer, size_t size);
+int mhsm_metrics_write_file(mhsm_metrics_exporter_t *exporter, const char *path);
+int mhsm_metrics_listen(const char *path);
+int mhsm_metrics_serve(mhsm_metrics_exporter_t *exporter, int listen_fd);
+
+#ifndef MHSM_METRICS_BUFFER_SIZE
+# define MHSM_METRICS_BUFFER_SIZE 4096
+#endif
+
+#endif /* MBB_METRICS_H */
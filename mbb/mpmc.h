@@ -0,0 +1,171 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_MPMC_H
+#define MBB_MPMC_H
+
+#include "types.h"
+#include <stddef.h>
+
+/* 
+ * Type-safe fixed-capacity multi-producer multi-consumer queues.
+ *
+ * Any number of threads may enqueue and dequeue concurrently without locking.
+ * Every slot carries a sequence number telling whether it is ready to be
+ * written or read in the current lap around the queue, so producers and
+ * consumers only contend on their own position counter, which they advance
+ * using compare-and-swap, and otherwise touch just the slot they claimed.
+ *
+ * Since checking and enqueueing or dequeueing cannot be separated with
+ * several threads involved, MMPMC_TRY_ENQUEUE() and MMPMC_TRY_DEQUEUE() set a
+ * flag telling whether they succeeded.
+ *
+ * Example:
+ *
+ * MMPMC_DEFINE_STRUCT(int, 64) event_queue;
+ *
+ * MMPMC_INITIALISE(&event_queue);
+ *
+ * producers:
+ * {
+ *	bool ok;
+ *
+ *	MMPMC_TRY_ENQUEUE(&event_queue, 4, ok);
+ *	if (!ok) printf("queue full\n");
+ * }
+ *
+ * consumers:
+ * {
+ *	bool ok;
+ *	int event;
+ *
+ *	for (;;) {
+ *		MMPMC_TRY_DEQUEUE(&event_queue, event, ok);
+ *		if (!ok) break;
+ *		printf("event: %d\n", event);
+ *	}
+ * }
+ */
+
+#ifndef MMPMC_CACHE_LINE
+#define MMPMC_CACHE_LINE 64
+#endif
+
+/* override for compilers lacking the GCC __atomic builtins */
+#ifndef MMPMC_LOAD_RELAXED
+#define MMPMC_LOAD_RELAXED(P) __atomic_load_n(P, __ATOMIC_RELAXED)
+#endif
+
+#ifndef MMPMC_LOAD_ACQUIRE
+#define MMPMC_LOAD_ACQUIRE(P) __atomic_load_n(P, __ATOMIC_ACQUIRE)
+#endif
+
+#ifndef MMPMC_STORE_RELEASE
+#define MMPMC_STORE_RELEASE(P, V) __atomic_store_n(P, V, __ATOMIC_RELEASE)
+#endif
+
+/* on failure *EXPECTED is set to the current value */
+#ifndef MMPMC_COMPARE_EXCHANGE
+#define MMPMC_COMPARE_EXCHANGE(P, EXPECTED, DESIRED) \
+	__atomic_compare_exchange_n(P, EXPECTED, DESIRED, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#endif
+
+/* 
+ * A slot at index i is free for the producer at position pos if its sequence
+ * equals pos, and holds an element for the consumer at position pos if its
+ * sequence equals pos + 1. Dequeueing sets it to pos + capacity, the
+ * producer's position in the next lap. The capacity must be at least 2,
+ * otherwise a full slot looks free to the next producer, so smaller
+ * capacities give a negative array size. A capacity which is a power of two
+ * turns the modulo into a mask, other capacities only work until SIZE_MAX
+ * elements have passed the queue.
+ */
+#define MMPMC_DEFINE_STRUCT(TYPE, CAPACITY) \
+struct { \
+	size_t enqueue_position; \
+	char producer_padding[MMPMC_CACHE_LINE]; \
+	size_t dequeue_position; \
+	char consumer_padding[MMPMC_CACHE_LINE]; \
+	struct { \
+		size_t sequence; \
+		TYPE value; \
+	} slots[(CAPACITY) >= 2 ? (CAPACITY) : -1]; \
+}
+
+#define MMPMC_CAPACITY(Q) (sizeof((Q)->slots) / sizeof((Q)->slots[0]))
+
+#define MMPMC_INITIALISE(Q) do { \
+	size_t mmpmc_i; \
+	for (mmpmc_i = 0; mmpmc_i < MMPMC_CAPACITY(Q); mmpmc_i++) \
+		(Q)->slots[mmpmc_i].sequence = mmpmc_i; \
+	(Q)->enqueue_position = 0; \
+	(Q)->dequeue_position = 0; \
+} while (0)
+
+#define MMPMC_TRY_ENQUEUE(Q, ELEMENT, OK) do { \
+	size_t mmpmc_pos = MMPMC_LOAD_RELAXED(&(Q)->enqueue_position); \
+	(OK) = 0; \
+	for (;;) { \
+		size_t mmpmc_index = mmpmc_pos % MMPMC_CAPACITY(Q); \
+		ptrdiff_t mmpmc_diff = (ptrdiff_t) \
+			(MMPMC_LOAD_ACQUIRE(&(Q)->slots[mmpmc_index].sequence) - mmpmc_pos); \
+		if (mmpmc_diff == 0) { \
+			if (MMPMC_COMPARE_EXCHANGE(&(Q)->enqueue_position, &mmpmc_pos, mmpmc_pos + 1)) { \
+				(Q)->slots[mmpmc_index].value = ELEMENT; \
+				MMPMC_STORE_RELEASE(&(Q)->slots[mmpmc_index].sequence, mmpmc_pos + 1); \
+				(OK) = 1; \
+				break; \
+			} \
+		} else if (mmpmc_diff < 0) { \
+			break; \
+		} else { \
+			mmpmc_pos = MMPMC_LOAD_RELAXED(&(Q)->enqueue_position); \
+		} \
+	} \
+} while (0)
+
+#define MMPMC_TRY_DEQUEUE(Q, X, OK) do { \
+	size_t mmpmc_pos = MMPMC_LOAD_RELAXED(&(Q)->dequeue_position); \
+	(OK) = 0; \
+	for (;;) { \
+		size_t mmpmc_index = mmpmc_pos % MMPMC_CAPACITY(Q); \
+		ptrdiff_t mmpmc_diff = (ptrdiff_t) \
+			(MMPMC_LOAD_ACQUIRE(&(Q)->slots[mmpmc_index].sequence) - (mmpmc_pos + 1)); \
+		if (mmpmc_diff == 0) { \
+			if (MMPMC_COMPARE_EXCHANGE(&(Q)->dequeue_position, &mmpmc_pos, mmpmc_pos + 1)) { \
+				(X) = (Q)->slots[mmpmc_index].value; \
+				MMPMC_STORE_RELEASE(&(Q)->slots[mmpmc_index].sequence, \
+						mmpmc_pos + MMPMC_CAPACITY(Q)); \
+				(OK) = 1; \
+				break; \
+			} \
+		} else if (mmpmc_diff < 0) { \
+			break; \
+		} else { \
+			mmpmc_pos = MMPMC_LOAD_RELAXED(&(Q)->dequeue_position); \
+		} \
+	} \
+} while (0)
+
+/* a snapshot, only exact if no thread is using the queue */
+#define MMPMC_LENGTH(Q) \
+	(MMPMC_LOAD_ACQUIRE(&(Q)->enqueue_position) - MMPMC_LOAD_ACQUIRE(&(Q)->dequeue_position))
+
+#endif /* MBB_MPMC_H */
@@ -0,0 +1,200 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_POOL_H
+#define MBB_POOL_H
+
+#include "types.h"
+
+/* 
+ * Type-safe fixed-capacity object pools.
+ *
+ * A pool hands out pointers to elements of a static array. Free elements are
+ * linked through an intrusive free list, allocating and freeing are O(1).
+ * Elements which have never been allocated are handed out in order, so a
+ * zero-initialised pool is ready to use and does not have to touch all of its
+ * memory up front.
+ *
+ * Example:
+ *
+ * MPOOL_DEFINE_STRUCT(my_context_t, 128) context_pool = MPOOL_INITIALISER;
+ *
+ * {
+ *	my_context_t *ctx;
+ *
+ *	MPOOL_ALLOC(&context_pool, ctx);
+ *	if (ctx == NULL) return -1;
+ *
+ *	...
+ *
+ *	MPOOL_FREE(&context_pool, ctx);
+ * }
+ */
+
+#ifndef MPOOL_CACHE_LINE
+#define MPOOL_CACHE_LINE 64
+#endif
+
+/* override for compilers lacking the GCC aligned attribute */
+#ifndef MPOOL_ALIGNED
+#define MPOOL_ALIGNED __attribute__((aligned(MPOOL_CACHE_LINE)))
+#endif
+
+/* 
+ * MPOOL_ALLOC() and MPOOL_FREE() call these around accessing the pool, define
+ * them to share a pool between threads, e.g. locking a mutex.
+ */
+#ifndef MPOOL_LOCK
+#define MPOOL_LOCK(P) do {} while (0)
+#endif
+
+#ifndef MPOOL_UNLOCK
+#define MPOOL_UNLOCK(P) do {} while (0)
+#endif
+
+/* free_list is the index of the first free element plus one, 0 if empty */
+#define MPOOL_DEFINE_STRUCT(TYPE, CAPACITY) \
+struct { \
+	size_t free_list; \
+	size_t fresh; \
+	size_t count; \
+	union { \
+		TYPE object; \
+		size_t next; \
+	} slots[CAPACITY]; \
+}
+
+/* every element starts on a cache line of its own */
+#define MPOOL_DEFINE_ALIGNED_STRUCT(TYPE, CAPACITY) \
+struct { \
+	size_t free_list; \
+	size_t fresh; \
+	size_t count; \
+	union MPOOL_ALIGNED { \
+		TYPE object; \
+		size_t next; \
+	} slots[CAPACITY]; \
+}
+
+#define MPOOL_CAPACITY(P) (sizeof((P)->slots) / sizeof((P)->slots[0]))
+
+#define MPOOL_INITIALISER { 0, 0, 0 }
+
+#define MPOOL_INITIALISE(P) do { \
+	(P)->free_list = 0; \
+	(P)->fresh = 0; \
+	(P)->count = 0; \
+} while (0)
+
+/* number of allocated elements, including those held by caches */
+#define MPOOL_COUNT(P) (P)->count
+
+#define MPOOL_IS_EXHAUSTED(P) (MPOOL_COUNT(P) == MPOOL_CAPACITY(P))
+
+/* the index of an element, PTR must have been allocated from P */
+#define MPOOL_INDEX(P, PTR) \
+	((size_t) ((char*) (PTR) - (char*) (P)->slots) / sizeof((P)->slots[0]))
+
+/* unlocked, sets INDEX to MPOOL_CAPACITY(P) if the pool is exhausted */
+#define MPOOL__TAKE(P, INDEX) do { \
+	if ((P)->free_list != 0) { \
+		(INDEX) = (P)->free_list - 1; \
+		(P)->free_list = (P)->slots[INDEX].next; \
+	} else if ((P)->fresh < MPOOL_CAPACITY(P)) { \
+		(INDEX) = (P)->fresh++; \
+	} else { \
+		(INDEX) = MPOOL_CAPACITY(P); \
+		break; \
+	} \
+	(P)->count += 1; \
+} while (0)
+
+#define MPOOL__GIVE(P, INDEX) do { \
+	size_t mpool_given = (INDEX); \
+	(P)->slots[mpool_given].next = (P)->free_list; \
+	(P)->free_list = mpool_given + 1; \
+	(P)->count -= 1; \
+} while (0)
+
+#define MPOOL_ALLOC(P, PTR) do { \
+	size_t mpool_index; \
+	MPOOL_LOCK(P); \
+	MPOOL__TAKE(P, mpool_index); \
+	MPOOL_UNLOCK(P); \
+	(PTR) = mpool_index < MPOOL_CAPACITY(P) ? &(P)->slots[mpool_index].object : NULL; \
+} while (0)
+
+#define MPOOL_FREE(P, PTR) do { \
+	size_t mpool_index = MPOOL_INDEX(P, PTR); \
+	MPOOL_LOCK(P); \
+	MPOOL__GIVE(P, mpool_index); \
+	MPOOL_UNLOCK(P); \
+} while (0)
+
+/* 
+ * Caches of free elements, e.g. one per thread, take elements from and return
+ * them to the pool in batches of half their size, so the pool's lock is only
+ * taken once per batch.
+ *
+ * static __thread MPOOL_DEFINE_CACHE_STRUCT(16) cache = MPOOL_CACHE_INITIALISER;
+ */
+#define MPOOL_DEFINE_CACHE_STRUCT(SIZE) \
+struct { \
+	size_t count; \
+	size_t indices[SIZE]; \
+}
+
+#define MPOOL_CACHE_SIZE(C) (sizeof((C)->indices) / sizeof((C)->indices[0]))
+
+#define MPOOL_CACHE_INITIALISER { 0 }
+
+#define MPOOL_CACHED_ALLOC(P, C, PTR) do { \
+	if ((C)->count == 0) { \
+		MPOOL_LOCK(P); \
+		while ((C)->count < (MPOOL_CACHE_SIZE(C) + 1) / 2) { \
+			size_t mpool_index; \
+			MPOOL__TAKE(P, mpool_index); \
+			if (mpool_index == MPOOL_CAPACITY(P)) break; \
+			(C)->indices[(C)->count++] = mpool_index; \
+		} \
+		MPOOL_UNLOCK(P); \
+	} \
+	(PTR) = (C)->count > 0 ? &(P)->slots[(C)->indices[--(C)->count]].object : NULL; \
+} while (0)
+
+#define MPOOL_CACHED_FREE(P, C, PTR) do { \
+	if ((C)->count == MPOOL_CACHE_SIZE(C)) { \
+		MPOOL_LOCK(P); \
+		while ((C)->count > MPOOL_CACHE_SIZE(C) / 2) \
+			MPOOL__GIVE(P, (C)->indices[--(C)->count]); \
+		MPOOL_UNLOCK(P); \
+	} \
+	(C)->indices[(C)->count++] = MPOOL_INDEX(P, PTR); \
+} while (0)
+
+/* return all cached elements to the pool, e.g. before a thread exits */
+#define MPOOL_CACHE_FLUSH(P, C) do { \
+	MPOOL_LOCK(P); \
+	while ((C)->count > 0) \
+		MPOOL__GIVE(P, (C)->indices[--(C)->count]); \
+	MPOOL_UNLOCK(P); \
+} while (0)
+
+#endif /* MBB_POOL_H */
@@ -0,0 +1,178 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "profile.h"
+#include "types.h"
+#include "hsm.h"
+#include "debug.h"
+#include <stdio.h>
+
+static size_t _hash(mhsm_state_t *from, mhsm_state_t *to)
+{
+	uint64_t h = (uint64_t) (uintptr_t) from * 31 + (uint64_t) (uintptr_t) to;
+
+	h *= 0x9e3779b97f4a7c15ull;
+
+	return (size_t) (h >> 32);
+}
+
+/* returns the entry of a pair, adding it if necessary, or NULL if the table is full */
+static mhsm_profile_entry_t *_entry(mhsm_profile_t *profile, mhsm_state_t *from, mhsm_state_t *to)
+{
+	mhsm_profile_entry_t *entry;
+	size_t i;
+
+	for (i = _hash(from, to) & profile->mask; ; i = (i + 1) & profile->mask) {
+		entry = profile->entries + i;
+
+		if (entry->from == from && entry->to == to)
+			return entry;
+
+		if (entry->from == NULL) {
+			/* keep one entry free to terminate probe sequences */
+			if (profile->count == profile->mask) {
+				profile->dropped++;
+				return NULL;
+			}
+
+			entry->from = from;
+			entry->to = to;
+			entry->count = 0;
+			entry->time = 0;
+			profile->count++;
+
+			return entry;
+		}
+	}
+}
+
+/* writes the names of a state and its ancestors separated by sep, outermost first */
+static int _write_path(FILE *file, mhsm_state_t *state, char sep)
+{
+	if (state->parent != NULL && _write_path(file, state->parent, sep) < 0)
+		return -1;
+
+	if (state->parent != NULL && fputc(sep, file) == EOF)
+		return -1;
+
+#ifndef NDEBUG
+	return fputs(state->name, file) < 0 ? -1 : 0;
+#else
+	/* no names in release builds */
+	return fprintf(file, "state_%lx", (unsigned long) (uintptr_t) state) < 0 ? -1 : 0;
+#endif
+}
+
+int mhsm_profile_initialise(mhsm_profile_t *profile, mhsm_profile_entry_t *entries, size_t nrof_entries)
+{
+	if (nrof_entries == 0 || (nrof_entries & (nrof_entries - 1)) != 0) {
+		MDBG_PRINT_LN("number of entries must be a power of two");
+		return -1;
+	}
+
+	profile->entries = entries;
+	profile->mask = nrof_entries - 1;
+	mhsm_profile_reset(profile);
+
+	return 0;
+}
+
+void mhsm_profile_reset(mhsm_profile_t *profile)
+{
+	size_t i;
+
+	for (i = 0; i <= profile->mask; i++)
+		profile->entries[i].from = NULL;
+
+	profile->count = 0;
+	profile->dropped = 0;
+}
+
+void mhsm_profile_record_residency(mhsm_profile_t *profile, mhsm_state_t *state, uint64_t time)
+{
+	mhsm_profile_entry_t *entry = _entry(profile, state, NULL);
+
+	if (entry != NULL)
+		entry->time += time;
+}
+
+void mhsm_profile_record_transition(mhsm_profile_t *profile, mhsm_state_t *from, mhsm_state_t *to)
+{
+	mhsm_profile_entry_t *entry;
+
+	if (from != NULL) {
+		entry = _entry(profile, from, to);
+		if (entry != NULL)
+			entry->count++;
+	}
+
+	/* count the visit of to */
+	entry = _entry(profile, to, NULL);
+	if (entry != NULL)
+		entry->count++;
+}
+
+mhsm_profile_entry_t *mhsm_profile_lookup(mhsm_profile_t *profile, mhsm_state_t *from, mhsm_state_t *to)
+{
+	mhsm_profile_entry_t *entry;
+	size_t i;
+
+	for (i = _hash(from, to) & profile->mask; profile->entries[i].from != NULL; i = (i + 1) & profile->mask) {
+		entry = profile->entries + i;
+		if (entry->from == from && entry->to == to)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * Writes one line per entry:
+ *
+ * residency <outer;...;state> <time> <visits>
+ * transition <outer;...;from> <outer;...;to> <count>
+ */
+int mhsm_profile_write(FILE *file, mhsm_profile_t *profile)
+{
+	mhsm_profile_entry_t *entry;
+	size_t i;
+
+	for (i = 0; i <= profile->mask; i++) {
+		entry = profile->entries + i;
+		if (entry->from == NULL)
+			continue;
+
+		if (fputs(entry->to == NULL ? "residency " : "transition ", file) < 0
+				|| _write_path(file, entry->from, ';') < 0)
+			return -1;
+
+		if (entry->to == NULL) {
+			if (fprintf(file, " %llu %lu\n", (unsigned long long) entry->time, (unsigned long) entry->count) < 0)
+				return -1;
+		} else {
+			if (fputc(' ', file) == EOF
+					|| _write_path(file, entry->to, ';') < 0
+					|| fprintf(file, " %lu\n", (unsigned long) entry->count) < 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_PROFILE_H
+#define MBB_PROFILE_H
+
+#include "types.h"
+#include "hsm.h"
+#include <stdio.h>
+
+/* 
+ * State residency profiles.
+ *
+ * If MHSM_PROFILE is defined HSMs with a profile record how long they stay in
+ * their (innermost) states and how often they transition from one state to
+ * another. A profile is an open-addressing hash table of (from, to) pairs
+ * provided by the application. Entries with to == NULL hold the residency of
+ * from, i.e. the number of visits and the time spent in it. Pairs not fitting
+ * into the table are counted in dropped. A profile must only be used by a
+ * single thread.
+ */
+
+typedef struct {
+	/* NULL if unused */
+	mhsm_state_t *from;
+	mhsm_state_t *to;
+	/* number of transitions, or visits if to == NULL */
+	uint32_t count;
+	/* MCLK_NOW() ticks spent in from if to == NULL */
+	uint64_t time;
+} mhsm_profile_entry_t;
+
+struct mhsm_profile_s {
+	mhsm_profile_entry_t *entries;
+	size_t mask;
+	size_t count;
+	uint32_t dropped;
+};
+
+int mhsm_profile_initialise(mhsm_profile_t *profile, mhsm_profile_entry_t *entries, size_t nrof_entries);
+void mhsm_profile_reset(mhsm_profile_t *profile);
+void mhsm_profile_record_residency(mhsm_profile_t *profile, mhsm_state_t *state, uint64_t time);
+void mhsm_profile_record_transition(mhsm_profile_t *profile, mhsm_state_t *from, mhsm_state_t *to);
+mhsm_profile_entry_t *mhsm_profile_lookup(mhsm_profile_t *profile, mhsm_state_t *from, mhsm_state_t *to);
+int mhsm_profile_write(FILE *file, mhsm_profile_t *profile);
+
+#endif /* MBB_PROFILE_H */
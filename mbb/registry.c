@@ -0,0 +1,206 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "registry.h"
+#include "types.h"
+#include "hsm.h"
+#include "debug.h"
+
+/*
+ * Slots are empty if their hsm is NULL. Removal shifts the following entries
+ * of a probe sequence backwards, so there are no tombstones and lookups of
+ * missing keys stop at the first empty slot.
+ */
+
+static bool _is_power_of_two(size_t n)
+{
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+/* splitmix64 finaliser */
+static uint64_t _hash(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= UINT64_C(0xbf58476d1ce4e5b9);
+	key ^= key >> 27;
+	key *= UINT64_C(0x94d049bb133111eb);
+	key ^= key >> 31;
+
+	return key;
+}
+
+/* the upper bits of the hash select the shard, the lower bits the slot */
+static size_t _shard_index(mhsm_registry_t *registry, uint64_t hash)
+{
+	if (registry->nrof_shards == 1)
+		return 0;
+
+	return hash >> registry->shard_shift;
+}
+
+static mhsm_registry_entry_t *_find(mhsm_registry_shard_t *shard, uint64_t key, uint64_t hash)
+{
+	size_t i;
+
+	for (i = hash & shard->mask; shard->entries[i].hsm != NULL; i = (i + 1) & shard->mask)
+		if (shard->entries[i].key == key)
+			return shard->entries + i;
+
+	return NULL;
+}
+
+int mhsm_registry_initialise(mhsm_registry_t *registry, mhsm_registry_shard_t *shards, size_t nrof_shards, mhsm_registry_entry_t *entries, size_t entries_per_shard)
+{
+	size_t i, j;
+
+	if (!_is_power_of_two(nrof_shards) || !_is_power_of_two(entries_per_shard))
+		return -1;
+
+	registry->shards = shards;
+	registry->nrof_shards = nrof_shards;
+	registry->dispatch_hook = NULL;
+	registry->hook_arg = NULL;
+	for (registry->shard_shift = 64; nrof_shards > 1; nrof_shards >>= 1)
+		registry->shard_shift--;
+
+	for (i = 0; i < registry->nrof_shards; i++) {
+		mhsm_registry_shard_t *shard = shards + i;
+
+		shard->entries = entries + i * entries_per_shard;
+		shard->mask = entries_per_shard - 1;
+		shard->count = 0;
+
+		for (j = 0; j < entries_per_shard; j++)
+			shard->entries[j].hsm = NULL;
+	}
+
+	return 0;
+}
+
+size_t mhsm_registry_shard(mhsm_registry_t *registry, uint64_t key)
+{
+	return _shard_index(registry, _hash(key));
+}
+
+int mhsm_registry_insert(mhsm_registry_t *registry, uint64_t key, mhsm_hsm_t *hsm)
+{
+	uint64_t hash = _hash(key);
+	mhsm_registry_shard_t *shard = registry->shards + _shard_index(registry, hash);
+	size_t i;
+
+	MDBG_ASSERT(hsm != NULL);
+	if (hsm == NULL)
+		return -1;
+
+	for (i = hash & shard->mask; shard->entries[i].hsm != NULL; i = (i + 1) & shard->mask) {
+		if (shard->entries[i].key == key) {
+			shard->entries[i].hsm = hsm;
+			return 0;
+		}
+	}
+
+	/* keep at least one slot empty to terminate probe sequences */
+	if (shard->count == shard->mask) {
+		MDBG_PRINT_LN("registry shard full");
+		return -1;
+	}
+
+	shard->entries[i].key = key;
+	shard->entries[i].hsm = hsm;
+	shard->count++;
+
+	return 0;
+}
+
+mhsm_hsm_t *mhsm_registry_lookup(mhsm_registry_t *registry, uint64_t key)
+{
+	uint64_t hash = _hash(key);
+	mhsm_registry_entry_t *entry = _find(registry->shards + _shard_index(registry, hash), key, hash);
+
+	return entry != NULL ? entry->hsm : NULL;
+}
+
+mhsm_hsm_t *mhsm_registry_remove(mhsm_registry_t *registry, uint64_t key)
+{
+	uint64_t hash = _hash(key);
+	mhsm_registry_shard_t *shard = registry->shards + _shard_index(registry, hash);
+	mhsm_registry_entry_t *entry = _find(shard, key, hash);
+	mhsm_hsm_t *hsm;
+	size_t i, j;
+
+	if (entry == NULL)
+		return NULL;
+
+	hsm = entry->hsm;
+	i = entry - shard->entries;
+
+	/* shift the rest of the probe sequence backwards */
+	for (j = (i + 1) & shard->mask; shard->entries[j].hsm != NULL; j = (j + 1) & shard->mask) {
+		size_t home = _hash(shard->entries[j].key) & shard->mask;
+
+		/* entries whose home is cyclically in (i, j] stay */
+		if (i <= j ? (home > i && home <= j) : (home > i || home <= j))
+			continue;
+
+		shard->entries[i] = shard->entries[j];
+		i = j;
+	}
+
+	shard->entries[i].hsm = NULL;
+	shard->count--;
+
+	return hsm;
+}
+
+int mhsm_registry_dispatch(mhsm_registry_t *registry, uint64_t key, uint32_t id, int32_t arg)
+{
+	mhsm_hsm_t *hsm = mhsm_registry_lookup(registry, key);
+
+	if (registry->dispatch_hook != NULL)
+		registry->dispatch_hook(registry->hook_arg, key, id, arg);
+
+	if (hsm == NULL) {
+		MDBG_PRINT1("no HSM registered for key %llu\n", (unsigned long long) key);
+		return -1;
+	}
+
+	return mhsm_dispatch_event_arg(hsm, id, arg);
+}
+
+void mhsm_registry_set_hook(mhsm_registry_t *registry, void (*dispatch_hook)(void*, uint64_t, uint32_t, int32_t), void *hook_arg)
+{
+	registry->dispatch_hook = dispatch_hook;
+	registry->hook_arg = hook_arg;
+}
+
+#ifdef MHSM_STATISTICS
+void mhsm_registry_accumulate_stats(mhsm_registry_t *registry, mhsm_stats_t *total)
+{
+	mhsm_registry_shard_t *shard;
+	size_t i, j;
+
+	for (i = 0; i < registry->nrof_shards; i++) {
+		shard = registry->shards + i;
+		for (j = 0; j <= shard->mask; j++)
+			if (shard->entries[j].hsm != NULL)
+				mhsm_accumulate_stats(total, shard->entries[j].hsm);
+	}
+}
+#endif
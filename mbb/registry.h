@@ -0,0 +1,67 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_REGISTRY_H
+#define MBB_REGISTRY_H
+
+#include "types.h"
+#include "hsm.h"
+
+/* 
+ * Registry mapping 64 bit keys to HSM instances.
+ *
+ * The registry is split into shards, each of which is an open-addressing hash
+ * table with linear probing. A key always maps to the same shard, so each
+ * shard may be owned by a single thread without any locking. The memory of
+ * the shards and their entries is provided by the application.
+ */
+
+typedef struct {
+	uint64_t key;
+	mhsm_hsm_t *hsm;
+} mhsm_registry_entry_t;
+
+typedef struct {
+	mhsm_registry_entry_t *entries;
+	size_t mask;
+	size_t count;
+} mhsm_registry_shard_t;
+
+typedef struct {
+	mhsm_registry_shard_t *shards;
+	size_t nrof_shards;
+	unsigned shard_shift;
+	/* called by mhsm_registry_dispatch before dispatching, e.g. to record traces */
+	void (*dispatch_hook)(void *hook_arg, uint64_t key, uint32_t id, int32_t arg);
+	void *hook_arg;
+} mhsm_registry_t;
+
+int mhsm_registry_initialise(mhsm_registry_t *registry, mhsm_registry_shard_t *shards, size_t nrof_shards, mhsm_registry_entry_t *entries, size_t entries_per_shard);
+size_t mhsm_registry_shard(mhsm_registry_t *registry, uint64_t key);
+int mhsm_registry_insert(mhsm_registry_t *registry, uint64_t key, mhsm_hsm_t *hsm);
+mhsm_hsm_t *mhsm_registry_lookup(mhsm_registry_t *registry, uint64_t key);
+mhsm_hsm_t *mhsm_registry_remove(mhsm_registry_t *registry, uint64_t key);
+int mhsm_registry_dispatch(mhsm_registry_t *registry, uint64_t key, uint32_t id, int32_t arg);
+void mhsm_registry_set_hook(mhsm_registry_t *registry, void (*dispatch_hook)(void*, uint64_t, uint32_t, int32_t), void *hook_arg);
+#ifdef MHSM_STATISTICS
+void mhsm_registry_accumulate_stats(mhsm_registry_t *registry, mhsm_stats_t *total);
+#endif
+
+#endif /* MBB_REGISTRY_H */
@@ -0,0 +1,165 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "scheduler.h"
+#include "types.h"
+#include "hsm.h"
+#include "debug.h"
+
+/* insert the task at the end of the round, i.e. before the current task */
+static void _link(mhsm_sched_t *sched, mhsm_sched_task_t *task)
+{
+	mhsm_sched_task_t *current = sched->current;
+
+	if (current == NULL) {
+		task->next = task;
+		task->prev = task;
+		sched->current = task;
+	} else {
+		task->next = current;
+		task->prev = current->prev;
+		current->prev->next = task;
+		current->prev = task;
+	}
+
+	sched->nrof_active++;
+}
+
+static void _unlink(mhsm_sched_t *sched, mhsm_sched_task_t *task)
+{
+	if (task->next == task) {
+		sched->current = NULL;
+	} else {
+		task->prev->next = task->next;
+		task->next->prev = task->prev;
+		if (sched->current == task)
+			sched->current = task->next;
+	}
+
+	task->next = NULL;
+	task->prev = NULL;
+	sched->nrof_active--;
+}
+
+void mhsm_sched_initialise(mhsm_sched_t *sched, uint64_t (*now)(void))
+{
+	sched->now = now;
+	sched->current = NULL;
+	sched->nrof_active = 0;
+}
+
+void mhsm_sched_initialise_task(mhsm_sched_t *sched, mhsm_sched_task_t *task, mhsm_hsm_t *hsm, uint64_t budget)
+{
+	task->sched = sched;
+	task->hsm = hsm;
+	task->budget = budget;
+	task->activities = 0;
+	task->yielded = 0;
+	task->next = NULL;
+	task->prev = NULL;
+}
+
+/* called on entry of a state with a DO activity */
+void mhsm_sched_activate(mhsm_sched_task_t *task)
+{
+	if (task->activities++ == 0)
+		_link(task->sched, task);
+}
+
+/* called on exit of a state with a DO activity */
+void mhsm_sched_deactivate(mhsm_sched_task_t *task)
+{
+	MDBG_ASSERT(task->activities > 0);
+	if (task->activities == 0)
+		return;
+
+	if (--task->activities == 0)
+		_unlink(task->sched, task);
+}
+
+/* end the running slice after the current DO event */
+void mhsm_sched_yield(mhsm_sched_task_t *task)
+{
+	task->yielded = 1;
+}
+
+bool mhsm_sched_is_active(mhsm_sched_task_t *task)
+{
+	return task->activities > 0;
+}
+
+size_t mhsm_sched_nrof_active(mhsm_sched_t *sched)
+{
+	return sched->nrof_active;
+}
+
+/*
+ * Dispatch DO events to the current task until its budget is used up, it
+ * yields, or it is deactivated. The task gets at least one DO event per
+ * slice. Returns -1 if dispatching failed, 0 if no task is active afterwards,
+ * 1 otherwise.
+ */
+int mhsm_sched_run_slice(mhsm_sched_t *sched)
+{
+	mhsm_sched_task_t *task = sched->current;
+	uint64_t start, used = 0;
+	int ret = 0;
+
+	if (task == NULL)
+		return 0;
+
+	task->yielded = 0;
+	start = sched->now != NULL ? sched->now() : 0;
+
+	do {
+		if (mhsm_dispatch_event(task->hsm, MHSM_EVENT_DO) != 0)
+			ret = -1;
+
+		used = sched->now != NULL ? sched->now() - start : used + 1;
+	} while (task->activities > 0 && !task->yielded && used < task->budget);
+
+	/* a deactivated task has already handed over to the next one */
+	if (sched->current == task)
+		sched->current = task->next;
+
+	if (ret != 0)
+		return -1;
+
+	return sched->current != NULL;
+}
+
+/*
+ * Run one slice per task active when the round starts. Returns like
+ * mhsm_sched_run_slice().
+ */
+int mhsm_sched_run_round(mhsm_sched_t *sched)
+{
+	size_t n = sched->nrof_active;
+	int ret = 0;
+
+	while (n-- > 0 && sched->current != NULL)
+		if (mhsm_sched_run_slice(sched) < 0)
+			ret = -1;
+
+	if (ret != 0)
+		return -1;
+
+	return sched->current != NULL;
+}
@@ -0,0 +1,78 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_SCHEDULER_H
+#define MBB_SCHEDULER_H
+
+#include "types.h"
+#include "hsm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cooperative scheduler dispatching MHSM_EVENT_DO.
+ *
+ * Each HSM has a task provided by the application. States with DO activities
+ * activate the task on entry and deactivate it on exit, so the scheduler only
+ * sees HSMs which have work to do. Active tasks are kept in a ring and run in
+ * turn, each for a slice of DO events limited by the task's budget.
+ */
+
+typedef struct mhsm_sched_s mhsm_sched_t;
+typedef struct mhsm_sched_task_s mhsm_sched_task_t;
+
+struct mhsm_sched_task_s {
+	mhsm_sched_t *sched;
+	mhsm_hsm_t *hsm;
+	/* length of a slice in units of the scheduler's clock */
+	uint64_t budget;
+	/* number of active states with DO activities */
+	uint16_t activities;
+	bool yielded;
+	/* ring of active tasks */
+	mhsm_sched_task_t *next;
+	mhsm_sched_task_t *prev;
+};
+
+struct mhsm_sched_s {
+	/* clock measuring slices, NULL to count DO events */
+	uint64_t (*now)(void);
+	/* the task running next, NULL if no task is active */
+	mhsm_sched_task_t *current;
+	size_t nrof_active;
+};
+
+void mhsm_sched_initialise(mhsm_sched_t *sched, uint64_t (*now)(void));
+void mhsm_sched_initialise_task(mhsm_sched_t *sched, mhsm_sched_task_t *task, mhsm_hsm_t *hsm, uint64_t budget);
+void mhsm_sched_activate(mhsm_sched_task_t *task);
+void mhsm_sched_deactivate(mhsm_sched_task_t *task);
+void mhsm_sched_yield(mhsm_sched_task_t *task);
+bool mhsm_sched_is_active(mhsm_sched_task_t *task);
+size_t mhsm_sched_nrof_active(mhsm_sched_t *sched);
+int mhsm_sched_run_slice(mhsm_sched_t *sched);
+int mhsm_sched_run_round(mhsm_sched_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBB_SCHEDULER_H */
@@ -0,0 +1,431 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "snapshot.h"
+#include "types.h"
+#include "queue.h"
+#include "hsm.h"
+#include "timer_periodic.h"
+#include "debug.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Snapshot layout, all integers are LEB128 varints, event arguments are
+ * zigzag-encoded:
+ *
+ * state index
+ * number of deferred events, followed by (id, arg) per event
+ * number of active timers, followed by (index, period, remaining) per timer
+ * if MHSM_PRIORITY_LEVELS > 1, the number of events of priorities 1 and
+ * above, followed by (priority, id, arg) per event
+ *
+ * Files start with SNAPSHOT_MAGIC and SNAPSHOT_VERSION, followed by the
+ * number of snapshots and (length, snapshot) per HSM.
+ */
+
+#define SNAPSHOT_MAGIC		"MSNP"
+#define SNAPSHOT_VERSION	1
+
+typedef struct {
+	uint8_t *data;
+	const uint8_t *cdata;
+	size_t size;
+	size_t pos;
+	bool overflow;
+} _cursor_t;
+
+static void _put_varint(_cursor_t *c, uint32_t value)
+{
+	do {
+		uint8_t byte = value & 0x7f;
+
+		value >>= 7;
+		if (value != 0)
+			byte |= 0x80;
+
+		if (c->pos == c->size) {
+			c->overflow = 1;
+			return;
+		}
+		c->data[c->pos++] = byte;
+	} while (value != 0);
+}
+
+static uint32_t _get_varint(_cursor_t *c)
+{
+	uint32_t value = 0;
+	int shift;
+
+	for (shift = 0; shift < 35; shift += 7) {
+		uint8_t byte;
+
+		if (c->pos == c->size) {
+			c->overflow = 1;
+			return 0;
+		}
+		byte = c->cdata[c->pos++];
+		value |= (uint32_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+
+	c->overflow = 1;
+
+	return 0;
+}
+
+static uint32_t _zigzag(int32_t value)
+{
+	return ((uint32_t) value << 1) ^ (uint32_t) -(value < 0);
+}
+
+static int32_t _unzigzag(uint32_t value)
+{
+	return (int32_t) ((value >> 1) ^ -(value & 1));
+}
+
+/* events of priority 0 are preceded by their number, the others by their priority */
+static void _put_events(_cursor_t *c, mhsm_event_queue_t *queue, int priority)
+{
+	size_t length = queue != NULL ? MQUE_LENGTH(queue) : 0;
+	size_t i;
+
+	if (priority == 0)
+		_put_varint(c, length);
+
+	for (i = 0; i < length; i++) {
+		mhsm_event_t event = queue->data[(queue->first + i) % MQUE_CAPACITY(queue)];
+
+		if (priority != 0)
+			_put_varint(c, priority);
+		_put_varint(c, event.id);
+		_put_varint(c, _zigzag(event.arg));
+	}
+}
+
+/* decode an event of the given priority, queued if apply is true */
+static int _get_event(_cursor_t *c, mhsm_hsm_t *hsm, int priority, bool apply)
+{
+	mhsm_event_t event;
+
+	event.id = _get_varint(c);
+	event.arg = _unzigzag(_get_varint(c));
+
+	if (c->overflow)
+		return -1;
+
+	/* the time spent in the snapshot is unknown */
+	return apply ? mhsm_queue_event(hsm, event, priority) : 0;
+}
+
+static int _state_index(mhsm_state_t *state, mhsm_state_t **states, size_t nrof_states)
+{
+	size_t i;
+
+	for (i = 0; i < nrof_states; i++)
+		if (states[i] == state)
+			return i;
+
+	return -1;
+}
+
+int mhsm_snapshot_save(mhsm_hsm_t *hsm, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers, uint8_t *buffer, size_t size)
+{
+	mtmr_prd_t *timers = (mtmr_prd_t*) mhsm_context(hsm);
+	_cursor_t c = { buffer, buffer, size, 0, 0 };
+	size_t nrof_active = 0;
+	int index;
+	size_t i;
+#if MHSM_PRIORITY_LEVELS > 1
+	size_t n;
+	int p;
+#endif
+
+	MDBG_ASSERT(!hsm->in_transition);
+	if (hsm->in_transition)
+		return -1;
+
+	index = _state_index(hsm->current_state, states, nrof_states);
+	if (index < 0) {
+		MDBG_PRINT_LN("current state not found in the state array");
+		return -1;
+	}
+	_put_varint(&c, index);
+
+	_put_events(&c, mhsm_deferred_events(hsm), 0);
+
+	for (i = 0; i < nrof_timers; i++)
+		if (timers[i].active)
+			nrof_active++;
+
+	_put_varint(&c, nrof_active);
+	for (i = 0; i < nrof_timers; i++) {
+		if (!timers[i].active)
+			continue;
+
+		_put_varint(&c, i);
+		_put_varint(&c, timers[i].period);
+		_put_varint(&c, timers[i].value < timers[i].period ? timers[i].period - timers[i].value : 0);
+	}
+
+#if MHSM_PRIORITY_LEVELS > 1
+	n = 0;
+	for (p = 0; p < MHSM_PRIORITY_LEVELS - 1; p++)
+		n += MQUE_LENGTH(&hsm->priority_events[p]);
+
+	_put_varint(&c, n);
+	for (p = 0; p < MHSM_PRIORITY_LEVELS - 1; p++)
+		_put_events(&c, &hsm->priority_events[p], p + 1);
+#endif
+
+	if (c.overflow) {
+		MDBG_PRINT_LN("snapshot buffer too small");
+		return -1;
+	}
+
+	return c.pos;
+}
+
+/*
+ * Decode a snapshot, returning its length or -1 if it is invalid. The HSM is
+ * only changed if apply is true, so a first pass can check the whole snapshot
+ * and count the queues compact HSMs have to take in nrof_queues before the
+ * second one restores it.
+ */
+static int _decode(mhsm_hsm_t *hsm, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers, const uint8_t *buffer, size_t size, bool apply, size_t *nrof_queues)
+{
+	mtmr_prd_t *timers = (mtmr_prd_t*) mhsm_context(hsm);
+	_cursor_t c = { NULL, buffer, size, 0, 0 };
+	uint32_t index;
+	uint32_t n;
+	uint32_t i;
+#if MHSM_PRIORITY_LEVELS > 1
+	size_t lengths[MHSM_PRIORITY_LEVELS];
+#endif
+
+	index = _get_varint(&c);
+	if (c.overflow || index >= nrof_states)
+		return -1;
+
+	n = _get_varint(&c);
+	if (n > MHSM_EVENT_QUEUE_LENGTH)
+		return -1;
+
+	if (!apply && n > 0 && mhsm_deferred_events(hsm) == NULL)
+		(*nrof_queues)++;
+
+	/* the first change, fails if no queue is left for the events */
+	if (apply && mhsm_clear_queues(hsm, n > 0) != 0)
+		return -1;
+	for (i = 0; i < n; i++)
+		if (_get_event(&c, hsm, 0, apply) != 0)
+			return -1;
+
+	if (apply)
+		for (i = 0; i < nrof_timers; i++)
+			timers[i].active = 0;
+
+	n = _get_varint(&c);
+	if (n > nrof_timers)
+		return -1;
+	for (i = 0; i < n; i++) {
+		uint32_t idx = _get_varint(&c);
+		uint32_t period = _get_varint(&c);
+		uint32_t remaining = _get_varint(&c);
+
+		if (c.overflow || idx >= nrof_timers || remaining > period)
+			return -1;
+
+		if (apply) {
+			timers[idx].period = period;
+			timers[idx].value = period - remaining;
+			timers[idx].active = 1;
+		}
+	}
+
+#if MHSM_PRIORITY_LEVELS > 1
+	memset(lengths, 0, sizeof(lengths));
+
+	/* missing in snapshots saved without priorities */
+	n = c.pos < size ? _get_varint(&c) : 0;
+	for (i = 0; i < n; i++) {
+		uint32_t priority = _get_varint(&c);
+
+		if (c.overflow || priority == 0 || priority >= MHSM_PRIORITY_LEVELS)
+			return -1;
+		if (++lengths[priority] > MHSM_EVENT_QUEUE_LENGTH)
+			return -1;
+		if (_get_event(&c, hsm, priority, apply) != 0)
+			return -1;
+	}
+#endif
+
+	if (c.overflow)
+		return -1;
+
+	if (apply) {
+		mhsm_restore_current_state(hsm, states[index]);
+		hsm->in_transition = 0;
+	}
+
+	return c.pos;
+}
+
+/* returns -1 if compact HSMs cannot take nrof_queues queues, 0 otherwise */
+static int _check_queues(size_t nrof_queues)
+{
+	if (nrof_queues > mhsm_free_queues()) {
+		MDBG_PRINT_LN("MHSM_COMPACT_QUEUES exhausted");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* leaves the HSM unchanged if the snapshot is invalid */
+int mhsm_snapshot_restore(mhsm_hsm_t *hsm, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers, const uint8_t *buffer, size_t size)
+{
+	size_t nrof_queues = 0;
+
+	if (_decode(hsm, states, nrof_states, nrof_timers, buffer, size, 0, &nrof_queues) < 0)
+		return -1;
+
+	if (_check_queues(nrof_queues) != 0)
+		return -1;
+
+	return _decode(hsm, states, nrof_states, nrof_timers, buffer, size, 1, NULL);
+}
+
+static int _write_varint(FILE *file, uint32_t value)
+{
+	uint8_t buffer[5];
+	_cursor_t c = { buffer, buffer, sizeof(buffer), 0, 0 };
+
+	_put_varint(&c, value);
+
+	return fwrite(buffer, 1, c.pos, file) == c.pos ? 0 : -1;
+}
+
+static int _read_varint(FILE *file, uint32_t *value)
+{
+	uint8_t buffer[5];
+	_cursor_t c = { NULL, buffer, 0, 0, 0 };
+	int byte;
+
+	do {
+		if (c.size == sizeof(buffer) || (byte = getc(file)) == EOF)
+			return -1;
+		buffer[c.size++] = byte;
+	} while (byte & 0x80);
+
+	*value = _get_varint(&c);
+
+	return 0;
+}
+
+int mhsm_snapshot_write(FILE *file, mhsm_hsm_t *hsms, size_t nrof_hsms, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers)
+{
+	uint8_t buffer[MHSM_SNAPSHOT_BUFFER_SIZE];
+	size_t i;
+
+	if (fwrite(SNAPSHOT_MAGIC, 1, 4, file) != 4 || putc(SNAPSHOT_VERSION, file) == EOF)
+		return -1;
+
+	if (_write_varint(file, nrof_hsms) != 0)
+		return -1;
+
+	for (i = 0; i < nrof_hsms; i++) {
+		int length = mhsm_snapshot_save(hsms + i, states, nrof_states, nrof_timers, buffer, sizeof(buffer));
+
+		if (length < 0)
+			return -1;
+
+		if (_write_varint(file, length) != 0 || fwrite(buffer, 1, length, file) != (size_t) length)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the snapshot of the HSM at the file's position into buffer, check it,
+ * counting the queues compact HSMs have to take in nrof_queues, and restore it
+ * if apply is true. Returns -1 if it cannot be read or is invalid, 0
+ * otherwise.
+ */
+static int _read_snapshot(FILE *file, mhsm_hsm_t *hsm, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers, uint8_t *buffer, size_t size, bool apply, size_t *nrof_queues)
+{
+	uint32_t length;
+
+	if (_read_varint(file, &length) != 0 || length > size)
+		return -1;
+
+	if (fread(buffer, 1, length, file) != length)
+		return -1;
+
+	if (_decode(hsm, states, nrof_states, nrof_timers, buffer, length, 0, nrof_queues) != (int) length)
+		return -1;
+
+	if (apply && _decode(hsm, states, nrof_states, nrof_timers, buffer, length, 1, NULL) != (int) length)
+		return -1;
+
+	return 0;
+}
+
+/* checks all snapshots before restoring any, so the file has to be seekable */
+int mhsm_snapshot_read(FILE *file, mhsm_hsm_t *hsms, size_t nrof_hsms, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers)
+{
+	uint8_t buffer[MHSM_SNAPSHOT_BUFFER_SIZE];
+	size_t nrof_queues = 0;
+	char magic[4];
+	long start;
+	uint32_t n;
+	uint32_t i;
+
+	if (fread(magic, 1, 4, file) != 4 || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0) {
+		MDBG_PRINT_LN("not a snapshot file");
+		return -1;
+	}
+
+	if (getc(file) != SNAPSHOT_VERSION) {
+		MDBG_PRINT_LN("unsupported snapshot version");
+		return -1;
+	}
+
+	if (_read_varint(file, &n) != 0 || n > nrof_hsms)
+		return -1;
+
+	if ((start = ftell(file)) < 0)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		if (_read_snapshot(file, hsms + i, states, nrof_states, nrof_timers, buffer, sizeof(buffer), 0, &nrof_queues) != 0)
+			return -1;
+
+	if (_check_queues(nrof_queues) != 0 || fseek(file, start, SEEK_SET) != 0)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		if (_read_snapshot(file, hsms + i, states, nrof_states, nrof_timers, buffer, sizeof(buffer), 1, &nrof_queues) != 0)
+			return -1;
+
+	return n;
+}
@@ -0,0 +1,48 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_SNAPSHOT_H
+#define MBB_SNAPSHOT_H
+
+#include "types.h"
+#include "hsm.h"
+#include <stdio.h>
+
+/* 
+ * Binary snapshots of HSM instances.
+ *
+ * States are encoded as indices into an array of all states of the HSM,
+ * timers are assumed to be mtmr_prd_t timers at the beginning of the HSM's
+ * context (see mbb/timer_periodic.h). Pass nrof_timers = 0 if the HSM does
+ * not use periodic timers.
+ */
+
+/* size of the buffer used by mhsm_snapshot_write() and mhsm_snapshot_read() */
+#ifndef MHSM_SNAPSHOT_BUFFER_SIZE
+# define MHSM_SNAPSHOT_BUFFER_SIZE 256
+#endif
+
+int mhsm_snapshot_save(mhsm_hsm_t *hsm, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers, uint8_t *buffer, size_t size);
+int mhsm_snapshot_restore(mhsm_hsm_t *hsm, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers, const uint8_t *buffer, size_t size);
+
+int mhsm_snapshot_write(FILE *file, mhsm_hsm_t *hsms, size_t nrof_hsms, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers);
+int mhsm_snapshot_read(FILE *file, mhsm_hsm_t *hsms, size_t nrof_hsms, mhsm_state_t **states, size_t nrof_states, size_t nrof_timers);
+
+#endif /* MBB_SNAPSHOT_H */
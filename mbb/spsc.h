@@ -0,0 +1,142 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_SPSC_H
+#define MBB_SPSC_H
+
+#include "types.h"
+
+/* 
+ * Type-safe fixed-capacity single-producer single-consumer queues.
+ *
+ * Unlike MQUE queues, an MSPSC queue may be used by two threads without
+ * locking: one thread enqueueing and one thread dequeueing. The producer owns
+ * the tail, the consumer owns the head. Each index is only written by its
+ * owner and read by the other side using acquire/release ordering. Head and
+ * tail live on separate cache lines, each next to a cached copy of the other
+ * side's index which is only refreshed when the queue looks full or empty,
+ * respectively.
+ *
+ * Only the producer may call MSPSC_IS_FULL(), MSPSC_STAGE(), MSPSC_PUBLISH()
+ * and MSPSC_ENQUEUE(). Only the consumer may call MSPSC_IS_EMPTY(),
+ * MSPSC_HEAD() and MSPSC_DEQUEUE().
+ *
+ * Example:
+ *
+ * MSPSC_DEFINE_STRUCT(int, 64) event_queue = MSPSC_INITIALISER;
+ *
+ * producer:
+ * {
+ *	int i;
+ *
+ *	for (i = 0; i < 3 && !MSPSC_IS_FULL(&event_queue); i++)
+ *		MSPSC_STAGE(&event_queue, i);
+ *
+ *	MSPSC_PUBLISH(&event_queue);
+ * }
+ *
+ * consumer:
+ * {
+ *	while (!MSPSC_IS_EMPTY(&event_queue)) {
+ *		printf("event: %d\n", MSPSC_HEAD(&event_queue));
+ *		MSPSC_DEQUEUE(&event_queue);
+ *	}
+ * }
+ */
+
+#ifndef MSPSC_CACHE_LINE
+#define MSPSC_CACHE_LINE 64
+#endif
+
+/* override for compilers lacking the GCC __atomic builtins */
+#ifndef MSPSC_LOAD_ACQUIRE
+#define MSPSC_LOAD_ACQUIRE(P) __atomic_load_n(P, __ATOMIC_ACQUIRE)
+#endif
+
+#ifndef MSPSC_STORE_RELEASE
+#define MSPSC_STORE_RELEASE(P, V) __atomic_store_n(P, V, __ATOMIC_RELEASE)
+#endif
+
+/* 
+ * The indices run freely and are reduced modulo the capacity when accessing
+ * the data, a capacity which is a power of two turns this into a mask.
+ * Padding by a whole cache line keeps the consumer's, the producer's and the
+ * data's cache lines apart regardless of the structure's alignment.
+ * Other capacities only work until SIZE_MAX elements have passed the queue.
+ */
+#define MSPSC_DEFINE_STRUCT(TYPE, CAPACITY) \
+struct { \
+	size_t head; \
+	size_t cached_tail; \
+	char consumer_padding[MSPSC_CACHE_LINE]; \
+	size_t tail; \
+	size_t staged; \
+	size_t cached_head; \
+	char producer_padding[MSPSC_CACHE_LINE]; \
+	TYPE data[CAPACITY]; \
+}
+
+#define MSPSC_CAPACITY(Q) (sizeof((Q)->data) / sizeof((Q)->data[0]))
+
+#define MSPSC_INITIALISER { 0, 0, { 0 }, 0, 0, 0 }
+
+#define MSPSC_INITIALISE(Q) do { \
+	(Q)->head = 0; \
+	(Q)->cached_tail = 0; \
+	(Q)->tail = 0; \
+	(Q)->staged = 0; \
+	(Q)->cached_head = 0; \
+} while (0)
+
+/* only exact if neither side is active */
+#define MSPSC_LENGTH(Q) \
+	(MSPSC_LOAD_ACQUIRE(&(Q)->tail) - MSPSC_LOAD_ACQUIRE(&(Q)->head))
+
+#define MSPSC_IS_FULL(Q) \
+	((Q)->staged - (Q)->cached_head == MSPSC_CAPACITY(Q) && \
+	 ((Q)->cached_head = MSPSC_LOAD_ACQUIRE(&(Q)->head), \
+	  (Q)->staged - (Q)->cached_head == MSPSC_CAPACITY(Q)))
+
+#define MSPSC_STAGE(Q, ELEMENT) do { \
+	if (MSPSC_IS_FULL(Q)) break; \
+	(Q)->data[(Q)->staged % MSPSC_CAPACITY(Q)] = ELEMENT; \
+	(Q)->staged += 1; \
+} while (0)
+
+#define MSPSC_PUBLISH(Q) MSPSC_STORE_RELEASE(&(Q)->tail, (Q)->staged)
+
+#define MSPSC_ENQUEUE(Q, ELEMENT) do { \
+	MSPSC_STAGE(Q, ELEMENT); \
+	MSPSC_PUBLISH(Q); \
+} while (0)
+
+#define MSPSC_IS_EMPTY(Q) \
+	((Q)->head == (Q)->cached_tail && \
+	 ((Q)->cached_tail = MSPSC_LOAD_ACQUIRE(&(Q)->tail), \
+	  (Q)->head == (Q)->cached_tail))
+
+#define MSPSC_HEAD(Q) ((Q)->data[(Q)->head % MSPSC_CAPACITY(Q)])
+
+#define MSPSC_DEQUEUE(Q) do { \
+	if (MSPSC_IS_EMPTY(Q)) break; \
+	MSPSC_STORE_RELEASE(&(Q)->head, (Q)->head + 1); \
+} while (0)
+
+#endif /* MBB_SPSC_H */
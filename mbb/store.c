@@ -0,0 +1,219 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "store.h"
+#include "snapshot.h"
+#include "types.h"
+#include "hsm.h"
+#include "debug.h"
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+/*
+ * File layout:
+ *
+ * _header_t, padded to STORE_HEADER_SIZE bytes
+ * nrof_slots slots of slot_size bytes: _slot_t followed by the context
+ */
+
+#define STORE_MAGIC		"MSTO"
+#define STORE_VERSION		1
+#define STORE_HEADER_SIZE	64
+#define STORE_ALIGN(SIZE)	(((SIZE) + 7) & ~((size_t) 7))
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint64_t nrof_slots;
+	uint32_t slot_size;
+	uint32_t context_size;
+	uint32_t nrof_states;
+} _header_t;
+
+typedef struct {
+	uint16_t used;
+	uint16_t length;
+	uint8_t snapshot[MHSM_STORE_SNAPSHOT_SIZE];
+} _slot_t;
+
+static _slot_t *_slot(mhsm_store_t *store, size_t id)
+{
+	MDBG_ASSERT(id < store->nrof_slots);
+
+	return (_slot_t*) (store->slots + id * store->slot_size);
+}
+
+int mhsm_store_open(mhsm_store_t *store, const char *path, size_t nrof_slots, size_t context_size, mhsm_state_t **states, size_t nrof_states)
+{
+	_header_t header;
+	struct stat st;
+
+	store->context_offset = STORE_ALIGN(sizeof(_slot_t));
+	store->slot_size = STORE_ALIGN(store->context_offset + context_size);
+	store->nrof_slots = nrof_slots;
+	store->context_size = context_size;
+	store->states = states;
+	store->nrof_states = nrof_states;
+	store->map_size = STORE_HEADER_SIZE + nrof_slots * store->slot_size;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, STORE_MAGIC, 4);
+	header.version = STORE_VERSION;
+	header.nrof_slots = nrof_slots;
+	header.slot_size = store->slot_size;
+	header.context_size = context_size;
+	header.nrof_states = nrof_states;
+
+	store->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (store->fd < 0) {
+		MDBG_PRINT_ERRNO("open");
+		return -1;
+	}
+
+	if (fstat(store->fd, &st) != 0) {
+		MDBG_PRINT_ERRNO("fstat");
+		goto fail;
+	}
+
+	if (st.st_size == 0) {
+		/* new store, slots are zero-filled and thus unused */
+		if (ftruncate(store->fd, store->map_size) != 0) {
+			MDBG_PRINT_ERRNO("ftruncate");
+			goto fail;
+		}
+		if (pwrite(store->fd, &header, sizeof(header), 0) != sizeof(header)) {
+			MDBG_PRINT_ERRNO("pwrite");
+			goto fail;
+		}
+	} else if ((size_t) st.st_size != store->map_size) {
+		MDBG_PRINT_LN("store size mismatch");
+		goto fail;
+	}
+
+	store->map = mmap(NULL, store->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+	if (store->map == MAP_FAILED) {
+		MDBG_PRINT_ERRNO("mmap");
+		goto fail;
+	}
+
+	if (memcmp(store->map, &header, sizeof(header)) != 0) {
+		MDBG_PRINT_LN("store header mismatch");
+		munmap(store->map, store->map_size);
+		goto fail;
+	}
+
+	store->slots = store->map + STORE_HEADER_SIZE;
+
+	return 0;
+
+fail:
+	close(store->fd);
+	store->fd = -1;
+
+	return -1;
+}
+
+int mhsm_store_sync(mhsm_store_t *store)
+{
+	return msync(store->map, store->map_size, MS_SYNC);
+}
+
+int mhsm_store_close(mhsm_store_t *store)
+{
+	int ret = 0;
+
+	if (munmap(store->map, store->map_size) != 0)
+		ret = -1;
+
+	if (close(store->fd) != 0)
+		ret = -1;
+
+	store->fd = -1;
+
+	return ret;
+}
+
+bool mhsm_store_is_used(mhsm_store_t *store, size_t id)
+{
+	return _slot(store, id)->used;
+}
+
+void *mhsm_store_context(mhsm_store_t *store, size_t id)
+{
+	return (uint8_t*) _slot(store, id) + store->context_offset;
+}
+
+int mhsm_store_attach(mhsm_store_t *store, size_t id, mhsm_hsm_t *hsm, mhsm_state_t *initial_state)
+{
+	_slot_t *slot = _slot(store, id);
+	void *context = mhsm_store_context(store, id);
+
+	mhsm_initialise(hsm, context, initial_state);
+
+	if (!slot->used) {
+		memset(context, 0, store->context_size);
+		slot->length = 0;
+		slot->used = 1;
+
+		return 0;
+	}
+
+	/* not saved yet */
+	if (slot->length == 0)
+		return 0;
+
+	if (mhsm_snapshot_restore(hsm, store->states, store->nrof_states, 0, slot->snapshot, slot->length) != slot->length) {
+		MDBG_PRINT_LN("invalid snapshot");
+		return -1;
+	}
+
+	return 1;
+}
+
+int mhsm_store_save(mhsm_store_t *store, size_t id, mhsm_hsm_t *hsm)
+{
+	_slot_t *slot = _slot(store, id);
+	uint8_t buffer[MHSM_STORE_SNAPSHOT_SIZE];
+	int length;
+
+	MDBG_ASSERT(mhsm_context(hsm) == mhsm_store_context(store, id));
+
+	/* the slot keeps its previous snapshot if the new one does not fit */
+	length = mhsm_snapshot_save(hsm, store->states, store->nrof_states, 0, buffer, sizeof(buffer));
+	if (length < 0)
+		return -1;
+
+	memcpy(slot->snapshot, buffer, length);
+	slot->length = length;
+
+	return 0;
+}
+
+void mhsm_store_release(mhsm_store_t *store, size_t id)
+{
+	_slot_t *slot = _slot(store, id);
+
+	slot->used = 0;
+	slot->length = 0;
+}
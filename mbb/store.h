@@ -0,0 +1,64 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_STORE_H
+#define MBB_STORE_H
+
+#include "types.h"
+#include "hsm.h"
+
+/* 
+ * Memory-mapped store of HSM instances.
+ *
+ * Each HSM instance owns a fixed-size slot in a file mapped into memory. The
+ * slot holds the HSM's context and a snapshot of its state (see
+ * mbb/snapshot.h), so the HSMs survive restarts of the process and idle
+ * instances can be paged out by the operating system.
+ */
+
+/* space reserved for the snapshot of an HSM's state in each slot */
+#ifndef MHSM_STORE_SNAPSHOT_SIZE
+# define MHSM_STORE_SNAPSHOT_SIZE 60
+#endif
+
+typedef struct {
+	uint8_t *map;
+	size_t map_size;
+	uint8_t *slots;
+	size_t slot_size;
+	size_t context_offset;
+	size_t nrof_slots;
+	size_t context_size;
+	mhsm_state_t **states;
+	size_t nrof_states;
+	int fd;
+} mhsm_store_t;
+
+int mhsm_store_open(mhsm_store_t *store, const char *path, size_t nrof_slots, size_t context_size, mhsm_state_t **states, size_t nrof_states);
+int mhsm_store_sync(mhsm_store_t *store);
+int mhsm_store_close(mhsm_store_t *store);
+
+bool mhsm_store_is_used(mhsm_store_t *store, size_t id);
+void *mhsm_store_context(mhsm_store_t *store, size_t id);
+int mhsm_store_attach(mhsm_store_t *store, size_t id, mhsm_hsm_t *hsm, mhsm_state_t *initial_state);
+int mhsm_store_save(mhsm_store_t *store, size_t id, mhsm_hsm_t *hsm);
+void mhsm_store_release(mhsm_store_t *store, size_t id);
+
+#endif /* MBB_STORE_H */
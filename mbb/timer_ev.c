@@ -62,7 +62,5 @@ int mtmr_ev_initalise_timers(mhsm_hsm_t *hsm, size_t nrof_timers, struct ev_loop
 		ev_timer_init(ev_timer, timeout_cb, 0, 0);
 	}
 
-	mhsm_set_timer_callback(hsm, start_timer);
-
-	return 0;
+	return mhsm_set_timer_callback(hsm, start_timer);
 }
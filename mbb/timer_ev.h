@@ -26,6 +26,10 @@
 #include "hsm.h"
 #include <ev.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
 	struct ev_loop *loop;
 	ev_timer timer;
@@ -35,4 +39,8 @@ typedef struct {
 
 int mtmr_ev_initalise_timers(mhsm_hsm_t *hsm, size_t nrof_timers, struct ev_loop *loop);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* MBB_TIMER_EV_H */
@@ -37,7 +37,7 @@ static int start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs
 	return 0;
 }
 
-int mtmr_prd_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers)
+MBB_API int mtmr_prd_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers)
 {
 	mtmr_prd_t *timers;
 	uint32_t i;
@@ -54,12 +54,18 @@ int mtmr_prd_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers)
 		timer->value = 0;
 	}
 
-	mhsm_set_timer_callback(hsm, start_timer);
+	return mhsm_set_timer_callback(hsm, start_timer);
+}
 
-	return 0;
+/* like mtmr_prd_initialise_timers, but keeping the timers' current state */
+MBB_API int mtmr_prd_resume_timers(mhsm_hsm_t *hsm)
+{
+	if (hsm == NULL) return -1;
+
+	return mhsm_set_timer_callback(hsm, start_timer);
 }
 
-int mtmr_prd_increment_timers(mhsm_hsm_t *hsm, size_t nrof_timers, uint32_t passed_msecs)
+MBB_API int mtmr_prd_increment_timers(mhsm_hsm_t *hsm, size_t nrof_timers, uint32_t passed_msecs)
 {
 	mtmr_prd_t *timers;
 	int i;
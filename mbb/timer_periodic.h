@@ -25,13 +25,22 @@
 #include "hsm.h"
 #include "timer_common.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
 	uint32_t period;
 	uint32_t value;
 	bool active;
 } mtmr_prd_t;
 
-int mtmr_prd_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers);
-int mtmr_prd_increment_timers(mhsm_hsm_t *hsm, size_t nrof_timers, uint32_t passed_msecs);
+MBB_API int mtmr_prd_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers);
+MBB_API int mtmr_prd_resume_timers(mhsm_hsm_t *hsm);
+MBB_API int mtmr_prd_increment_timers(mhsm_hsm_t *hsm, size_t nrof_timers, uint32_t passed_msecs);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* MBB_TIMER_PERIODIC_H */
@@ -0,0 +1,128 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "timer_sim.h"
+#include "types.h"
+#include "hsm.h"
+#include "debug.h"
+
+/* timers expiring at the same time fire in the order they were started */
+#define _EARLIER(A, B) ((A)->deadline != (B)->deadline ? \
+		(A)->deadline < (B)->deadline : (A)->sequence < (B)->sequence)
+
+#define _MOVED(TIMER, INDEX) ((TIMER)->index = (INDEX))
+
+static int start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs)
+{
+	mtmr_sim_t *timers = (mtmr_sim_t*) mhsm_context(hsm);
+	mtmr_sim_t *timer = timers + (event_id - MHSM_EVENT_CUSTOM);
+	mtmr_sim_clock_t *clock = timer->clock;
+
+	/* restarting an active timer moves it in place */
+	if (timer->index == MTMR_SIM_INACTIVE && MHEAP_IS_FULL(&clock->heap)) {
+		MDBG_PRINT_LN("timer heap too small");
+		return -1;
+	}
+
+	timer->deadline = clock->now + period_msecs;
+	timer->sequence = clock->sequence++;
+
+	if (timer->index == MTMR_SIM_INACTIVE)
+		MHEAP_PUSH(&clock->heap, timer, _EARLIER, _MOVED);
+	else
+		MHEAP_UPDATE(&clock->heap, timer->index, _EARLIER, _MOVED);
+
+	return 0;
+}
+
+void mtmr_sim_initialise_clock(mtmr_sim_clock_t *clock, mtmr_sim_t **heap, size_t capacity)
+{
+	clock->now = 0;
+	clock->sequence = 0;
+	MHEAP_INITIALISE_BUFFER(&clock->heap, heap, capacity);
+}
+
+int mtmr_sim_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers, mtmr_sim_clock_t *clock)
+{
+	mtmr_sim_t *timers;
+	size_t i;
+
+	if (hsm == NULL) return -1;
+
+	timers = (mtmr_sim_t*) mhsm_context(hsm);
+
+	for (i = 0; i < nrof_timers; i++) {
+		mtmr_sim_t *timer = timers + i;
+
+		timer->clock = clock;
+		timer->hsm = hsm;
+		timer->event_id = MHSM_EVENT_CUSTOM + i;
+		timer->index = MTMR_SIM_INACTIVE;
+		timer->deadline = 0;
+		timer->sequence = 0;
+	}
+
+	return mhsm_set_timer_callback(hsm, start_timer);
+}
+
+uint64_t mtmr_sim_now(mtmr_sim_clock_t *clock)
+{
+	return clock->now;
+}
+
+bool mtmr_sim_next_deadline(mtmr_sim_clock_t *clock, uint64_t *deadline)
+{
+	if (MHEAP_IS_EMPTY(&clock->heap))
+		return 0;
+
+	*deadline = MHEAP_PEEK(&clock->heap)->deadline;
+
+	return 1;
+}
+
+int mtmr_sim_run_next(mtmr_sim_clock_t *clock)
+{
+	mtmr_sim_t *timer;
+
+	if (MHEAP_IS_EMPTY(&clock->heap))
+		return 0;
+
+	timer = MHEAP_PEEK(&clock->heap);
+	MHEAP_POP(&clock->heap, _EARLIER, _MOVED);
+	timer->index = MTMR_SIM_INACTIVE;
+
+	clock->now = timer->deadline;
+	mhsm_dispatch_event(timer->hsm, timer->event_id);
+
+	return 1;
+}
+
+unsigned long mtmr_sim_advance(mtmr_sim_clock_t *clock, uint64_t msecs)
+{
+	uint64_t target = clock->now + msecs;
+	unsigned long nfired = 0;
+
+	while (!MHEAP_IS_EMPTY(&clock->heap) && MHEAP_PEEK(&clock->heap)->deadline <= target)
+		nfired += mtmr_sim_run_next(clock);
+
+	clock->now = target;
+
+	return nfired;
+}
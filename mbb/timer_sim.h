@@ -0,0 +1,74 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_TIMER_SIM_H
+#define MBB_TIMER_SIM_H
+
+#include "timer_common.h"
+#include "types.h"
+#include "hsm.h"
+#include "heap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 
+ * Timer backend running on a virtual clock.
+ *
+ * The clock does not advance by itself. mtmr_sim_run_next() jumps straight to
+ * the next deadline, so simulations take as long as processing the timer
+ * events does. Active timers are kept in a binary min-heap provided by the
+ * application.
+ */
+
+typedef struct mtmr_sim_clock_s mtmr_sim_clock_t;
+
+typedef struct {
+	mtmr_sim_clock_t *clock;
+	mhsm_hsm_t *hsm;
+	uint32_t event_id;
+	/* position in the clock's heap, MTMR_SIM_INACTIVE if not active */
+	size_t index;
+	uint64_t deadline;
+	/* order of timers expiring at the same time */
+	uint64_t sequence;
+} mtmr_sim_t;
+
+#define MTMR_SIM_INACTIVE ((size_t) -1)
+
+struct mtmr_sim_clock_s {
+	uint64_t now;
+	uint64_t sequence;
+	MHEAP_DEFINE_BUFFER_STRUCT(mtmr_sim_t*) heap;
+};
+
+void mtmr_sim_initialise_clock(mtmr_sim_clock_t *clock, mtmr_sim_t **heap, size_t capacity);
+int mtmr_sim_initialise_timers(mhsm_hsm_t *hsm, size_t nrof_timers, mtmr_sim_clock_t *clock);
+uint64_t mtmr_sim_now(mtmr_sim_clock_t *clock);
+bool mtmr_sim_next_deadline(mtmr_sim_clock_t *clock, uint64_t *deadline);
+int mtmr_sim_run_next(mtmr_sim_clock_t *clock);
+unsigned long mtmr_sim_advance(mtmr_sim_clock_t *clock, uint64_t msecs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBB_TIMER_SIM_H */
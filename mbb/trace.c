@@ -0,0 +1,217 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "trace.h"
+#include "types.h"
+#include "registry.h"
+#include "hsm.h"
+#include "clock.h"
+#include "debug.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Trace layout, all integers are LEB128 varints, event arguments are
+ * zigzag-encoded:
+ *
+ * TRACE_MAGIC and TRACE_VERSION, followed by
+ * (time since the previous record, key, event id, argument) per record
+ */
+
+#define TRACE_MAGIC	"MTRC"
+#define TRACE_VERSION	1
+
+static int _write_varint(FILE *file, uint64_t value)
+{
+	do {
+		int byte = value & 0x7f;
+
+		value >>= 7;
+		if (value != 0)
+			byte |= 0x80;
+
+		if (putc(byte, file) == EOF)
+			return -1;
+	} while (value != 0);
+
+	return 0;
+}
+
+/* returns 1 if a varint was read, 0 at the end of the file, -1 on error */
+static int _read_varint(FILE *file, uint64_t *value)
+{
+	int shift;
+	int byte;
+
+	*value = 0;
+
+	for (shift = 0; shift < 70; shift += 7) {
+		if ((byte = getc(file)) == EOF)
+			return shift == 0 ? 0 : -1;
+
+		*value |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return 1;
+	}
+
+	return -1;
+}
+
+static uint32_t _zigzag(int32_t value)
+{
+	return ((uint32_t) value << 1) ^ (uint32_t) -(value < 0);
+}
+
+static int32_t _unzigzag(uint32_t value)
+{
+	return (int32_t) ((value >> 1) ^ -(value & 1));
+}
+
+static void _sleep_until(uint64_t deadline)
+{
+	struct timespec ts;
+	uint64_t now = mclk_now();
+
+	if (now >= deadline)
+		return;
+
+	ts.tv_sec = (deadline - now) / 1000000000u;
+	ts.tv_nsec = (deadline - now) % 1000000000u;
+	nanosleep(&ts, NULL);
+}
+
+int mhsm_trace_open_recorder(mhsm_trace_recorder_t *recorder, FILE *file)
+{
+	recorder->file = file;
+	recorder->start = mclk_now();
+	recorder->last_time = 0;
+	recorder->nrof_records = 0;
+	recorder->error = 0;
+
+	if (fwrite(TRACE_MAGIC, 1, 4, file) != 4 || putc(TRACE_VERSION, file) == EOF) {
+		recorder->error = 1;
+		return -1;
+	}
+
+	return 0;
+}
+
+int mhsm_trace_record(mhsm_trace_recorder_t *recorder, uint64_t key, uint32_t id, int32_t arg)
+{
+	uint64_t time = mclk_now() - recorder->start;
+
+	if (recorder->error)
+		return -1;
+
+	if (_write_varint(recorder->file, time - recorder->last_time) != 0
+			|| _write_varint(recorder->file, key) != 0
+			|| _write_varint(recorder->file, id) != 0
+			|| _write_varint(recorder->file, _zigzag(arg)) != 0) {
+		MDBG_PRINT_LN("writing trace failed");
+		recorder->error = 1;
+		return -1;
+	}
+
+	recorder->last_time = time;
+	recorder->nrof_records++;
+
+	return 0;
+}
+
+void mhsm_trace_hook(void *recorder, uint64_t key, uint32_t id, int32_t arg)
+{
+	mhsm_trace_record((mhsm_trace_recorder_t*) recorder, key, id, arg);
+}
+
+int mhsm_trace_open_reader(mhsm_trace_reader_t *reader, FILE *file)
+{
+	char magic[4];
+
+	reader->file = file;
+	reader->last_time = 0;
+	reader->skipped = 0;
+
+	if (fread(magic, 1, 4, file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0) {
+		MDBG_PRINT_LN("not a trace file");
+		return -1;
+	}
+
+	if (getc(file) != TRACE_VERSION) {
+		MDBG_PRINT_LN("unsupported trace version");
+		return -1;
+	}
+
+	return 0;
+}
+
+int mhsm_trace_read(mhsm_trace_reader_t *reader, mhsm_trace_record_t *record)
+{
+	uint64_t delta, id, arg;
+	int status;
+
+	status = _read_varint(reader->file, &delta);
+	if (status <= 0)
+		return status;
+
+	if (_read_varint(reader->file, &record->key) != 1
+			|| _read_varint(reader->file, &id) != 1
+			|| _read_varint(reader->file, &arg) != 1
+			|| id > UINT32_MAX || arg > UINT32_MAX) {
+		MDBG_PRINT_LN("truncated trace record");
+		return -1;
+	}
+
+	reader->last_time += delta;
+	record->time = reader->last_time;
+	record->id = id;
+	record->arg = _unzigzag(arg);
+
+	return 1;
+}
+
+long mhsm_trace_replay(mhsm_trace_reader_t *reader, mhsm_registry_t *registry, double speed)
+{
+	mhsm_trace_record_t record;
+	mhsm_hsm_t *hsm;
+	uint64_t start = mclk_now();
+	long nrecords = 0;
+	int status;
+
+	while ((status = mhsm_trace_read(reader, &record)) == 1) {
+		if (speed > 0)
+			_sleep_until(start + (uint64_t) (record.time / speed));
+
+		hsm = mhsm_registry_lookup(registry, record.key);
+		if (hsm == NULL) {
+			reader->skipped++;
+		} else if (mhsm_uses_timers(hsm)) {
+			/* timer events are not recorded, so the replay would diverge */
+			MDBG_PRINT_LN("cannot replay events of HSMs using timers");
+			return -1;
+		} else {
+			mhsm_registry_dispatch(registry, record.key, record.id, record.arg);
+		}
+
+		nrecords++;
+	}
+
+	return status < 0 ? -1 : nrecords;
+}
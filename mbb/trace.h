@@ -0,0 +1,67 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MBB_TRACE_H
+#define MBB_TRACE_H
+
+#include "types.h"
+#include "registry.h"
+#include <stdio.h>
+
+/* 
+ * Recording and replaying event streams.
+ *
+ * A trace is a sequence of records (time, key, event id, argument) where time
+ * is the number of nanoseconds since the start of the recording and key
+ * identifies the HSM as in mbb/registry.h. Traces are written to files in a
+ * compact binary format.
+ */
+
+typedef struct {
+	uint64_t time;
+	uint64_t key;
+	uint32_t id;
+	int32_t arg;
+} mhsm_trace_record_t;
+
+typedef struct {
+	FILE *file;
+	uint64_t start;
+	uint64_t last_time;
+	uint32_t nrof_records;
+	bool error;
+} mhsm_trace_recorder_t;
+
+typedef struct {
+	FILE *file;
+	uint64_t last_time;
+	/* records for keys not found in the registry */
+	uint32_t skipped;
+} mhsm_trace_reader_t;
+
+int mhsm_trace_open_recorder(mhsm_trace_recorder_t *recorder, FILE *file);
+int mhsm_trace_record(mhsm_trace_recorder_t *recorder, uint64_t key, uint32_t id, int32_t arg);
+void mhsm_trace_hook(void *recorder, uint64_t key, uint32_t id, int32_t arg);
+
+int mhsm_trace_open_reader(mhsm_trace_reader_t *reader, FILE *file);
+int mhsm_trace_read(mhsm_trace_reader_t *reader, mhsm_trace_record_t *record);
+long mhsm_trace_replay(mhsm_trace_reader_t *reader, mhsm_registry_t *registry, double speed);
+
+#endif /* MBB_TRACE_H */
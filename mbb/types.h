@@ -40,4 +40,12 @@
 # include <stddef.h>
 #endif
 
+/* 
+ * Storage class of the functions of the HSM core, defined as static by
+ * mbb/mbb.h if MBB_STATIC is defined.
+ */
+#ifndef MBB_API
+# define MBB_API
+#endif
+
 #endif /* MBB_TYPES_H */
@@ -0,0 +1,287 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+
+/* assumes MHSM_MAX_STATES >= 8 */
+
+#define TEST_AS_NROF_HSMS 100
+
+enum {
+	TEST_AS_EVENT_NEXT = MHSM_EVENT_CUSTOM,
+	TEST_AS_EVENT_LEAVE,
+	TEST_AS_EVENT_JUMP
+};
+
+/*
+ * top
+ *   a
+ *     a1
+ *     a2
+ *   b
+ *     b1
+ *       b11
+ */
+MHSM_DEFINE_STATE(test_as_top, NULL);
+MHSM_DEFINE_STATE(test_as_a, &test_as_top);
+MHSM_DEFINE_STATE(test_as_a1, &test_as_a);
+MHSM_DEFINE_STATE(test_as_a2, &test_as_a);
+MHSM_DEFINE_STATE(test_as_b, &test_as_top);
+MHSM_DEFINE_STATE(test_as_b1, &test_as_b);
+MHSM_DEFINE_STATE(test_as_b11, &test_as_b1);
+/* never indexed */
+MHSM_DEFINE_STATE(test_as_orphan, &test_as_b11);
+
+static mhsm_state_t *test_as_states[] = {
+	&test_as_b11, &test_as_b1, &test_as_b, &test_as_a2, &test_as_a1, &test_as_a, &test_as_top
+};
+
+#define TEST_AS_NROF_STATES (sizeof(test_as_states) / sizeof(test_as_states[0]))
+
+mhsm_state_t *test_as_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_as_a;
+		case TEST_AS_EVENT_JUMP:
+			return &test_as_b11;
+	}
+
+	return &test_as_top;
+}
+
+mhsm_state_t *test_as_a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_as_a1;
+		case TEST_AS_EVENT_LEAVE:
+			return &test_as_b;
+	}
+
+	return &test_as_a;
+}
+
+mhsm_state_t *test_as_a1_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_AS_EVENT_NEXT:
+			return &test_as_a2;
+	}
+
+	return &test_as_a1;
+}
+
+mhsm_state_t *test_as_a2_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_as_a2;
+}
+
+mhsm_state_t *test_as_b_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_as_b1;
+		case TEST_AS_EVENT_LEAVE:
+			return &test_as_a;
+	}
+
+	return &test_as_b;
+}
+
+mhsm_state_t *test_as_b1_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_as_b1;
+}
+
+mhsm_state_t *test_as_b11_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_as_b11;
+}
+
+mhsm_state_t *test_as_orphan_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_as_orphan;
+}
+
+/* the set of active states matches the parent chain of the current state */
+static bool test_as_consistent(mhsm_hsm_t *hsm)
+{
+	mhsm_state_t *state;
+	size_t i;
+
+	for (i = 0; i < TEST_AS_NROF_STATES; i++) {
+		bool in = 0;
+
+		for (state = mhsm_current_state(hsm); state != NULL; state = state->parent)
+			if (state == test_as_states[i])
+				in = 1;
+
+		if (mhsm_is_in(hsm, test_as_states[i]) != in)
+			return 0;
+	}
+
+	return 1;
+}
+
+static void test_as_index(void)
+{
+	/* indexing again is a no-op, so every test can do it */
+	mhsm_index_states(test_as_states, TEST_AS_NROF_STATES);
+}
+
+char *test_index_states()
+{
+	mhsm_state_t *orphan[] = { &test_as_orphan };
+
+	MUNT_ASSERT(mhsm_index_states(test_as_states, TEST_AS_NROF_STATES) == 0);
+
+	/* pre-order, regardless of the order of the list */
+	MUNT_ASSERT(test_as_top.index != 0 && test_as_top.last == test_as_top.index + 6);
+	MUNT_ASSERT(test_as_b.index < test_as_b1.index && test_as_b1.index < test_as_b11.index);
+	MUNT_ASSERT(test_as_b.last == test_as_b11.index);
+	MUNT_ASSERT(test_as_a1.last == test_as_a1.index);
+
+	MUNT_ASSERT(mhsm_is_ancestor(&test_as_top, &test_as_b11));
+	MUNT_ASSERT(mhsm_is_ancestor(&test_as_b, &test_as_b11));
+	MUNT_ASSERT(!mhsm_is_ancestor(&test_as_a, &test_as_b11));
+	MUNT_ASSERT(!mhsm_is_ancestor(&test_as_b11, &test_as_b11));
+	MUNT_ASSERT(!mhsm_is_ancestor(&test_as_b11, &test_as_b));
+
+	/* the parent's range cannot grow */
+	MUNT_ASSERT(mhsm_index_states(orphan, 1) == -1);
+	MUNT_ASSERT(test_as_orphan.index == 0);
+	MUNT_ASSERT(mhsm_is_ancestor(&test_as_b1, &test_as_orphan));
+
+	return 0;
+}
+
+char *test_missing_parent()
+{
+	static mhsm_state_t test_as_x = { test_as_top_fun, NULL };
+	static mhsm_state_t test_as_x1 = { test_as_top_fun, &test_as_x };
+	static mhsm_state_t test_as_x11 = { test_as_top_fun, &test_as_x1 };
+	mhsm_state_t *states[] = { &test_as_x, &test_as_x11 };
+
+	/* nothing is indexed */
+	MUNT_ASSERT(mhsm_index_states(states, 2) == -1);
+	MUNT_ASSERT(test_as_x.index == 0 && test_as_x11.index == 0);
+
+	return 0;
+}
+
+char *test_transitions()
+{
+	mhsm_hsm_t hsm;
+
+	test_as_index();
+	mhsm_initialise(&hsm, NULL, &test_as_top);
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_as_top));
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_a));
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_a1);
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_AS_EVENT_NEXT) == 0);
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_as_a2));
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_a1));
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_AS_EVENT_LEAVE) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_b1);
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_AS_EVENT_JUMP) == 0);
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_as_b11));
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_AS_EVENT_LEAVE) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_a1);
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_b));
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	return 0;
+}
+
+char *test_unindexed_states()
+{
+	mhsm_hsm_t hsm;
+
+	test_as_index();
+	mhsm_initialise(&hsm, NULL, &test_as_orphan);
+
+	/* the parent walk is used for states which are not indexed */
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_as_orphan));
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_as_b11));
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_as_top));
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_a));
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_AS_EVENT_LEAVE) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_a1);
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_orphan));
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_b11));
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	return 0;
+}
+
+char *test_restore_current_state()
+{
+	mhsm_hsm_t hsm;
+
+	test_as_index();
+	mhsm_initialise(&hsm, NULL, &test_as_top);
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL) == 0);
+
+	mhsm_restore_current_state(&hsm, &test_as_b11);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_b11);
+	MUNT_ASSERT(!mhsm_is_in(&hsm, &test_as_a1));
+	MUNT_ASSERT(test_as_consistent(&hsm));
+
+	return 0;
+}
+
+char *test_guards_across_hsms()
+{
+	static mhsm_hsm_t hsms[TEST_AS_NROF_HSMS];
+	size_t in_a = 0, in_b = 0;
+	size_t i;
+
+	test_as_index();
+	for (i = 0; i < TEST_AS_NROF_HSMS; i++) {
+		mhsm_initialise(hsms + i, NULL, &test_as_top);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+		if (i % 3 == 0)
+			mhsm_dispatch_event(hsms + i, TEST_AS_EVENT_LEAVE);
+	}
+
+	for (i = 0; i < TEST_AS_NROF_HSMS; i++) {
+		in_a += MHSM_IS_ACTIVE(hsms + i, &test_as_a);
+		in_b += MHSM_IS_ACTIVE(hsms + i, &test_as_b1);
+	}
+
+	MUNT_ASSERT(in_b == (TEST_AS_NROF_HSMS + 2) / 3);
+	MUNT_ASSERT(in_a + in_b == TEST_AS_NROF_HSMS);
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/async.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+enum {
+	TEST_AS_EVENT_DONE = MHSM_EVENT_CUSTOM,
+	TEST_AS_EVENT_REQUEST,
+	TEST_AS_EVENT_ABORT
+};
+
+typedef struct {
+	mhsm_async_t read;
+	uint32_t read_token;
+	int32_t read_result;
+} test_as_context_t;
+
+MHSM_DEFINE_STATE(test_as_idle, NULL);
+MHSM_DEFINE_STATE(test_as_busy, NULL);
+
+mhsm_state_t *test_as_idle_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_AS_EVENT_REQUEST:
+			return &test_as_busy;
+	}
+
+	return &test_as_idle;
+}
+
+mhsm_state_t *test_as_busy_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_as_context_t *ctx = (test_as_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			ctx->read_token = mhsm_async_start(&ctx->read);
+			break;
+		case MHSM_EVENT_EXIT:
+			mhsm_async_cancel(&ctx->read);
+			break;
+		case TEST_AS_EVENT_DONE:
+			ctx->read_result = event.arg;
+			return &test_as_idle;
+		case TEST_AS_EVENT_ABORT:
+			return &test_as_idle;
+	}
+
+	return &test_as_busy;
+}
+
+char *test_async_completion()
+{
+	mhsm_async_loop_t loop;
+	mhsm_hsm_t hsm;
+	test_as_context_t ctx;
+
+	mhsm_async_initialise_loop(&loop);
+	mhsm_initialise(&hsm, &ctx, &test_as_idle);
+	mhsm_async_initialise(&ctx.read, &loop, &hsm, TEST_AS_EVENT_DONE);
+	ctx.read_result = 0;
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	mhsm_dispatch_event(&hsm, TEST_AS_EVENT_REQUEST);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_busy);
+	MUNT_ASSERT(mhsm_async_is_pending(&ctx.read));
+
+	/* nothing is dispatched before mhsm_async_run() */
+	MUNT_ASSERT(mhsm_async_complete(&ctx.read, ctx.read_token, 42) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_busy);
+
+	MUNT_ASSERT(mhsm_async_run(&loop) == 1);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_idle);
+	MUNT_ASSERT(ctx.read_result == 42);
+	MUNT_ASSERT(!mhsm_async_is_pending(&ctx.read));
+
+	return 0;
+}
+
+char *test_async_cancel()
+{
+	mhsm_async_loop_t loop;
+	mhsm_hsm_t hsm;
+	test_as_context_t ctx;
+	uint32_t stale_token;
+
+	mhsm_async_initialise_loop(&loop);
+	mhsm_initialise(&hsm, &ctx, &test_as_idle);
+	mhsm_async_initialise(&ctx.read, &loop, &hsm, TEST_AS_EVENT_DONE);
+	ctx.read_result = 0;
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	mhsm_dispatch_event(&hsm, TEST_AS_EVENT_REQUEST);
+	stale_token = ctx.read_token;
+	mhsm_dispatch_event(&hsm, TEST_AS_EVENT_ABORT);
+	MUNT_ASSERT(!mhsm_async_is_pending(&ctx.read));
+
+	/* the completion of the cancelled operation is dropped */
+	mhsm_async_complete(&ctx.read, stale_token, 1);
+	MUNT_ASSERT(mhsm_async_run(&loop) == 0);
+
+	/* so is a late completion of a superseded operation */
+	mhsm_dispatch_event(&hsm, TEST_AS_EVENT_REQUEST);
+	mhsm_async_complete(&ctx.read, stale_token, 2);
+	mhsm_async_complete(&ctx.read, ctx.read_token, 3);
+	MUNT_ASSERT(mhsm_async_run(&loop) == 1);
+	MUNT_ASSERT(ctx.read_result == 3);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_as_idle);
+
+	return 0;
+}
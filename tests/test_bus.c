@@ -0,0 +1,162 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/bus.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+#define TEST_BS_NROF_HSMS 10
+
+enum {
+	TEST_BS_EVENT_RELOAD = MHSM_EVENT_CUSTOM,
+	TEST_BS_EVENT_LINK_DOWN,
+	TEST_BS_EVENT_LINK_UP
+};
+
+enum {
+	TEST_BS_TOPIC_CONFIG,
+	TEST_BS_TOPIC_LINK,
+	TEST_BS_NROF_TOPICS
+};
+
+/* context of HSMs unsubscribing themselves and a peer on LINK_DOWN */
+typedef struct {
+	mhsm_bus_t *bus;
+	mhsm_hsm_t *peer;
+	int received;
+} test_bs_leaver_t;
+
+MHSM_DEFINE_STATE(test_bs_state, NULL);
+MHSM_DEFINE_STATE(test_bs_leaving, NULL);
+
+mhsm_state_t *test_bs_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	int *received = (int*) mhsm_context(hsm);
+
+	if (event.id >= MHSM_EVENT_CUSTOM)
+		*received += event.arg;
+
+	return &test_bs_state;
+}
+
+mhsm_state_t *test_bs_leaving_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_bs_leaver_t *ctx = (test_bs_leaver_t*) mhsm_context(hsm);
+
+	if (event.id < MHSM_EVENT_CUSTOM)
+		return &test_bs_leaving;
+
+	ctx->received++;
+	if (event.id == TEST_BS_EVENT_LINK_DOWN && ctx->peer != NULL) {
+		mhsm_bus_unsubscribe(ctx->bus, TEST_BS_TOPIC_LINK, hsm);
+		mhsm_bus_unsubscribe(ctx->bus, TEST_BS_TOPIC_LINK, ctx->peer);
+	}
+
+	return &test_bs_leaving;
+}
+
+char *test_bus()
+{
+	mhsm_bus_t bus;
+	mhsm_bus_topic_t topics[TEST_BS_NROF_TOPICS];
+	mhsm_hsm_t *config_subscribers[TEST_BS_NROF_HSMS];
+	mhsm_hsm_t *link_subscribers[TEST_BS_NROF_HSMS];
+	mhsm_hsm_t hsms[TEST_BS_NROF_HSMS];
+	int received[TEST_BS_NROF_HSMS];
+	int i;
+
+	mhsm_bus_initialise(&bus, topics, TEST_BS_NROF_TOPICS);
+	mhsm_bus_initialise_topic(&bus, TEST_BS_TOPIC_CONFIG, TEST_BS_EVENT_RELOAD, TEST_BS_EVENT_RELOAD, config_subscribers, TEST_BS_NROF_HSMS);
+	mhsm_bus_initialise_topic(&bus, TEST_BS_TOPIC_LINK, TEST_BS_EVENT_LINK_DOWN, TEST_BS_EVENT_LINK_UP, link_subscribers, TEST_BS_NROF_HSMS - 1);
+
+	for (i = 0; i < TEST_BS_NROF_HSMS; i++) {
+		received[i] = 0;
+		mhsm_initialise(hsms + i, received + i, &test_bs_state);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+
+		MUNT_ASSERT(mhsm_bus_subscribe(&bus, TEST_BS_TOPIC_CONFIG, hsms + i) == 0);
+		if (i > 0)
+			MUNT_ASSERT(mhsm_bus_subscribe(&bus, TEST_BS_TOPIC_LINK, hsms + i) == 0);
+	}
+	MUNT_ASSERT(mhsm_bus_subscribe(&bus, TEST_BS_TOPIC_LINK, hsms) == -1);
+
+	MUNT_ASSERT(mhsm_bus_publish(&bus, TEST_BS_EVENT_RELOAD, 1) == 0);
+	MUNT_ASSERT(mhsm_bus_publish(&bus, TEST_BS_EVENT_LINK_UP, 10) == 0);
+	MUNT_ASSERT(received[0] == 1);
+	for (i = 1; i < TEST_BS_NROF_HSMS; i++)
+		MUNT_ASSERT(received[i] == 11);
+
+	MUNT_ASSERT(mhsm_bus_unsubscribe(&bus, TEST_BS_TOPIC_LINK, hsms + 5) == 0);
+	MUNT_ASSERT(mhsm_bus_unsubscribe(&bus, TEST_BS_TOPIC_LINK, hsms + 5) == -1);
+
+	/* slices partition the subscribers */
+	for (i = 0; i < 4; i++)
+		MUNT_ASSERT(mhsm_bus_publish_slice(&bus, TEST_BS_TOPIC_LINK, TEST_BS_EVENT_LINK_DOWN, 100, i, 4) == 0);
+	MUNT_ASSERT(received[0] == 1);
+	MUNT_ASSERT(received[5] == 11);
+	for (i = 1; i < TEST_BS_NROF_HSMS; i++)
+		if (i != 5)
+			MUNT_ASSERT(received[i] == 111);
+
+	return 0;
+}
+
+char *test_unsubscribe_while_publishing()
+{
+	mhsm_bus_t bus;
+	mhsm_bus_topic_t topics[TEST_BS_NROF_TOPICS];
+	mhsm_hsm_t *link_subscribers[TEST_BS_NROF_HSMS];
+	mhsm_hsm_t hsms[TEST_BS_NROF_HSMS];
+	test_bs_leaver_t contexts[TEST_BS_NROF_HSMS];
+	int i;
+
+	mhsm_bus_initialise(&bus, topics, TEST_BS_NROF_TOPICS);
+	mhsm_bus_initialise_topic(&bus, TEST_BS_TOPIC_LINK, TEST_BS_EVENT_LINK_DOWN, TEST_BS_EVENT_LINK_UP, link_subscribers, TEST_BS_NROF_HSMS);
+
+	for (i = 0; i < TEST_BS_NROF_HSMS; i++) {
+		contexts[i].bus = &bus;
+		contexts[i].peer = NULL;
+		contexts[i].received = 0;
+		mhsm_initialise(hsms + i, contexts + i, &test_bs_leaving);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+		MUNT_ASSERT(mhsm_bus_subscribe(&bus, TEST_BS_TOPIC_LINK, hsms + i) == 0);
+	}
+
+	/* the second subscriber leaves, taking the last one along */
+	contexts[1].peer = hsms + TEST_BS_NROF_HSMS - 1;
+
+	MUNT_ASSERT(mhsm_bus_publish(&bus, TEST_BS_EVENT_LINK_DOWN, 0) == 0);
+	for (i = 0; i < TEST_BS_NROF_HSMS - 1; i++)
+		MUNT_ASSERT(contexts[i].received == 1);
+	MUNT_ASSERT(contexts[TEST_BS_NROF_HSMS - 1].received == 0);
+	MUNT_ASSERT(topics[TEST_BS_TOPIC_LINK].count == TEST_BS_NROF_HSMS - 2);
+
+	MUNT_ASSERT(mhsm_bus_publish_topic(&bus, TEST_BS_TOPIC_LINK, TEST_BS_EVENT_LINK_UP, 0) == 0);
+	MUNT_ASSERT(contexts[1].received == 1);
+	MUNT_ASSERT(contexts[TEST_BS_NROF_HSMS - 1].received == 0);
+	for (i = 0; i < TEST_BS_NROF_HSMS - 1; i++)
+		if (i != 1)
+			MUNT_ASSERT(contexts[i].received == 2);
+
+	MUNT_ASSERT(mhsm_bus_unsubscribe(&bus, TEST_BS_TOPIC_LINK, hsms + 1) == -1);
+
+	return 0;
+}
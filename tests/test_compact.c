@@ -0,0 +1,294 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+#include "mbb/snapshot.h"
+
+/* assumes MHSM_COMPACT_QUEUES < TEST_CO_NROF_HSMS */
+
+#define TEST_CO_NROF_HSMS 1000
+
+enum {
+	TEST_CO_EVENT_CONFIG = MHSM_EVENT_CUSTOM,
+	TEST_CO_EVENT_GO
+};
+
+typedef struct {
+	int configs;
+} test_co_context_t;
+
+MHSM_DEFINE_STATE(test_co_waiting, NULL);
+MHSM_DEFINE_STATE(test_co_running, NULL);
+MHSM_DEFINE_STATE(test_co_top, NULL);
+MHSM_DEFINE_STATE(test_co_sub, &test_co_top);
+
+mhsm_state_t *test_co_waiting_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_CO_EVENT_CONFIG:
+			return NULL;
+		case TEST_CO_EVENT_GO:
+			return &test_co_running;
+	}
+
+	return &test_co_waiting;
+}
+
+mhsm_state_t *test_co_running_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_co_context_t *ctx = (test_co_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case TEST_CO_EVENT_CONFIG:
+			ctx->configs++;
+			return MHSM_HANDLED;
+	}
+
+	return &test_co_running;
+}
+
+mhsm_state_t *test_co_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_co_sub;
+	}
+
+	return &test_co_top;
+}
+
+mhsm_state_t *test_co_sub_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_co_sub;
+}
+
+static int test_co_timers_a;
+static int test_co_timers_b;
+
+static int test_co_start_timer_a(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs)
+{
+	test_co_timers_a++;
+	return 0;
+}
+
+static int test_co_start_timer_b(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs)
+{
+	test_co_timers_b++;
+	return 0;
+}
+
+static test_co_context_t test_co_contexts[TEST_CO_NROF_HSMS];
+static mhsm_hsm_t test_co_hsms[TEST_CO_NROF_HSMS];
+
+char *test_size()
+{
+#if !defined(MHSM_STATISTICS) && !defined(MHSM_PROFILE) && MHSM_MAX_STATES == 0
+	/* context, current state, queue index, and flags */
+	MUNT_ASSERT(sizeof(mhsm_hsm_t) <= 3 * sizeof(void*));
+#endif
+
+	return 0;
+}
+
+char *test_shared_queues()
+{
+	size_t i;
+
+	for (i = 0; i < TEST_CO_NROF_HSMS; i++) {
+		test_co_contexts[i].configs = 0;
+		mhsm_initialise(test_co_hsms + i, test_co_contexts + i, &test_co_waiting);
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, MHSM_EVENT_INITIAL) == 0);
+	}
+
+	/* a queue per HSM with deferred events, until the pool is exhausted */
+	for (i = 0; i < MHSM_COMPACT_QUEUES; i++) {
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_CONFIG) == 0);
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_CONFIG) == 0);
+		MUNT_ASSERT(mhsm_queue_length(test_co_hsms + i) == 2);
+	}
+	MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_CONFIG) == -1);
+	MUNT_ASSERT(mhsm_queue_length(test_co_hsms + i) == 0);
+
+	/* the queues are returned once the deferred events are dispatched */
+	for (i = 0; i < MHSM_COMPACT_QUEUES; i++) {
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_GO) == 0);
+		MUNT_ASSERT(test_co_contexts[i].configs == 2);
+		MUNT_ASSERT(mhsm_queue_length(test_co_hsms + i) == 0);
+		MUNT_ASSERT(mhsm_deferred_events(test_co_hsms + i) == NULL);
+	}
+
+	for (i = MHSM_COMPACT_QUEUES; i < TEST_CO_NROF_HSMS; i++) {
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_CONFIG) == 0);
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_GO) == 0);
+		MUNT_ASSERT(test_co_contexts[i].configs == 1);
+	}
+
+	return 0;
+}
+
+char *test_clear_queues()
+{
+	mhsm_event_t event = { TEST_CO_EVENT_CONFIG, 0 };
+	mhsm_hsm_t hsm;
+
+	mhsm_initialise(&hsm, NULL, &test_co_waiting);
+	MUNT_ASSERT(mhsm_deferred_events(&hsm) == NULL);
+
+	MUNT_ASSERT(mhsm_queue_event(&hsm, event, 0) == 0);
+	MUNT_ASSERT(mhsm_deferred_events(&hsm) != NULL);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 1);
+
+	/* the queue is kept for events about to be queued */
+	MUNT_ASSERT(mhsm_clear_queues(&hsm, 1) == 0);
+	MUNT_ASSERT(mhsm_deferred_events(&hsm) != NULL);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 0);
+
+	MUNT_ASSERT(mhsm_clear_queues(&hsm, 0) == 0);
+	MUNT_ASSERT(mhsm_deferred_events(&hsm) == NULL);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 0);
+
+	return 0;
+}
+
+char *test_type_timer_callbacks()
+{
+	static mhsm_type_t type_a, type_b;
+	mhsm_hsm_t a[2], b;
+
+	mhsm_set_type(&test_co_top, &type_a);
+	mhsm_set_type(&test_co_running, &type_b);
+
+	mhsm_initialise(a + 0, NULL, &test_co_top);
+	mhsm_initialise(a + 1, NULL, &test_co_top);
+	mhsm_initialise(&b, NULL, &test_co_running);
+	MUNT_ASSERT(mhsm_dispatch_event(a + 0, MHSM_EVENT_INITIAL) == 0);
+
+	/* all HSMs of a type share the callback, substates inherit the type */
+	mhsm_set_timer_callback(a + 0, test_co_start_timer_a);
+	MUNT_ASSERT(mhsm_start_timer(a + 1, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(mhsm_start_timer(a + 0, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(test_co_timers_a == 2);
+	MUNT_ASSERT(mhsm_start_timer(&b, TEST_CO_EVENT_GO, 10) == -1);
+
+	mhsm_set_timer_callback(&b, test_co_start_timer_b);
+	MUNT_ASSERT(mhsm_start_timer(&b, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(mhsm_start_timer(a + 1, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(test_co_timers_a == 3 && test_co_timers_b == 1);
+
+	mhsm_set_type(&test_co_top, NULL);
+	mhsm_set_type(&test_co_running, NULL);
+
+	return 0;
+}
+
+char *test_untyped_timer_callbacks()
+{
+	mhsm_hsm_t a, b;
+
+	test_co_timers_a = 0;
+	test_co_timers_b = 0;
+	mhsm_initialise(&a, NULL, &test_co_running);
+	mhsm_initialise(&b, NULL, &test_co_running);
+
+	/* HSMs without a type keep their own callbacks */
+	MUNT_ASSERT(mhsm_start_timer(&a, TEST_CO_EVENT_GO, 10) == -1);
+	MUNT_ASSERT(mhsm_set_timer_callback(&a, test_co_start_timer_a) == 0);
+	MUNT_ASSERT(mhsm_set_timer_callback(&b, test_co_start_timer_b) == 0);
+	MUNT_ASSERT(mhsm_start_timer(&a, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(mhsm_start_timer(&b, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(test_co_timers_a == 1 && test_co_timers_b == 1);
+
+	MUNT_ASSERT(mhsm_set_timer_callback(&b, NULL) == 0);
+	MUNT_ASSERT(mhsm_start_timer(&b, TEST_CO_EVENT_GO, 10) == -1);
+	MUNT_ASSERT(mhsm_start_timer(&a, TEST_CO_EVENT_GO, 10) == 0);
+	MUNT_ASSERT(test_co_timers_a == 2);
+
+	return 0;
+}
+
+static void test_co_take_queue(size_t i)
+{
+	test_co_contexts[i].configs = 0;
+	mhsm_initialise(test_co_hsms + i, test_co_contexts + i, &test_co_waiting);
+	mhsm_dispatch_event(test_co_hsms + i, MHSM_EVENT_INITIAL);
+	mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_CONFIG);
+}
+
+char *test_restore_without_queues()
+{
+	static mhsm_state_t *states[] = { &test_co_waiting, &test_co_running };
+	test_co_context_t ctxs[2] = { { 0 }, { 0 } }, restored_ctxs[2] = { { 0 }, { 0 } };
+	mhsm_hsm_t hsms[2], restored[2];
+	uint8_t buffer[32];
+	size_t i, j;
+	FILE *file;
+	int length;
+
+	for (j = 0; j < 2; j++) {
+		mhsm_initialise(hsms + j, ctxs + j, &test_co_waiting);
+		MUNT_ASSERT(mhsm_dispatch_event(hsms + j, MHSM_EVENT_INITIAL) == 0);
+		MUNT_ASSERT(mhsm_dispatch_event(hsms + j, TEST_CO_EVENT_CONFIG) == 0);
+
+		mhsm_initialise(restored + j, restored_ctxs + j, &test_co_running);
+		MUNT_ASSERT(mhsm_dispatch_event(restored + j, MHSM_EVENT_INITIAL) == 0);
+	}
+
+	length = mhsm_snapshot_save(hsms, states, 2, 0, buffer, sizeof(buffer));
+	MUNT_ASSERT(length > 0);
+	file = tmpfile();
+	MUNT_ASSERT(file != NULL);
+	MUNT_ASSERT(mhsm_snapshot_write(file, hsms, 2, states, 2, 0) == 0);
+
+	/* a single queue is left, the file needs two */
+	for (i = 0; mhsm_free_queues() > 1; i++)
+		test_co_take_queue(i);
+	rewind(file);
+	MUNT_ASSERT(mhsm_snapshot_read(file, restored, 2, states, 2, 0) == -1);
+	fclose(file);
+	for (j = 0; j < 2; j++) {
+		MUNT_ASSERT(mhsm_current_state(restored + j) == &test_co_running);
+		MUNT_ASSERT(mhsm_deferred_events(restored + j) == NULL);
+	}
+
+	/* none is left */
+	test_co_take_queue(i++);
+	MUNT_ASSERT(mhsm_snapshot_restore(restored, states, 2, 0, buffer, length) == -1);
+	MUNT_ASSERT(mhsm_current_state(restored) == &test_co_running);
+	MUNT_ASSERT(mhsm_deferred_events(restored) == NULL);
+
+	/* an HSM holding a queue keeps it */
+	MUNT_ASSERT(mhsm_snapshot_restore(hsms, states, 2, 0, buffer, length) == length);
+	MUNT_ASSERT(mhsm_queue_length(hsms) == 1);
+
+	while (i-- > 0)
+		MUNT_ASSERT(mhsm_dispatch_event(test_co_hsms + i, TEST_CO_EVENT_GO) == 0);
+	for (j = 0; j < 2; j++) {
+		MUNT_ASSERT(mhsm_dispatch_event(hsms + j, TEST_CO_EVENT_GO) == 0);
+		MUNT_ASSERT(ctxs[j].configs == 1);
+	}
+
+	MUNT_ASSERT(mhsm_snapshot_restore(restored, states, 2, 0, buffer, length) == length);
+	MUNT_ASSERT(mhsm_current_state(restored) == &test_co_waiting);
+	MUNT_ASSERT(mhsm_queue_length(restored) == 1);
+
+	return 0;
+}
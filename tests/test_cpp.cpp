@@ -0,0 +1,322 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/hsm.hpp"
+#include "mbb/timer_periodic.h"
+
+#include <string.h>
+
+enum {
+	TEST_EVENT_TICK = MHSM_EVENT_CUSTOM,
+	TEST_EVENT_START,
+	TEST_EVENT_STOP,
+	TEST_EVENT_FASTER,
+	TEST_EVENT_SLOWER,
+	TEST_EVENT_RESTART,
+	TEST_EVENT_CONFIGURE,
+	TEST_EVENT_COUNT
+};
+
+typedef struct {
+	mtmr_prd_t timers[MTMR_NROF_TIMERS(TEST_EVENT_TICK)];
+	char log[64];
+	int ticks;
+	int counted;
+	bool configurable;
+} test_context_t;
+
+typedef mbb::hsm<test_context_t> test_hsm_t;
+
+static void test_log(test_hsm_t &m, char c)
+{
+	size_t length = strlen(m.context().log);
+
+	if (length + 1 < sizeof(m.context().log)) {
+		m.context().log[length] = c;
+		m.context().log[length + 1] = '\0';
+	}
+}
+
+struct test_idle;
+struct test_slow;
+
+struct test_top {
+	using initial = test_idle;
+
+	static void entry(test_hsm_t &m) { test_log(m, 'T'); }
+	static void exit(test_hsm_t &m) { test_log(m, 't'); }
+
+	static mbb::result handle(test_hsm_t &m, const mbb::event &e)
+	{
+		if (e.id == TEST_EVENT_COUNT) {
+			m.context().counted++;
+			return mbb::handled;
+		}
+
+		return mbb::unhandled;
+	}
+};
+
+struct test_running;
+
+struct test_idle {
+	using parent = test_top;
+
+	static void entry(test_hsm_t &m) { test_log(m, 'I'); }
+	static void exit(test_hsm_t &m) { test_log(m, 'i'); }
+
+	static mbb::result handle(test_hsm_t &m, const mbb::event &e)
+	{
+		switch (e.id) {
+			case TEST_EVENT_START:
+				return mbb::transition<test_running>;
+			case TEST_EVENT_CONFIGURE:
+				return m.context().configurable ? mbb::handled : mbb::deferred;
+		}
+
+		return mbb::unhandled;
+	}
+};
+
+struct test_running {
+	using parent = test_top;
+	using initial = test_slow;
+
+	static void entry(test_hsm_t &m)
+	{
+		test_log(m, 'R');
+		m.start_timer(TEST_EVENT_TICK, 10);
+	}
+
+	static void exit(test_hsm_t &m)
+	{
+		test_log(m, 'r');
+		m.start_timer(TEST_EVENT_TICK, 0);
+	}
+
+	static mbb::result handle(test_hsm_t &m, const mbb::event &e)
+	{
+		switch (e.id) {
+			case TEST_EVENT_STOP:
+				return mbb::transition<test_idle>;
+			case TEST_EVENT_RESTART:
+				return mbb::transition<test_running>;
+			case TEST_EVENT_TICK:
+				m.context().ticks++;
+				m.start_timer(TEST_EVENT_TICK, 10);
+				return mbb::handled;
+			case TEST_EVENT_CONFIGURE:
+				return mbb::handled;
+		}
+
+		return mbb::unhandled;
+	}
+};
+
+struct test_fast;
+
+struct test_slow {
+	using parent = test_running;
+
+	static void entry(test_hsm_t &m) { test_log(m, 'S'); }
+	static void exit(test_hsm_t &m) { test_log(m, 's'); }
+
+	static mbb::result handle(test_hsm_t &m, const mbb::event &e)
+	{
+		if (e.id == TEST_EVENT_FASTER)
+			return mbb::transition<test_fast>;
+
+		if (e.id == TEST_EVENT_COUNT) {
+			m.context().counted++;
+			return mbb::handled;
+		}
+
+		return mbb::unhandled;
+	}
+};
+
+struct test_fast {
+	using parent = test_running;
+
+	static void entry(test_hsm_t &m) { test_log(m, 'F'); }
+	static void exit(test_hsm_t &m) { test_log(m, 'f'); }
+
+	static mbb::result handle(test_hsm_t &m, const mbb::event &e)
+	{
+		if (e.id == TEST_EVENT_SLOWER)
+			return mbb::transition<test_slow>;
+
+		/* a transition to itself exits and re-enters the state */
+		if (e.id == TEST_EVENT_FASTER)
+			return mbb::transition<test_fast>;
+
+		return mbb::unhandled;
+	}
+};
+
+typedef mbb::machine<test_context_t, test_top, test_idle, test_running, test_slow, test_fast> test_machine_t;
+
+static_assert(test_machine_t::index<test_slow>() == 3, "states are indexed in order");
+static_assert(test_machine_t::index<mbb::root>() == test_machine_t::none, "root is no state");
+static_assert(test_machine_t::parent(test_machine_t::index<test_fast>()) == test_machine_t::index<test_running>(),
+		"parents are resolved at compile time");
+static_assert(test_machine_t::depth(test_machine_t::index<test_fast>()) == 2, "depths are resolved at compile time");
+static_assert(test_machine_t::least_common_ancestor(test_machine_t::index<test_slow>(), test_machine_t::index<test_fast>()) ==
+		test_machine_t::index<test_running>(), "siblings have their parent as least common ancestor");
+static_assert(test_machine_t::least_common_ancestor(test_machine_t::index<test_slow>(), test_machine_t::index<test_idle>()) ==
+		test_machine_t::index<test_top>(), "cousins have a common ancestor");
+static_assert(test_machine_t::least_common_ancestor(test_machine_t::index<test_running>(), test_machine_t::index<test_fast>()) ==
+		test_machine_t::index<test_running>(), "an ancestor is its own least common ancestor");
+static_assert(test_machine_t::least_common_ancestor(test_machine_t::index<test_fast>(), test_machine_t::index<test_fast>()) ==
+		test_machine_t::index<test_running>(), "self-transitions exit the state");
+
+static test_context_t test_context;
+
+static void test_reset(void)
+{
+	memset(&test_context, 0, sizeof(test_context));
+}
+
+static bool test_logged(const char *expected)
+{
+	bool equal = strcmp(test_context.log, expected) == 0;
+
+	test_context.log[0] = '\0';
+
+	return equal;
+}
+
+char *test_initial_transitions()
+{
+	test_reset();
+	test_machine_t machine(&test_context);
+
+	MUNT_ASSERT(machine.start() == 0);
+	MUNT_ASSERT(test_logged("TI"));
+	MUNT_ASSERT(machine.is_in<test_idle>());
+	MUNT_ASSERT(machine.is_in<test_top>());
+	MUNT_ASSERT(!machine.is_in<test_running>());
+
+	/* the initial transition of running descends into slow */
+	MUNT_ASSERT(machine.dispatch(TEST_EVENT_START) == 0);
+	MUNT_ASSERT(test_logged("iRS"));
+	MUNT_ASSERT(machine.current() == test_machine_t::index<test_slow>());
+	MUNT_ASSERT(machine.is_in<test_running>());
+
+	return 0;
+}
+
+char *test_transitions()
+{
+	test_reset();
+	test_machine_t machine(&test_context);
+
+	machine.start();
+	machine.dispatch(TEST_EVENT_START);
+	test_logged("");
+
+	/* siblings */
+	machine.dispatch(TEST_EVENT_FASTER);
+	MUNT_ASSERT(test_logged("sF"));
+	machine.dispatch(TEST_EVENT_SLOWER);
+	MUNT_ASSERT(test_logged("fS"));
+
+	/* self-transition */
+	machine.dispatch(TEST_EVENT_FASTER);
+	machine.dispatch(TEST_EVENT_FASTER);
+	MUNT_ASSERT(test_logged("sFfF"));
+
+	/* as in C, a transition to a superstate exits the substates only */
+	machine.dispatch(TEST_EVENT_RESTART);
+	MUNT_ASSERT(test_logged("f"));
+	MUNT_ASSERT(machine.current() == test_machine_t::index<test_running>());
+
+	/* transition of a superstate */
+	machine.dispatch(TEST_EVENT_STOP);
+	MUNT_ASSERT(test_logged("rI"));
+	MUNT_ASSERT(machine.current() == test_machine_t::index<test_idle>());
+
+	/* unhandled events */
+	MUNT_ASSERT(machine.dispatch(TEST_EVENT_SLOWER) == 0);
+	MUNT_ASSERT(test_logged(""));
+
+	return 0;
+}
+
+char *test_propagation()
+{
+	test_reset();
+	test_machine_t machine(&test_context);
+
+	machine.start();
+	machine.dispatch(TEST_EVENT_START);
+
+	/* greedy propagation */
+	machine.dispatch(TEST_EVENT_COUNT);
+	MUNT_ASSERT(test_context.counted == 2);
+
+	machine.set_propagation(MHSM_PROPAGATION_CONSUME);
+	machine.dispatch(TEST_EVENT_COUNT);
+	MUNT_ASSERT(test_context.counted == 3);
+
+	return 0;
+}
+
+char *test_deferred_events()
+{
+	test_reset();
+	test_machine_t machine(&test_context);
+
+	machine.start();
+
+	MUNT_ASSERT(machine.dispatch(TEST_EVENT_CONFIGURE) == 0);
+	MUNT_ASSERT(mhsm_queue_length(machine.c_hsm()) == 1);
+
+	/* the deferred event is handled by running */
+	machine.dispatch(TEST_EVENT_START);
+	MUNT_ASSERT(mhsm_queue_length(machine.c_hsm()) == 0);
+
+	return 0;
+}
+
+char *test_timers()
+{
+	test_reset();
+	test_machine_t machine(&test_context);
+
+	MUNT_ASSERT(mtmr_prd_initialise_timers(machine.c_hsm(), MTMR_NROF_TIMERS(TEST_EVENT_TICK)) == 0);
+
+	machine.start();
+	mtmr_prd_increment_timers(machine.c_hsm(), MTMR_NROF_TIMERS(TEST_EVENT_TICK), 10);
+	MUNT_ASSERT(test_context.ticks == 0);
+
+	machine.dispatch(TEST_EVENT_START);
+	mtmr_prd_increment_timers(machine.c_hsm(), MTMR_NROF_TIMERS(TEST_EVENT_TICK), 10);
+	mtmr_prd_increment_timers(machine.c_hsm(), MTMR_NROF_TIMERS(TEST_EVENT_TICK), 10);
+	MUNT_ASSERT(test_context.ticks == 2);
+
+	/* exiting running stops the timer */
+	machine.dispatch(TEST_EVENT_STOP);
+	mtmr_prd_increment_timers(machine.c_hsm(), MTMR_NROF_TIMERS(TEST_EVENT_TICK), 10);
+	MUNT_ASSERT(test_context.ticks == 2);
+
+	return 0;
+}
@@ -0,0 +1,287 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+#include <string.h>
+
+/* assumes MHSM_EVENT_QUEUE_LENGTH >= 5 */
+
+enum {
+	TEST_DR_EVENT_FANOUT = MHSM_EVENT_CUSTOM,
+	TEST_DR_EVENT_TICK,
+	TEST_DR_EVENT_CONFIG,
+	TEST_DR_EVENT_GO,
+	TEST_DR_EVENT_LOG
+};
+
+typedef struct {
+	int ticks;
+	int configs;
+} test_dr_context_t;
+
+static uint64_t test_dr_clock;
+static char test_dr_log[16];
+
+static uint64_t test_dr_now(void)
+{
+	return test_dr_clock;
+}
+
+MHSM_DEFINE_STATE(test_dr_running, NULL);
+MHSM_DEFINE_STATE(test_dr_waiting, NULL);
+
+mhsm_state_t *test_dr_running_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_dr_context_t *ctx = (test_dr_context_t*) mhsm_context(hsm);
+	int i;
+
+	switch (event.id) {
+		case TEST_DR_EVENT_FANOUT:
+			/* queued, since the HSM is busy */
+			for (i = 0; i < event.arg; i++)
+				mhsm_dispatch_event(hsm, TEST_DR_EVENT_TICK);
+			return MHSM_HANDLED;
+		case TEST_DR_EVENT_TICK:
+			ctx->ticks++;
+			test_dr_clock += 10;
+			if (event.arg > 0)
+				mhsm_dispatch_event_arg(hsm, TEST_DR_EVENT_TICK, event.arg - 1);
+			return MHSM_HANDLED;
+		case TEST_DR_EVENT_CONFIG:
+			ctx->configs++;
+			return MHSM_HANDLED;
+		case TEST_DR_EVENT_LOG:
+			test_dr_log[strlen(test_dr_log)] = '0' + event.arg;
+			if (event.arg == 1)
+				mhsm_dispatch_event_arg(hsm, TEST_DR_EVENT_LOG, 2);
+			return MHSM_HANDLED;
+	}
+
+	return &test_dr_running;
+}
+
+mhsm_state_t *test_dr_waiting_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_DR_EVENT_CONFIG:
+			return NULL;
+		case TEST_DR_EVENT_GO:
+			return &test_dr_running;
+	}
+
+	return &test_dr_waiting;
+}
+
+static void test_dr_initialise(mhsm_hsm_t *hsm, test_dr_context_t *ctx, mhsm_state_t *state)
+{
+	ctx->ticks = 0;
+	ctx->configs = 0;
+	test_dr_clock = 0;
+	memset(test_dr_log, 0, sizeof(test_dr_log));
+	mhsm_initialise(hsm, ctx, state);
+	mhsm_dispatch_event(hsm, MHSM_EVENT_INITIAL);
+}
+
+char *test_event_budget()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 3, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	/* the event itself and two of the queued ones */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_FANOUT, 5, &budget) == 1);
+	MUNT_ASSERT(budget.events == 0);
+	MUNT_ASSERT(ctx.ticks == 2);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 3);
+
+	budget.events = 2;
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 1);
+	MUNT_ASSERT(ctx.ticks == 4);
+
+	budget.events = 2;
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 0);
+	MUNT_ASSERT(budget.events == 1);
+	MUNT_ASSERT(ctx.ticks == 5);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 0);
+
+	return 0;
+}
+
+char *test_exhausted_budget()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 0, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	/* the event is queued for the next drain */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_TICK, 0, &budget) == 1);
+	MUNT_ASSERT(ctx.ticks == 0);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 1);
+
+	budget.events = 1;
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 0);
+	MUNT_ASSERT(ctx.ticks == 1);
+
+	return 0;
+}
+
+char *test_deadline()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { UINT32_MAX, 25, test_dr_now };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	/* each tick takes 10 time units */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_FANOUT, 5, &budget) == 1);
+	MUNT_ASSERT(ctx.ticks == 3);
+	MUNT_ASSERT(test_dr_clock == 30);
+
+	budget.deadline = 1000;
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 0);
+	MUNT_ASSERT(ctx.ticks == 5);
+
+	return 0;
+}
+
+char *test_new_events_pending()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 100, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	/* every queued event is dispatched once, its successors are pending */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_TICK, 3, &budget) == 1);
+	MUNT_ASSERT(ctx.ticks == 2);
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 1);
+	MUNT_ASSERT(ctx.ticks == 3);
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 0);
+	MUNT_ASSERT(ctx.ticks == 4);
+
+	return 0;
+}
+
+char *test_deferred_events_not_pending()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 100, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_waiting);
+
+	/* deferred events wait for a transition, not for budget */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_CONFIG, 0, &budget) == 0);
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_CONFIG, 0, &budget) == 0);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 2);
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 0);
+
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_GO, 0, &budget) == 0);
+	MUNT_ASSERT(ctx.configs == 2);
+
+	return 0;
+}
+
+char *test_shared_budget()
+{
+	test_dr_context_t ctx[2];
+	mhsm_budget_t budget = { 4, 0, NULL };
+	mhsm_hsm_t hsm[2];
+
+	test_dr_initialise(hsm + 0, ctx + 0, &test_dr_running);
+	test_dr_initialise(hsm + 1, ctx + 1, &test_dr_running);
+
+	MUNT_ASSERT(mhsm_dispatch_event_budget(hsm + 0, TEST_DR_EVENT_FANOUT, 2, &budget) == 0);
+	MUNT_ASSERT(mhsm_dispatch_event_budget(hsm + 1, TEST_DR_EVENT_FANOUT, 2, &budget) == 1);
+	MUNT_ASSERT(ctx[0].ticks == 2);
+	MUNT_ASSERT(ctx[1].ticks == 0);
+
+	/* the unbounded functions are not affected */
+	MUNT_ASSERT(mhsm_dispatch_event(hsm + 1, TEST_DR_EVENT_TICK) == 0);
+	MUNT_ASSERT(ctx[1].ticks == 3);
+
+	return 0;
+}
+
+char *test_order_after_budget()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 1, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	/* 2 is posted by 1 and left over */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_LOG, 1, &budget) == 1);
+	MUNT_ASSERT(strcmp(test_dr_log, "1") == 0);
+
+	/* 3 is queued behind 2 */
+	budget.events = 10;
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_LOG, 3, &budget) == 0);
+	MUNT_ASSERT(strcmp(test_dr_log, "123") == 0);
+
+	return 0;
+}
+
+char *test_order_after_budget_unbounded()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 1, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_LOG, 1, &budget) == 1);
+	MUNT_ASSERT(mhsm_dispatch_event_arg(&hsm, TEST_DR_EVENT_LOG, 3) == 0);
+	MUNT_ASSERT(strcmp(test_dr_log, "123") == 0);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 0);
+
+	return 0;
+}
+
+char *test_order_budget_exhausted()
+{
+	test_dr_context_t ctx;
+	mhsm_budget_t budget = { 1, 0, NULL };
+	mhsm_hsm_t hsm;
+
+	test_dr_initialise(&hsm, &ctx, &test_dr_running);
+
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_LOG, 1, &budget) == 1);
+
+	/* 3 waits behind 2 for the next budget */
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_DR_EVENT_LOG, 3, &budget) == 1);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 2);
+
+	budget.events = 10;
+	MUNT_ASSERT(mhsm_drain(&hsm, &budget) == 0);
+	MUNT_ASSERT(strcmp(test_dr_log, "123") == 0);
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/heap.h"
+#include "mbb/debug.h"
+
+#define TEST_HEAP_LESS(A, B) ((A) < (B))
+
+typedef struct {
+	int key;
+	size_t index;
+} test_heap_item_t;
+
+#define TEST_HEAP_ITEM_LESS(A, B) ((A)->key < (B)->key)
+#define TEST_HEAP_ITEM_MOVED(ITEM, INDEX) ((ITEM)->index = (INDEX))
+
+char *test_heap_push_pop()
+{
+	static const int keys[] = { 5, 3, 9, 1, 7, 3, 8, 2 };
+	int i, last = 0;
+
+	MHEAP_DEFINE_STRUCT(int, 8) heap;
+
+	MHEAP_INITIALISE(&heap);
+
+	MUNT_ASSERT(MHEAP_IS_EMPTY(&heap));
+	MUNT_ASSERT(MHEAP_CAPACITY(&heap) == 8);
+
+	for (i = 0; i < 8; i++) {
+		MUNT_ASSERT(!MHEAP_IS_FULL(&heap));
+		MHEAP_PUSH(&heap, keys[i], TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+	}
+
+	MUNT_ASSERT(MHEAP_IS_FULL(&heap));
+	MHEAP_PUSH(&heap, 0, TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+	MUNT_ASSERT(MHEAP_COUNT(&heap) == 8);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == 1);
+
+	for (i = 0; i < 8; i++) {
+		MUNT_ASSERT(MHEAP_PEEK(&heap) >= last);
+		last = MHEAP_PEEK(&heap);
+		MHEAP_POP(&heap, TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+	}
+
+	MUNT_ASSERT(last == 9);
+	MUNT_ASSERT(MHEAP_IS_EMPTY(&heap));
+
+	/* does nothing if empty */
+	MHEAP_POP(&heap, TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+	MUNT_ASSERT(MHEAP_IS_EMPTY(&heap));
+
+	return 0;
+}
+
+char *test_heap_update_remove()
+{
+	test_heap_item_t items[6];
+	test_heap_item_t *buffer[6];
+	int i;
+
+	MHEAP_DEFINE_BUFFER_STRUCT(test_heap_item_t*) heap;
+
+	MHEAP_INITIALISE_BUFFER(&heap, buffer, 6);
+
+	for (i = 0; i < 6; i++) {
+		items[i].key = 10 * (i + 1);
+		MHEAP_PUSH(&heap, items + i, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	}
+
+	for (i = 0; i < 6; i++)
+		MUNT_ASSERT(MHEAP_AT(&heap, items[i].index) == items + i);
+
+	/* decrease key */
+	items[5].key = 5;
+	MHEAP_DECREASE_KEY(&heap, items[5].index, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items + 5);
+
+	/* increase key */
+	items[5].key = 100;
+	MHEAP_UPDATE(&heap, items[5].index, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items);
+
+	MHEAP_REMOVE(&heap, items[1].index, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_COUNT(&heap) == 5);
+
+	for (i = 0; i < 6; i++) {
+		if (i == 1) continue;
+		MUNT_ASSERT(MHEAP_AT(&heap, items[i].index) == items + i);
+	}
+
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items);
+	MHEAP_POP(&heap, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items + 2);
+	MHEAP_POP(&heap, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items + 3);
+	MHEAP_POP(&heap, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items + 4);
+	MHEAP_POP(&heap, TEST_HEAP_ITEM_LESS, TEST_HEAP_ITEM_MOVED);
+	MUNT_ASSERT(MHEAP_PEEK(&heap) == items + 5);
+
+	return 0;
+}
+
+char *test_heap_random()
+{
+	unsigned long state = 1;
+	int i, last = -1;
+
+	MHEAP_DEFINE_STRUCT(int, 1000) heap;
+
+	MHEAP_INITIALISE(&heap);
+
+	for (i = 0; i < 1000; i++) {
+		state = state * 1103515245 + 12345;
+		MHEAP_PUSH(&heap, (int) ((state >> 16) % 10000), TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+	}
+
+	/* remove some from the middle */
+	for (i = 0; i < 100; i++)
+		MHEAP_REMOVE(&heap, (size_t) (7 * i), TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+
+	MUNT_ASSERT(MHEAP_COUNT(&heap) == 900);
+
+	while (!MHEAP_IS_EMPTY(&heap)) {
+		MUNT_ASSERT(MHEAP_PEEK(&heap) >= last);
+		last = MHEAP_PEEK(&heap);
+		MHEAP_POP(&heap, TEST_HEAP_LESS, MHEAP_NOT_MOVED);
+	}
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/histogram.h"
+#include "mbb/debug.h"
+
+char *test_histogram_small_values()
+{
+	mhst_histogram_t h;
+	uint64_t i;
+
+	mhst_reset(&h);
+	MUNT_ASSERT(mhst_quantile(&h, 500) == 0);
+
+	/* values below 2^MHST_SUB_BUCKET_BITS have buckets of their own */
+	for (i = 0; i < (1u << MHST_SUB_BUCKET_BITS); i++)
+		mhst_record(&h, i);
+
+	MUNT_ASSERT(mhst_count(&h) == (1u << MHST_SUB_BUCKET_BITS));
+	MUNT_ASSERT(mhst_quantile(&h, 0) == 0);
+	MUNT_ASSERT(mhst_quantile(&h, 500) == (1u << MHST_SUB_BUCKET_BITS) / 2 - 1);
+	MUNT_ASSERT(mhst_quantile(&h, 1000) == (1u << MHST_SUB_BUCKET_BITS) - 1);
+
+	return 0;
+}
+
+char *test_histogram_quantiles()
+{
+	mhst_histogram_t h, other;
+	uint64_t i, q;
+
+	mhst_reset(&h);
+	for (i = 1; i <= 100000; i++)
+		mhst_record(&h, i * 10);
+
+	/* quantiles are upper bounds with a bounded relative error */
+	q = mhst_quantile(&h, 500);
+	MUNT_ASSERT(q >= 500000 && q <= 500000 + 500000 / (1u << MHST_SUB_BUCKET_BITS));
+	q = mhst_quantile(&h, 990);
+	MUNT_ASSERT(q >= 990000 && q <= 990000 + 990000 / (1u << MHST_SUB_BUCKET_BITS));
+	q = mhst_quantile(&h, 999);
+	MUNT_ASSERT(q >= 999000 && q <= 1000000);
+	MUNT_ASSERT(mhst_quantile(&h, 1000) == 1000000);
+	MUNT_ASSERT(mhst_max(&h) == 1000000);
+
+	/* values too large are counted in the last bucket */
+	mhst_reset(&other);
+	mhst_record(&other, ((uint64_t) 1) << 40);
+	mhst_merge(&h, &other);
+	MUNT_ASSERT(mhst_count(&h) == 100001);
+	MUNT_ASSERT(mhst_quantile(&h, 1000) == (((uint64_t) 1) << MHST_VALUE_BITS) - 1);
+	MUNT_ASSERT(mhst_max(&h) == ((uint64_t) 1) << 40);
+
+	return 0;
+}
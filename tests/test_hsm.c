@@ -152,3 +152,224 @@ char *test_transition_events()
 
 	return 0;
 }
+
+enum {
+	TEST_PR_EVENT_HANDLED = MHSM_EVENT_CUSTOM,
+	TEST_PR_EVENT_UNHANDLED,
+	TEST_PR_EVENT_TRIGGER
+};
+
+MHSM_DEFINE_STATE(test_pr_top, NULL);
+MHSM_DEFINE_STATE(test_pr_a, &test_pr_top);
+MHSM_DEFINE_STATE(test_pr_a1, &test_pr_a);
+MHSM_DEFINE_STATE(test_pr_b, &test_pr_top);
+
+mhsm_state_t *test_pr_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	TEST_ENQUEUE(&test_pr_top, event.id);
+
+	switch (event.id) {
+		case TEST_PR_EVENT_TRIGGER:
+			/* overridden by test_pr_a1 */
+			return &test_pr_a;
+	}
+
+	return &test_pr_top;
+}
+
+mhsm_state_t *test_pr_a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	TEST_ENQUEUE(&test_pr_a, event.id);
+
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_pr_a1;
+		case TEST_PR_EVENT_UNHANDLED:
+			return MHSM_HANDLED;
+	}
+
+	return &test_pr_a;
+}
+
+mhsm_state_t *test_pr_a1_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	TEST_ENQUEUE(&test_pr_a1, event.id);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			return MHSM_HANDLED;
+		case TEST_PR_EVENT_HANDLED:
+			return MHSM_HANDLED;
+		case TEST_PR_EVENT_TRIGGER:
+			return &test_pr_b;
+	}
+
+	return &test_pr_a1;
+}
+
+mhsm_state_t *test_pr_b_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	TEST_ENQUEUE(&test_pr_b, event.id);
+
+	return &test_pr_b;
+}
+
+static int test_pr_count_dispatches(uint32_t event_id)
+{
+	int count = 0;
+
+	while (MQUE_LENGTH(&test_event_queue)) {
+		if (MQUE_HEAD(&test_event_queue).event_id == event_id)
+			count++;
+		MQUE_DEQUEUE(&test_event_queue);
+	}
+
+	return count;
+}
+
+char *test_propagation_greedy()
+{
+	mhsm_hsm_t hsm;
+
+	mhsm_initialise(&hsm, NULL, &test_pr_a);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_a1);
+
+	MQUE_INITIALISE(&test_event_queue);
+	mhsm_dispatch_event(&hsm, TEST_PR_EVENT_HANDLED);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_PR_EVENT_HANDLED) == 3);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_a1);
+
+	mhsm_dispatch_event(&hsm, TEST_PR_EVENT_UNHANDLED);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_PR_EVENT_UNHANDLED) == 3);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_a1);
+
+	mhsm_dispatch_event(&hsm, TEST_PR_EVENT_TRIGGER);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_PR_EVENT_TRIGGER) == 3);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_b);
+
+	return 0;
+}
+
+char *test_propagation_consume()
+{
+	mhsm_hsm_t hsm;
+
+	mhsm_initialise(&hsm, NULL, &test_pr_a);
+	mhsm_set_propagation(&hsm, MHSM_PROPAGATION_CONSUME);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_a1);
+
+	MQUE_INITIALISE(&test_event_queue);
+	mhsm_dispatch_event(&hsm, TEST_PR_EVENT_HANDLED);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_PR_EVENT_HANDLED) == 1);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_a1);
+
+	mhsm_dispatch_event(&hsm, TEST_PR_EVENT_UNHANDLED);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_PR_EVENT_UNHANDLED) == 2);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_a1);
+
+	mhsm_dispatch_event(&hsm, TEST_PR_EVENT_TRIGGER);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_PR_EVENT_TRIGGER) == 1);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pr_b);
+
+	return 0;
+}
+
+enum {
+	TEST_DF_EVENT_DEFERRED = MHSM_EVENT_CUSTOM,
+	TEST_DF_EVENT_OTHER,
+	TEST_DF_EVENT_GO
+};
+
+MHSM_DEFINE_STATE(test_df_a, NULL);
+MHSM_DEFINE_STATE(test_df_b, NULL);
+MHSM_DEFINE_STATE(test_df_c, NULL);
+
+mhsm_state_t *test_df_a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	TEST_ENQUEUE(&test_df_a, event.id);
+
+	switch (event.id) {
+		case TEST_DF_EVENT_DEFERRED:
+			return NULL;
+		case TEST_DF_EVENT_GO:
+			return &test_df_b;
+	}
+
+	return &test_df_a;
+}
+
+mhsm_state_t *test_df_b_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_DF_EVENT_DEFERRED:
+			return &test_df_c;
+	}
+
+	return &test_df_b;
+}
+
+mhsm_state_t *test_df_c_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_df_c;
+}
+
+char *test_deferred_events()
+{
+	mhsm_hsm_t hsm;
+
+	mhsm_initialise(&hsm, NULL, &test_df_a);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	MQUE_INITIALISE(&test_event_queue);
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_DF_EVENT_DEFERRED) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_df_a);
+
+	/* the deferred event is dispatched once more along with the next event */
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_DF_EVENT_OTHER) == 0);
+	MUNT_ASSERT(test_pr_count_dispatches(TEST_DF_EVENT_DEFERRED) == 2);
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_DF_EVENT_GO) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_df_c);
+
+	return 0;
+}
+
+MHSM_DEFINE_STATE(test_ch_a, NULL);
+MHSM_DEFINE_STATE(test_ch_b, NULL);
+
+mhsm_state_t *test_ch_a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			return &test_ch_b;
+	}
+
+	return &test_ch_a;
+}
+
+mhsm_state_t *test_ch_b_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			return &test_ch_a;
+	}
+
+	return &test_ch_b;
+}
+
+char *test_transition_chain_limit()
+{
+	mhsm_hsm_t hsm;
+
+	mhsm_initialise(&hsm, NULL, &test_ch_a);
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL) == -1);
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_ch_a) || mhsm_is_in(&hsm, &test_ch_b));
+	MUNT_ASSERT(!hsm.in_transition);
+
+	return 0;
+}
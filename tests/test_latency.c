@@ -0,0 +1,155 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+#include "mbb/latency.h"
+#include "mbb/clock.h"
+#include "mbb/debug.h"
+
+/* only built if configured with --enable-latency */
+
+enum {
+	TEST_LA_EVENT_FAST = MHSM_EVENT_CUSTOM,
+	TEST_LA_EVENT_SLOW,
+	TEST_LA_EVENT_LATER,
+	TEST_LA_EVENT_READY,
+	TEST_LA_NROF_EVENTS
+};
+
+static void test_la_spin(uint64_t duration)
+{
+	uint64_t start = MCLK_NOW();
+
+	while (MCLK_NOW() - start < duration)
+		;
+}
+
+MHSM_DEFINE_STATE(test_la_state, NULL);
+MHSM_DEFINE_STATE(test_la_ready, NULL);
+
+mhsm_state_t *test_la_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_LA_EVENT_SLOW:
+			test_la_spin(100000);
+			break;
+		case TEST_LA_EVENT_LATER:
+			return NULL;
+		case TEST_LA_EVENT_READY:
+			return &test_la_ready;
+	}
+
+	return &test_la_state;
+}
+
+mhsm_state_t *test_la_ready_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_la_ready;
+}
+
+char *test_latency()
+{
+	mhsm_latency_entry_t entries[8];
+	mhsm_latency_t latency;
+	mhsm_hsm_t hsm;
+	mhst_histogram_t *fast, *slow;
+	int i;
+
+	MUNT_ASSERT(mhsm_latency_initialise(&latency, entries, 6) == -1);
+	MUNT_ASSERT(mhsm_latency_initialise(&latency, entries, 8) == 0);
+
+	mhsm_initialise(&hsm, NULL, &test_la_state);
+	mhsm_set_latency(&hsm, &latency);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	for (i = 0; i < 10; i++) {
+		mhsm_dispatch_event(&hsm, TEST_LA_EVENT_FAST);
+		mhsm_dispatch_event(&hsm, TEST_LA_EVENT_SLOW);
+	}
+
+	fast = mhsm_latency_histogram(&latency, &test_la_state, TEST_LA_EVENT_FAST);
+	slow = mhsm_latency_histogram(&latency, &test_la_state, TEST_LA_EVENT_SLOW);
+	MUNT_ASSERT(fast != NULL && slow != NULL);
+	MUNT_ASSERT(mhst_count(fast) == 10 && mhst_count(slow) == 10);
+	MUNT_ASSERT(mhst_quantile(slow, 500) >= 100000);
+	MUNT_ASSERT(mhst_quantile(fast, 999) < mhst_quantile(slow, 500));
+
+	/* ENTRY and INITIAL are timed as well */
+	MUNT_ASSERT(mhsm_latency_histogram(&latency, &test_la_state, MHSM_EVENT_INITIAL) != NULL);
+	MUNT_ASSERT(mhsm_latency_histogram(&latency, &test_la_state, MHSM_EVENT_ENTRY) != NULL);
+	MUNT_ASSERT(mhst_count(&latency.overflow) == 0);
+
+	/* a table of two entries holds a single pair */
+	MUNT_ASSERT(mhsm_latency_initialise(&latency, entries, 2) == 0);
+	mhsm_dispatch_event(&hsm, TEST_LA_EVENT_FAST);
+	mhsm_dispatch_event(&hsm, TEST_LA_EVENT_SLOW);
+	mhsm_dispatch_event(&hsm, TEST_LA_EVENT_FAST);
+	MUNT_ASSERT(mhst_count(mhsm_latency_histogram(&latency, &test_la_state, TEST_LA_EVENT_FAST)) == 2);
+	MUNT_ASSERT(mhsm_latency_histogram(&latency, &test_la_state, TEST_LA_EVENT_SLOW) == NULL);
+	MUNT_ASSERT(mhst_count(&latency.overflow) == 1);
+
+	mhsm_latency_reset(&latency);
+	MUNT_ASSERT(mhsm_latency_histogram(&latency, &test_la_state, TEST_LA_EVENT_FAST) == NULL);
+
+	return 0;
+}
+
+char *test_queueing_delay()
+{
+	mhsm_latency_entry_t entries[8];
+	mhst_histogram_t delays[TEST_LA_NROF_EVENTS];
+	mhsm_latency_t latency;
+	mhsm_hsm_t hsm;
+	mhst_histogram_t *later, *fast;
+
+	mhsm_latency_initialise(&latency, entries, 8);
+	mhsm_latency_set_delays(&latency, delays, TEST_LA_NROF_EVENTS);
+
+	mhsm_initialise(&hsm, NULL, &test_la_state);
+	mhsm_set_latency(&hsm, &latency);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	/* deferred twice, the delay counts from the first deferral */
+	mhsm_dispatch_event(&hsm, TEST_LA_EVENT_LATER);
+	test_la_spin(50000);
+	mhsm_dispatch_event(&hsm, TEST_LA_EVENT_FAST);
+	test_la_spin(50000);
+	mhsm_dispatch_event(&hsm, TEST_LA_EVENT_READY);
+
+	later = mhsm_latency_delay_histogram(&latency, TEST_LA_EVENT_LATER);
+	MUNT_ASSERT(mhst_count(later) == 1);
+	MUNT_ASSERT(mhst_max(later) >= 100000);
+
+	/* events dispatched directly are not queued */
+	MUNT_ASSERT(mhst_count(mhsm_latency_delay_histogram(&latency, TEST_LA_EVENT_READY)) == 0);
+
+	/* events queued by the application */
+	mhsm_dispatch_posted_event(&hsm, TEST_LA_EVENT_FAST, 0, MCLK_NOW() - 30000);
+	fast = mhsm_latency_delay_histogram(&latency, TEST_LA_EVENT_FAST);
+	MUNT_ASSERT(mhst_count(fast) == 1);
+	MUNT_ASSERT(mhst_max(fast) >= 30000);
+
+	MUNT_ASSERT(mhsm_latency_delay_histogram(&latency, TEST_LA_NROF_EVENTS) == NULL);
+	mhsm_dispatch_posted_event(&hsm, TEST_LA_NROF_EVENTS, 0, MCLK_NOW());
+	MUNT_ASSERT(mhst_count(&latency.delay_overflow) == 1);
+
+	return 0;
+}
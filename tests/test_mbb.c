@@ -0,0 +1,96 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#define MBB_IMPLEMENTATION
+#define MBB_STATIC
+#include "mbb/mbb.h"
+#include "mbb/test.h"
+
+enum {
+	TEST_EVENT_TIMEOUT = MHSM_EVENT_CUSTOM,
+	TEST_EVENT_START
+};
+
+typedef struct {
+	mtmr_prd_t timers[MTMR_NROF_TIMERS(TEST_EVENT_TIMEOUT)];
+	int entries;
+} test_context_t;
+
+MHSM_DEFINE_STATE(test_top, NULL);
+MHSM_DEFINE_STATE(test_idle, &test_top);
+MHSM_DEFINE_STATE(test_busy, &test_top);
+
+mhsm_state_t *test_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_idle;
+	}
+
+	return &test_top;
+}
+
+mhsm_state_t *test_idle_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_EVENT_START:
+			return &test_busy;
+	}
+
+	return &test_idle;
+}
+
+mhsm_state_t *test_busy_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_context_t *context = mhsm_context(hsm);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			context->entries++;
+			mhsm_start_timer(hsm, TEST_EVENT_TIMEOUT, 100);
+			return MHSM_HANDLED;
+		case TEST_EVENT_TIMEOUT:
+			return &test_idle;
+	}
+
+	return &test_busy;
+}
+
+char *test_header_only()
+{
+	test_context_t context = { { { 0 } }, 0 };
+	mhsm_hsm_t hsm;
+
+	mhsm_initialise(&hsm, &context, &test_top);
+	MUNT_ASSERT(mtmr_prd_initialise_timers(&hsm, MTMR_NROF_TIMERS(TEST_EVENT_TIMEOUT)) == 0);
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_idle);
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_EVENT_START) == 0);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_busy);
+	MUNT_ASSERT(context.entries == 1);
+
+	mtmr_prd_increment_timers(&hsm, MTMR_NROF_TIMERS(TEST_EVENT_TIMEOUT), 99);
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_busy));
+	mtmr_prd_increment_timers(&hsm, MTMR_NROF_TIMERS(TEST_EVENT_TIMEOUT), 1);
+	MUNT_ASSERT(mhsm_is_in(&hsm, &test_idle));
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/metrics.h"
+#include "mbb/timer_periodic.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define TEST_ME_NROF_TIMERS 2
+
+typedef struct {
+	mtmr_prd_t timers[TEST_ME_NROF_TIMERS];
+} test_me_context_t;
+
+MHSM_DEFINE_STATE(test_me_state, NULL);
+
+mhsm_state_t *test_me_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			mhsm_start_timer(hsm, MHSM_EVENT_CUSTOM, 1000);
+			break;
+	}
+
+	return &test_me_state;
+}
+
+static void test_me_publish(mhsm_metrics_source_t *sources)
+{
+	mhsm_metrics_sample_t sample;
+	test_me_context_t contexts[3];
+	mhsm_hsm_t hsms[3];
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		mhsm_initialise(hsms + i, contexts + i, &test_me_state);
+		mtmr_prd_initialise_timers(hsms + i, TEST_ME_NROF_TIMERS);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+	}
+
+	/* two HSMs dispatched by one thread, one by another */
+	mhsm_metrics_reset_sample(&sample);
+	mhsm_metrics_add_hsm(&sample, hsms, TEST_ME_NROF_TIMERS);
+	mhsm_metrics_add_hsm(&sample, hsms + 1, TEST_ME_NROF_TIMERS);
+	mhsm_metrics_publish(sources, &sample);
+
+	mhsm_metrics_reset_sample(&sample);
+	mhsm_metrics_add_hsm(&sample, hsms + 2, TEST_ME_NROF_TIMERS);
+	mhsm_metrics_publish(sources + 1, &sample);
+}
+
+char *test_metrics_format()
+{
+	mhsm_metrics_source_t sources[2];
+	mhsm_metrics_exporter_t exporter;
+	char buffer[MHSM_METRICS_BUFFER_SIZE];
+	FILE *file;
+	size_t n;
+
+	mhsm_metrics_initialise_source(sources);
+	mhsm_metrics_initialise_source(sources + 1);
+	mhsm_metrics_initialise_exporter(&exporter, sources, 2);
+	test_me_publish(sources);
+
+	mhsm_metrics_collect(&exporter);
+	MUNT_ASSERT(exporter.total.nrof_hsms == 3);
+	MUNT_ASSERT(exporter.total.nrof_active_timers == 3);
+
+	MUNT_ASSERT(mhsm_metrics_format(&exporter, buffer, 16) == -1);
+	MUNT_ASSERT(mhsm_metrics_format(&exporter, buffer, sizeof(buffer)) > 0);
+	MUNT_ASSERT(strstr(buffer, "# TYPE mhsm_hsms gauge\nmhsm_hsms 3\n") != NULL);
+	MUNT_ASSERT(strstr(buffer, "\nmhsm_active_timers 3\n") != NULL);
+
+	MUNT_ASSERT(mhsm_metrics_write_file(&exporter, "test_metrics.prom") == 0);
+	file = fopen("test_metrics.prom", "r");
+	MUNT_ASSERT(file != NULL);
+	n = fread(buffer, 1, sizeof(buffer) - 1, file);
+	fclose(file);
+	remove("test_metrics.prom");
+	buffer[n] = '\0';
+	MUNT_ASSERT(strstr(buffer, "\nmhsm_hsms 3\n") != NULL);
+
+	return 0;
+}
+
+char *test_metrics_socket()
+{
+	mhsm_metrics_source_t sources[2];
+	mhsm_metrics_exporter_t exporter;
+	struct sockaddr_un address;
+	char buffer[MHSM_METRICS_BUFFER_SIZE];
+	ssize_t n;
+	int listen_fd, fd;
+
+	mhsm_metrics_initialise_source(sources);
+	mhsm_metrics_initialise_source(sources + 1);
+	mhsm_metrics_initialise_exporter(&exporter, sources, 2);
+	test_me_publish(sources);
+	mhsm_metrics_collect(&exporter);
+
+	listen_fd = mhsm_metrics_listen("test_metrics.sock");
+	MUNT_ASSERT(listen_fd >= 0);
+	MUNT_ASSERT(mhsm_metrics_serve(&exporter, listen_fd) == 0);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, "test_metrics.sock");
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	MUNT_ASSERT(connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0);
+
+	MUNT_ASSERT(mhsm_metrics_serve(&exporter, listen_fd) == 1);
+	n = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	close(listen_fd);
+	unlink("test_metrics.sock");
+
+	MUNT_ASSERT(n > 0);
+	buffer[n] = '\0';
+	MUNT_ASSERT(strstr(buffer, "\nmhsm_hsms 3\n") != NULL);
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/mpmc.h"
+#include "mbb/debug.h"
+
+char *test_mpmc_enqueue_dequeue()
+{
+	int i, head;
+	bool ok;
+
+	MMPMC_DEFINE_STRUCT(int, 5) queue;
+
+	MMPMC_INITIALISE(&queue);
+
+	MMPMC_TRY_DEQUEUE(&queue, head, ok);
+	MUNT_ASSERT(!ok);
+
+	for (i = 1; i <= 5; i++) {
+		MMPMC_TRY_ENQUEUE(&queue, i, ok);
+		MUNT_ASSERT(ok);
+	}
+
+	MUNT_ASSERT(MMPMC_LENGTH(&queue) == 5);
+
+	MMPMC_TRY_ENQUEUE(&queue, 6, ok);
+	MUNT_ASSERT(!ok);
+	MUNT_ASSERT(MMPMC_LENGTH(&queue) == 5);
+
+	for (i = 1; i <= 5; i++) {
+		MMPMC_TRY_DEQUEUE(&queue, head, ok);
+		MUNT_ASSERT(ok);
+		MUNT_ASSERT(head == i);
+	}
+
+	MMPMC_TRY_DEQUEUE(&queue, head, ok);
+	MUNT_ASSERT(!ok);
+	MUNT_ASSERT(MMPMC_LENGTH(&queue) == 0);
+
+	return 0;
+}
+
+char *test_mpmc_wrap_around()
+{
+	int i, head, expected = 0;
+	bool ok;
+
+	MMPMC_DEFINE_STRUCT(int, 4) queue;
+
+	MMPMC_INITIALISE(&queue);
+
+	for (i = 0; i < 1000; i++) {
+		MMPMC_TRY_ENQUEUE(&queue, i, ok);
+		MUNT_ASSERT(ok);
+
+		if (i % 3 == 2) {
+			for (;;) {
+				MMPMC_TRY_DEQUEUE(&queue, head, ok);
+				if (!ok) break;
+				MUNT_ASSERT(head == expected);
+				expected++;
+			}
+		}
+	}
+
+	MUNT_ASSERT(MMPMC_LENGTH(&queue) == 1);
+	MUNT_ASSERT(expected == 999);
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/pool.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+typedef struct {
+	mhsm_hsm_t hsm;
+	int value;
+} test_pool_machine_t;
+
+char *test_pool_alloc_free()
+{
+	test_pool_machine_t *machines[4], *machine;
+	int i;
+
+	MPOOL_DEFINE_STRUCT(test_pool_machine_t, 4) pool;
+
+	MPOOL_INITIALISE(&pool);
+
+	MUNT_ASSERT(MPOOL_CAPACITY(&pool) == 4);
+	MUNT_ASSERT(MPOOL_COUNT(&pool) == 0);
+
+	for (i = 0; i < 4; i++) {
+		MUNT_ASSERT(!MPOOL_IS_EXHAUSTED(&pool));
+		MPOOL_ALLOC(&pool, machines[i]);
+		MUNT_ASSERT(machines[i] != NULL);
+		MUNT_ASSERT(MPOOL_INDEX(&pool, machines[i]) == (size_t) i);
+		machines[i]->value = i;
+	}
+
+	MUNT_ASSERT(MPOOL_IS_EXHAUSTED(&pool));
+	MPOOL_ALLOC(&pool, machine);
+	MUNT_ASSERT(machine == NULL);
+
+	MPOOL_FREE(&pool, machines[1]);
+	MPOOL_FREE(&pool, machines[3]);
+	MUNT_ASSERT(MPOOL_COUNT(&pool) == 2);
+
+	/* the most recently freed element is reused first */
+	MPOOL_ALLOC(&pool, machine);
+	MUNT_ASSERT(machine == machines[3]);
+	MPOOL_ALLOC(&pool, machine);
+	MUNT_ASSERT(machine == machines[1]);
+	MPOOL_ALLOC(&pool, machine);
+	MUNT_ASSERT(machine == NULL);
+
+	/* allocated elements are left alone */
+	MUNT_ASSERT(machines[0]->value == 0);
+	MUNT_ASSERT(machines[2]->value == 2);
+
+	return 0;
+}
+
+char *test_pool_aligned()
+{
+	char *first, *second;
+
+	static MPOOL_DEFINE_ALIGNED_STRUCT(char, 3) pool = MPOOL_INITIALISER;
+
+	MPOOL_ALLOC(&pool, first);
+	MPOOL_ALLOC(&pool, second);
+
+	MUNT_ASSERT((size_t) first % MPOOL_CACHE_LINE == 0);
+	MUNT_ASSERT((size_t) second % MPOOL_CACHE_LINE == 0);
+	MUNT_ASSERT(second - first == MPOOL_CACHE_LINE);
+
+	return 0;
+}
+
+char *test_pool_cache()
+{
+	int *elements[8], *element;
+	int i;
+
+	static MPOOL_DEFINE_STRUCT(int, 8) pool = MPOOL_INITIALISER;
+	MPOOL_DEFINE_CACHE_STRUCT(4) cache = MPOOL_CACHE_INITIALISER;
+
+	/* refills take half the cache's size */
+	MPOOL_CACHED_ALLOC(&pool, &cache, elements[0]);
+	MUNT_ASSERT(elements[0] != NULL);
+	MUNT_ASSERT(MPOOL_COUNT(&pool) == 2);
+	MUNT_ASSERT(cache.count == 1);
+
+	for (i = 1; i < 8; i++) {
+		MPOOL_CACHED_ALLOC(&pool, &cache, elements[i]);
+		MUNT_ASSERT(elements[i] != NULL);
+	}
+
+	MUNT_ASSERT(MPOOL_IS_EXHAUSTED(&pool));
+	MPOOL_CACHED_ALLOC(&pool, &cache, element);
+	MUNT_ASSERT(element == NULL);
+
+	/* a full cache returns half of its elements */
+	for (i = 0; i < 5; i++)
+		MPOOL_CACHED_FREE(&pool, &cache, elements[i]);
+	MUNT_ASSERT(cache.count == 3);
+	MUNT_ASSERT(MPOOL_COUNT(&pool) == 6);
+
+	MPOOL_CACHED_ALLOC(&pool, &cache, element);
+	MUNT_ASSERT(element == elements[4]);
+
+	MPOOL_CACHE_FLUSH(&pool, &cache);
+	MUNT_ASSERT(cache.count == 0);
+	MUNT_ASSERT(MPOOL_COUNT(&pool) == 4);
+
+	return 0;
+}
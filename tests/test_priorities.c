@@ -0,0 +1,203 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+#include "mbb/snapshot.h"
+#include "mbb/debug.h"
+
+/* 
+ * only built if configured with --with-priority-levels, assumes
+ * MHSM_PRIORITY_BURST < MHSM_EVENT_QUEUE_LENGTH
+ */
+
+#define TEST_PR_HIGH (MHSM_PRIORITY_LEVELS - 1)
+#define TEST_PR_LOG_LENGTH 16
+
+enum {
+	TEST_PR_EVENT_BURST = MHSM_EVENT_CUSTOM,
+	TEST_PR_EVENT_FLOOD,
+	TEST_PR_EVENT_LOW,
+	TEST_PR_EVENT_HIGH,
+	TEST_PR_EVENT_GO
+};
+
+typedef struct {
+	uint32_t log[TEST_PR_LOG_LENGTH];
+	int nrof_logged;
+	int nrof_dropped;
+} test_pr_context_t;
+
+MHSM_DEFINE_STATE(test_pr_running, NULL);
+MHSM_DEFINE_STATE(test_pr_waiting, NULL);
+
+static mhsm_state_t *test_pr_states[] = { &test_pr_running, &test_pr_waiting };
+
+static void test_pr_post(mhsm_hsm_t *hsm, uint32_t id, uint8_t priority)
+{
+	test_pr_context_t *ctx = (test_pr_context_t*) mhsm_context(hsm);
+
+	if (mhsm_dispatch_event_prio(hsm, id, ctx->nrof_logged, priority) != 0)
+		ctx->nrof_dropped++;
+}
+
+mhsm_state_t *test_pr_running_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_pr_context_t *ctx = (test_pr_context_t*) mhsm_context(hsm);
+	int i;
+
+	switch (event.id) {
+		case TEST_PR_EVENT_BURST:
+			/* queued, since the HSM is busy */
+			test_pr_post(hsm, TEST_PR_EVENT_LOW, 0);
+			for (i = 0; i <= MHSM_PRIORITY_BURST; i++)
+				test_pr_post(hsm, TEST_PR_EVENT_HIGH, TEST_PR_HIGH);
+			break;
+		case TEST_PR_EVENT_FLOOD:
+			for (i = 0; i <= MHSM_EVENT_QUEUE_LENGTH; i++)
+				test_pr_post(hsm, TEST_PR_EVENT_LOW, 0);
+			test_pr_post(hsm, TEST_PR_EVENT_HIGH, TEST_PR_HIGH);
+			break;
+		case TEST_PR_EVENT_LOW:
+		case TEST_PR_EVENT_HIGH:
+			if (ctx->nrof_logged < TEST_PR_LOG_LENGTH)
+				ctx->log[ctx->nrof_logged++] = event.id;
+			break;
+	}
+
+	return &test_pr_running;
+}
+
+mhsm_state_t *test_pr_waiting_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_PR_EVENT_LOW:
+		case TEST_PR_EVENT_HIGH:
+			return NULL;
+		case TEST_PR_EVENT_GO:
+			return &test_pr_running;
+	}
+
+	return &test_pr_waiting;
+}
+
+static void test_pr_initialise(mhsm_hsm_t *hsm, test_pr_context_t *ctx, mhsm_state_t *state)
+{
+	ctx->nrof_logged = 0;
+	ctx->nrof_dropped = 0;
+	mhsm_initialise(hsm, ctx, state);
+	mhsm_dispatch_event(hsm, MHSM_EVENT_INITIAL);
+}
+
+char *test_priorities_burst()
+{
+	test_pr_context_t ctx;
+	mhsm_hsm_t hsm;
+	int i;
+
+	test_pr_initialise(&hsm, &ctx, &test_pr_running);
+
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_PR_EVENT_BURST) == 0);
+	MUNT_ASSERT(ctx.nrof_dropped == 0);
+	MUNT_ASSERT(ctx.nrof_logged == MHSM_PRIORITY_BURST + 2);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 0);
+
+	/* the low priority event gets its turn after a burst of high ones */
+	for (i = 0; i < MHSM_PRIORITY_BURST; i++)
+		MUNT_ASSERT(ctx.log[i] == TEST_PR_EVENT_HIGH);
+	MUNT_ASSERT(ctx.log[MHSM_PRIORITY_BURST] == TEST_PR_EVENT_LOW);
+	MUNT_ASSERT(ctx.log[MHSM_PRIORITY_BURST + 1] == TEST_PR_EVENT_HIGH);
+
+	return 0;
+}
+
+char *test_priorities_separate_queues()
+{
+	test_pr_context_t ctx;
+	mhsm_hsm_t hsm;
+
+	test_pr_initialise(&hsm, &ctx, &test_pr_running);
+
+	/* a full queue of low priority events does not drop high ones */
+	MUNT_ASSERT(mhsm_dispatch_event(&hsm, TEST_PR_EVENT_FLOOD) == 0);
+	MUNT_ASSERT(ctx.nrof_dropped == 1);
+	MUNT_ASSERT(ctx.nrof_logged == MHSM_EVENT_QUEUE_LENGTH + 1);
+	MUNT_ASSERT(ctx.log[0] == TEST_PR_EVENT_HIGH);
+
+	return 0;
+}
+
+char *test_priorities_snapshot()
+{
+	test_pr_context_t ctx, restored_ctx;
+	mhsm_hsm_t hsm, restored;
+	uint8_t buffer[64];
+	int length;
+
+	test_pr_initialise(&hsm, &ctx, &test_pr_waiting);
+
+	/* deferred events stay in the queue of their priority */
+	test_pr_post(&hsm, TEST_PR_EVENT_LOW, 0);
+	test_pr_post(&hsm, TEST_PR_EVENT_HIGH, TEST_PR_HIGH);
+	MUNT_ASSERT(mhsm_queue_length(&hsm) == 2);
+
+	length = mhsm_snapshot_save(&hsm, test_pr_states, 2, 0, buffer, sizeof(buffer));
+	MUNT_ASSERT(length > 0);
+
+	test_pr_initialise(&restored, &restored_ctx, &test_pr_running);
+	MUNT_ASSERT(mhsm_snapshot_restore(&restored, test_pr_states, 2, 0, buffer, length) == length);
+	MUNT_ASSERT(mhsm_current_state(&restored) == &test_pr_waiting);
+	MUNT_ASSERT(MQUE_LENGTH(mhsm_deferred_events(&restored)) == 1);
+	MUNT_ASSERT(MQUE_LENGTH(&restored.priority_events[TEST_PR_HIGH - 1]) == 1);
+
+	MUNT_ASSERT(mhsm_dispatch_event(&restored, TEST_PR_EVENT_GO) == 0);
+	MUNT_ASSERT(restored_ctx.nrof_logged == 2);
+	MUNT_ASSERT(restored_ctx.log[0] == TEST_PR_EVENT_HIGH);
+	MUNT_ASSERT(restored_ctx.log[1] == TEST_PR_EVENT_LOW);
+
+	return 0;
+}
+
+char *test_priorities_bounded_drain()
+{
+	test_pr_context_t ctx;
+	mhsm_budget_t budget = { 1, 0, NULL };
+	mhsm_hsm_t hsm;
+	int i;
+
+	test_pr_initialise(&hsm, &ctx, &test_pr_running);
+
+	MUNT_ASSERT(mhsm_dispatch_event_budget(&hsm, TEST_PR_EVENT_BURST, 0, &budget) == 1);
+	MUNT_ASSERT(ctx.nrof_logged == 0);
+
+	/* one event per call, the burst limit holds across calls */
+	for (i = 0; i < MHSM_PRIORITY_BURST + 2; i++) {
+		budget.events = 1;
+		MUNT_ASSERT(mhsm_drain(&hsm, &budget) == (i < MHSM_PRIORITY_BURST + 1));
+	}
+
+	MUNT_ASSERT(ctx.nrof_logged == MHSM_PRIORITY_BURST + 2);
+	for (i = 0; i < MHSM_PRIORITY_BURST; i++)
+		MUNT_ASSERT(ctx.log[i] == TEST_PR_EVENT_HIGH);
+	MUNT_ASSERT(ctx.log[MHSM_PRIORITY_BURST] == TEST_PR_EVENT_LOW);
+	MUNT_ASSERT(ctx.log[MHSM_PRIORITY_BURST + 1] == TEST_PR_EVENT_HIGH);
+
+	return 0;
+}
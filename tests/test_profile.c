@@ -0,0 +1,148 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+#include "mbb/profile.h"
+#include "mbb/clock.h"
+#include "mbb/debug.h"
+#include <string.h>
+
+/* only built if configured with --enable-profile */
+
+enum {
+	TEST_PF_EVENT_GO_A = MHSM_EVENT_CUSTOM,
+	TEST_PF_EVENT_GO_B,
+	TEST_PF_EVENT_BOUNCE
+};
+
+static void test_pf_spin(uint64_t duration)
+{
+	uint64_t start = MCLK_NOW();
+
+	while (MCLK_NOW() - start < duration)
+		;
+}
+
+MHSM_DEFINE_STATE(test_pf_top, NULL);
+MHSM_DEFINE_STATE(test_pf_a, &test_pf_top);
+MHSM_DEFINE_STATE(test_pf_b, &test_pf_top);
+MHSM_DEFINE_STATE(test_pf_bounce, &test_pf_top);
+
+mhsm_state_t *test_pf_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_pf_a;
+		case TEST_PF_EVENT_GO_A:
+			return &test_pf_a;
+		case TEST_PF_EVENT_GO_B:
+			return &test_pf_b;
+		case TEST_PF_EVENT_BOUNCE:
+			return &test_pf_bounce;
+	}
+
+	return &test_pf_top;
+}
+
+mhsm_state_t *test_pf_a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_pf_a;
+}
+
+mhsm_state_t *test_pf_b_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	return &test_pf_b;
+}
+
+/* returns to test_pf_a right away */
+mhsm_state_t *test_pf_bounce_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			return &test_pf_a;
+	}
+
+	return &test_pf_bounce;
+}
+
+char *test_profile()
+{
+	mhsm_profile_entry_t entries[8];
+	mhsm_profile_t profile;
+	mhsm_profile_entry_t *a, *b;
+	mhsm_hsm_t hsm;
+	char buffer[512];
+	FILE *file;
+	size_t n;
+
+	MUNT_ASSERT(mhsm_profile_initialise(&profile, entries, 8) == 0);
+
+	mhsm_initialise(&hsm, NULL, &test_pf_top);
+	mhsm_set_profile(&hsm, &profile);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	test_pf_spin(100000);
+	mhsm_dispatch_event(&hsm, TEST_PF_EVENT_GO_B);
+	mhsm_dispatch_event(&hsm, TEST_PF_EVENT_GO_A);
+	test_pf_spin(100000);
+	mhsm_dispatch_event(&hsm, TEST_PF_EVENT_GO_B);
+	/* staying in the current state is no transition */
+	mhsm_dispatch_event(&hsm, TEST_PF_EVENT_GO_B);
+	mhsm_flush_profile(&hsm);
+
+	a = mhsm_profile_lookup(&profile, &test_pf_a, NULL);
+	b = mhsm_profile_lookup(&profile, &test_pf_b, NULL);
+	MUNT_ASSERT(a != NULL && b != NULL);
+	MUNT_ASSERT(a->count == 2 && b->count == 2);
+	MUNT_ASSERT(a->time >= 200000);
+	MUNT_ASSERT(b->time < a->time);
+	MUNT_ASSERT(mhsm_profile_lookup(&profile, &test_pf_a, &test_pf_b)->count == 2);
+	MUNT_ASSERT(mhsm_profile_lookup(&profile, &test_pf_b, &test_pf_a)->count == 1);
+	MUNT_ASSERT(mhsm_profile_lookup(&profile, &test_pf_top, NULL) == NULL);
+	MUNT_ASSERT(profile.dropped == 0);
+
+	file = tmpfile();
+	MUNT_ASSERT(file != NULL);
+	MUNT_ASSERT(mhsm_profile_write(file, &profile) == 0);
+	rewind(file);
+	n = fread(buffer, 1, sizeof(buffer) - 1, file);
+	fclose(file);
+	buffer[n] = '\0';
+#ifndef NDEBUG
+	MUNT_ASSERT(strstr(buffer, "transition test_pf_top;test_pf_a test_pf_top;test_pf_b 2\n") != NULL);
+	MUNT_ASSERT(strstr(buffer, "residency test_pf_top;test_pf_b ") != NULL);
+#endif
+
+	mhsm_profile_reset(&profile);
+	MUNT_ASSERT(mhsm_profile_lookup(&profile, &test_pf_a, NULL) == NULL);
+
+	/* a transition back to the same state ends a visit and starts another one */
+	mhsm_dispatch_event(&hsm, TEST_PF_EVENT_GO_A);
+	test_pf_spin(100000);
+	mhsm_dispatch_event(&hsm, TEST_PF_EVENT_BOUNCE);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_pf_a);
+	MUNT_ASSERT(mhsm_profile_lookup(&profile, &test_pf_a, &test_pf_a)->count == 1);
+	a = mhsm_profile_lookup(&profile, &test_pf_a, NULL);
+	MUNT_ASSERT(a->count == 2 && a->time >= 100000);
+	MUNT_ASSERT(mhsm_profile_lookup(&profile, &test_pf_a, &test_pf_bounce) == NULL);
+
+	return 0;
+}
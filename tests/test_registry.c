@@ -0,0 +1,96 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/registry.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+#define TEST_RG_NROF_SHARDS		4
+#define TEST_RG_ENTRIES_PER_SHARD	256
+#define TEST_RG_NROF_HSMS		600
+
+enum {
+	TEST_RG_EVENT_PING = MHSM_EVENT_CUSTOM
+};
+
+MHSM_DEFINE_STATE(test_rg_state, NULL);
+
+mhsm_state_t *test_rg_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	int *pings = (int*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case TEST_RG_EVENT_PING:
+			*pings += event.arg;
+			break;
+	}
+
+	return &test_rg_state;
+}
+
+static mhsm_registry_shard_t test_rg_shards[TEST_RG_NROF_SHARDS];
+static mhsm_registry_entry_t test_rg_entries[TEST_RG_NROF_SHARDS * TEST_RG_ENTRIES_PER_SHARD];
+static mhsm_hsm_t test_rg_hsms[TEST_RG_NROF_HSMS];
+static int test_rg_pings[TEST_RG_NROF_HSMS];
+
+/* device ids are sparse */
+#define TEST_RG_KEY(I) (UINT64_C(0x1000000000) + (uint64_t) (I) * 4096)
+
+char *test_registry()
+{
+	mhsm_registry_t registry;
+	size_t shard_counts[TEST_RG_NROF_SHARDS] = { 0 };
+	int i;
+
+	MUNT_ASSERT(mhsm_registry_initialise(&registry, test_rg_shards, 3, test_rg_entries, TEST_RG_ENTRIES_PER_SHARD) == -1);
+	MUNT_ASSERT(mhsm_registry_initialise(&registry, test_rg_shards, TEST_RG_NROF_SHARDS, test_rg_entries, TEST_RG_ENTRIES_PER_SHARD) == 0);
+
+	for (i = 0; i < TEST_RG_NROF_HSMS; i++) {
+		test_rg_pings[i] = 0;
+		mhsm_initialise(test_rg_hsms + i, test_rg_pings + i, &test_rg_state);
+		mhsm_dispatch_event(test_rg_hsms + i, MHSM_EVENT_INITIAL);
+
+		MUNT_ASSERT(mhsm_registry_insert(&registry, TEST_RG_KEY(i), test_rg_hsms + i) == 0);
+		shard_counts[mhsm_registry_shard(&registry, TEST_RG_KEY(i))]++;
+	}
+
+	/* keys are spread across all shards */
+	for (i = 0; i < TEST_RG_NROF_SHARDS; i++)
+		MUNT_ASSERT(shard_counts[i] > TEST_RG_NROF_HSMS / TEST_RG_NROF_SHARDS / 2);
+
+	for (i = 0; i < TEST_RG_NROF_HSMS; i++)
+		MUNT_ASSERT(mhsm_registry_lookup(&registry, TEST_RG_KEY(i)) == test_rg_hsms + i);
+
+	MUNT_ASSERT(mhsm_registry_lookup(&registry, 42) == NULL);
+
+	/* removing keys must not break the probe sequences of other keys */
+	for (i = 0; i < TEST_RG_NROF_HSMS; i += 2)
+		MUNT_ASSERT(mhsm_registry_remove(&registry, TEST_RG_KEY(i)) == test_rg_hsms + i);
+
+	for (i = 0; i < TEST_RG_NROF_HSMS; i++)
+		MUNT_ASSERT(mhsm_registry_lookup(&registry, TEST_RG_KEY(i)) == (i % 2 ? test_rg_hsms + i : NULL));
+
+	MUNT_ASSERT(mhsm_registry_dispatch(&registry, TEST_RG_KEY(3), TEST_RG_EVENT_PING, 5) == 0);
+	MUNT_ASSERT(test_rg_pings[3] == 5);
+	MUNT_ASSERT(mhsm_registry_dispatch(&registry, TEST_RG_KEY(4), TEST_RG_EVENT_PING, 5) == -1);
+
+	return 0;
+}
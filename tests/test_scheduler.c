@@ -0,0 +1,283 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/scheduler.h"
+#include "mbb/timer_sim.h"
+#include "mbb/hsm.h"
+
+#include <string.h>
+
+#define TEST_SC_NROF_HSMS 10
+
+enum {
+	TEST_SC_EVENT_TIMEOUT = MHSM_EVENT_CUSTOM,
+	TEST_SC_EVENT_WORK
+};
+
+typedef struct {
+	mtmr_sim_t timers[MTMR_NROF_TIMERS(TEST_SC_EVENT_TIMEOUT)];
+	mhsm_sched_task_t task;
+	char name;
+	/* DO events left until the work is done */
+	int steps;
+	/* DO events of the current work item */
+	int work;
+	/* clock units used by a DO event */
+	uint64_t cost;
+	bool yield;
+	unsigned long dos;
+	unsigned long done;
+} test_sc_context_t;
+
+static char test_sc_log[64];
+static uint64_t test_sc_clock;
+
+static uint64_t test_sc_now(void)
+{
+	return test_sc_clock;
+}
+
+static void test_sc_log_reset(void)
+{
+	test_sc_log[0] = '\0';
+}
+
+MHSM_DEFINE_STATE(test_sc_idle, NULL);
+MHSM_DEFINE_STATE(test_sc_busy, NULL);
+
+mhsm_state_t *test_sc_idle_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_sc_context_t *ctx = (test_sc_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case TEST_SC_EVENT_WORK:
+		case TEST_SC_EVENT_TIMEOUT:
+			ctx->steps = ctx->work;
+			return &test_sc_busy;
+		case MHSM_EVENT_DO:
+			/* never dispatched to idle HSMs */
+			ctx->dos++;
+			return MHSM_HANDLED;
+	}
+
+	return &test_sc_idle;
+}
+
+mhsm_state_t *test_sc_busy_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_sc_context_t *ctx = (test_sc_context_t*) mhsm_context(hsm);
+	size_t length;
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			mhsm_sched_activate(&ctx->task);
+			return MHSM_HANDLED;
+		case MHSM_EVENT_EXIT:
+			mhsm_sched_deactivate(&ctx->task);
+			ctx->done++;
+			mhsm_start_timer(hsm, TEST_SC_EVENT_TIMEOUT, 100);
+			return MHSM_HANDLED;
+		case MHSM_EVENT_DO:
+			ctx->dos++;
+			test_sc_clock += ctx->cost;
+			length = strlen(test_sc_log);
+			if (length + 1 < sizeof(test_sc_log)) {
+				test_sc_log[length] = ctx->name;
+				test_sc_log[length + 1] = '\0';
+			}
+			if (ctx->yield)
+				mhsm_sched_yield(&ctx->task);
+			if (--ctx->steps == 0)
+				return &test_sc_idle;
+			return MHSM_HANDLED;
+	}
+
+	return &test_sc_busy;
+}
+
+static test_sc_context_t test_sc_contexts[TEST_SC_NROF_HSMS];
+static mhsm_hsm_t test_sc_hsms[TEST_SC_NROF_HSMS];
+static mtmr_sim_t *test_sc_heap[TEST_SC_NROF_HSMS];
+static mtmr_sim_clock_t test_sc_timer_clock;
+static mhsm_sched_t test_sc_sched;
+
+static void test_sc_setup(size_t nrof_hsms, uint64_t (*now)(void), uint64_t budget)
+{
+	size_t i;
+
+	memset(test_sc_contexts, 0, sizeof(test_sc_contexts));
+	test_sc_clock = 0;
+	test_sc_log_reset();
+
+	mtmr_sim_initialise_clock(&test_sc_timer_clock, test_sc_heap, TEST_SC_NROF_HSMS);
+	mhsm_sched_initialise(&test_sc_sched, now);
+
+	for (i = 0; i < nrof_hsms; i++) {
+		test_sc_context_t *ctx = test_sc_contexts + i;
+
+		ctx->name = 'a' + i;
+		ctx->cost = 1;
+		mhsm_initialise(test_sc_hsms + i, ctx, &test_sc_idle);
+		mtmr_sim_initialise_timers(test_sc_hsms + i, MTMR_NROF_TIMERS(TEST_SC_EVENT_TIMEOUT), &test_sc_timer_clock);
+		mhsm_sched_initialise_task(&test_sc_sched, &ctx->task, test_sc_hsms + i, budget);
+		mhsm_dispatch_event(test_sc_hsms + i, MHSM_EVENT_INITIAL);
+	}
+}
+
+char *test_round_robin()
+{
+	test_sc_setup(3, NULL, 2);
+
+	MUNT_ASSERT(mhsm_sched_run_slice(&test_sc_sched) == 0);
+
+	test_sc_contexts[0].work = 3;
+	test_sc_contexts[2].work = 4;
+	mhsm_dispatch_event(test_sc_hsms + 0, TEST_SC_EVENT_WORK);
+	mhsm_dispatch_event(test_sc_hsms + 2, TEST_SC_EVENT_WORK);
+	MUNT_ASSERT(mhsm_sched_nrof_active(&test_sc_sched) == 2);
+	MUNT_ASSERT(!mhsm_sched_is_active(&test_sc_contexts[1].task));
+
+	/* slices of two DO events each, b is idle */
+	MUNT_ASSERT(mhsm_sched_run_round(&test_sc_sched) == 1);
+	MUNT_ASSERT(strcmp(test_sc_log, "aacc") == 0);
+
+	/* a is done after one more DO event */
+	MUNT_ASSERT(mhsm_sched_run_round(&test_sc_sched) == 0);
+	MUNT_ASSERT(strcmp(test_sc_log, "aaccacc") == 0);
+	MUNT_ASSERT(mhsm_sched_nrof_active(&test_sc_sched) == 0);
+	MUNT_ASSERT(test_sc_contexts[0].done == 1 && test_sc_contexts[2].done == 1);
+	MUNT_ASSERT(test_sc_contexts[1].dos == 0);
+
+	return 0;
+}
+
+char *test_activated_tasks_wait()
+{
+	test_sc_setup(3, NULL, 1);
+
+	test_sc_contexts[0].work = 2;
+	test_sc_contexts[1].work = 2;
+	test_sc_contexts[2].work = 1;
+	mhsm_dispatch_event(test_sc_hsms + 0, TEST_SC_EVENT_WORK);
+	mhsm_dispatch_event(test_sc_hsms + 1, TEST_SC_EVENT_WORK);
+
+	MUNT_ASSERT(mhsm_sched_run_slice(&test_sc_sched) == 1);
+
+	/* c is activated while b is next, it waits until a has run again */
+	mhsm_dispatch_event(test_sc_hsms + 2, TEST_SC_EVENT_WORK);
+	while (mhsm_sched_run_slice(&test_sc_sched) == 1)
+		;
+
+	MUNT_ASSERT(strcmp(test_sc_log, "abacb") == 0);
+
+	return 0;
+}
+
+char *test_time_budgets()
+{
+	test_sc_setup(2, test_sc_now, 10);
+
+	test_sc_contexts[0].work = 100;
+	test_sc_contexts[0].cost = 4;
+	test_sc_contexts[1].work = 100;
+	test_sc_contexts[1].cost = 20;
+	mhsm_dispatch_event(test_sc_hsms + 0, TEST_SC_EVENT_WORK);
+	mhsm_dispatch_event(test_sc_hsms + 1, TEST_SC_EVENT_WORK);
+
+	/* a needs 3 DO events to use up its budget, b exceeds it with 1 */
+	MUNT_ASSERT(mhsm_sched_run_round(&test_sc_sched) == 1);
+	MUNT_ASSERT(strcmp(test_sc_log, "aaab") == 0);
+	MUNT_ASSERT(test_sc_clock == 32);
+
+	return 0;
+}
+
+char *test_yield()
+{
+	test_sc_setup(2, NULL, 100);
+
+	test_sc_contexts[0].work = 3;
+	test_sc_contexts[0].yield = 1;
+	test_sc_contexts[1].work = 2;
+	mhsm_dispatch_event(test_sc_hsms + 0, TEST_SC_EVENT_WORK);
+	mhsm_dispatch_event(test_sc_hsms + 1, TEST_SC_EVENT_WORK);
+
+	while (mhsm_sched_run_slice(&test_sc_sched) == 1)
+		;
+
+	MUNT_ASSERT(strcmp(test_sc_log, "abbaa") == 0);
+
+	return 0;
+}
+
+char *test_nested_activities()
+{
+	mhsm_sched_task_t task;
+	mhsm_hsm_t hsm;
+
+	mhsm_sched_initialise(&test_sc_sched, NULL);
+	mhsm_sched_initialise_task(&test_sc_sched, &task, &hsm, 1);
+
+	mhsm_sched_activate(&task);
+	mhsm_sched_activate(&task);
+	MUNT_ASSERT(mhsm_sched_nrof_active(&test_sc_sched) == 1);
+
+	mhsm_sched_deactivate(&task);
+	MUNT_ASSERT(mhsm_sched_is_active(&task));
+	mhsm_sched_deactivate(&task);
+	MUNT_ASSERT(!mhsm_sched_is_active(&task));
+	MUNT_ASSERT(mhsm_sched_nrof_active(&test_sc_sched) == 0);
+
+	return 0;
+}
+
+char *test_timers()
+{
+	unsigned long dos = 0, done = 0;
+	size_t i;
+
+	test_sc_setup(TEST_SC_NROF_HSMS, NULL, 2);
+
+	for (i = 0; i < TEST_SC_NROF_HSMS; i++) {
+		test_sc_contexts[i].work = 1 + i % 3;
+		mhsm_start_timer(test_sc_hsms + i, TEST_SC_EVENT_TIMEOUT, 10 * (i + 1));
+	}
+
+	/* run the DO activities, wait for the next timer when all HSMs are idle */
+	while (mtmr_sim_now(&test_sc_timer_clock) < 10000) {
+		if (mhsm_sched_run_round(&test_sc_sched) == 0)
+			MUNT_ASSERT(mtmr_sim_run_next(&test_sc_timer_clock) == 1);
+	}
+
+	for (i = 0; i < TEST_SC_NROF_HSMS; i++) {
+		MUNT_ASSERT(test_sc_contexts[i].done > 0);
+		/* DO events are only dispatched to busy HSMs */
+		MUNT_ASSERT(test_sc_contexts[i].dos >= test_sc_contexts[i].done * test_sc_contexts[i].work);
+		MUNT_ASSERT(test_sc_contexts[i].dos <= (test_sc_contexts[i].done + 1) * test_sc_contexts[i].work);
+		dos += test_sc_contexts[i].dos;
+		done += test_sc_contexts[i].done;
+	}
+
+	MUNT_ASSERT(done > 500);
+	MUNT_ASSERT(dos < 3 * done);
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/snapshot.h"
+#include "mbb/timer_periodic.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+enum {
+	TEST_SN_EVENT_TIMEOUT = MHSM_EVENT_CUSTOM,
+	TEST_SN_EVENT_GO,
+	TEST_SN_EVENT_LATER
+};
+
+typedef struct {
+	mtmr_prd_t timers[MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT)];
+	int timeouts;
+} test_sn_context_t;
+
+MHSM_DEFINE_STATE(test_sn_top, NULL);
+MHSM_DEFINE_STATE(test_sn_idle, &test_sn_top);
+MHSM_DEFINE_STATE(test_sn_running, &test_sn_top);
+
+static mhsm_state_t *test_sn_states[] = { &test_sn_top, &test_sn_idle, &test_sn_running };
+
+#define TEST_SN_NROF_STATES (sizeof(test_sn_states) / sizeof(test_sn_states[0]))
+
+mhsm_state_t *test_sn_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_sn_idle;
+	}
+
+	return &test_sn_top;
+}
+
+mhsm_state_t *test_sn_idle_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_SN_EVENT_GO:
+			return &test_sn_running;
+		case TEST_SN_EVENT_LATER:
+			return NULL;
+	}
+
+	return &test_sn_idle;
+}
+
+mhsm_state_t *test_sn_running_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_sn_context_t *ctx = (test_sn_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			mhsm_start_timer(hsm, TEST_SN_EVENT_TIMEOUT, 100);
+			break;
+		case TEST_SN_EVENT_TIMEOUT:
+			ctx->timeouts++;
+			return &test_sn_idle;
+		case TEST_SN_EVENT_LATER:
+			return NULL;
+	}
+
+	return &test_sn_running;
+}
+
+static void test_sn_initialise(mhsm_hsm_t *hsm, test_sn_context_t *ctx)
+{
+	ctx->timeouts = 0;
+	mhsm_initialise(hsm, ctx, &test_sn_top);
+	mtmr_prd_initialise_timers(hsm, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT));
+}
+
+char *test_snapshot_buffer()
+{
+	mhsm_hsm_t hsm, restored;
+	test_sn_context_t ctx, restored_ctx;
+	uint8_t buffer[64];
+	int length;
+
+	test_sn_initialise(&hsm, &ctx);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+	mhsm_dispatch_event_arg(&hsm, TEST_SN_EVENT_LATER, -7);
+	mhsm_dispatch_event(&hsm, TEST_SN_EVENT_GO);
+	mtmr_prd_increment_timers(&hsm, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), 60);
+
+	length = mhsm_snapshot_save(&hsm, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), buffer, sizeof(buffer));
+	MUNT_ASSERT(length > 0 && length < 16);
+
+	/* too small a buffer */
+	MUNT_ASSERT(mhsm_snapshot_save(&hsm, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), buffer, 2) == -1);
+
+	test_sn_initialise(&restored, &restored_ctx);
+	MUNT_ASSERT(mhsm_snapshot_restore(&restored, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), buffer, length) == length);
+
+	MUNT_ASSERT(mhsm_current_state(&restored) == &test_sn_running);
+	MUNT_ASSERT(MQUE_LENGTH(mhsm_deferred_events(&restored)) == 1);
+	MUNT_ASSERT(MQUE_HEAD(mhsm_deferred_events(&restored)).id == TEST_SN_EVENT_LATER);
+	MUNT_ASSERT(MQUE_HEAD(mhsm_deferred_events(&restored)).arg == -7);
+	MUNT_ASSERT(restored_ctx.timers[0].active);
+
+	/* the timer expires after the remaining 40 ms */
+	mtmr_prd_increment_timers(&restored, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), 39);
+	MUNT_ASSERT(restored_ctx.timeouts == 0);
+	mtmr_prd_increment_timers(&restored, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), 1);
+	MUNT_ASSERT(restored_ctx.timeouts == 1);
+	MUNT_ASSERT(mhsm_current_state(&restored) == &test_sn_idle);
+
+	return 0;
+}
+
+#define TEST_SN_NROF_HSMS 100
+
+char *test_snapshot_file()
+{
+	mhsm_hsm_t hsms[TEST_SN_NROF_HSMS], restored[TEST_SN_NROF_HSMS];
+	test_sn_context_t ctxs[TEST_SN_NROF_HSMS], restored_ctxs[TEST_SN_NROF_HSMS];
+	FILE *file;
+	int i;
+
+	for (i = 0; i < TEST_SN_NROF_HSMS; i++) {
+		test_sn_initialise(hsms + i, ctxs + i);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+		if (i % 3 == 0)
+			mhsm_dispatch_event(hsms + i, TEST_SN_EVENT_GO);
+
+		test_sn_initialise(restored + i, restored_ctxs + i);
+	}
+
+	file = tmpfile();
+	MUNT_ASSERT(file != NULL);
+	MUNT_ASSERT(mhsm_snapshot_write(file, hsms, TEST_SN_NROF_HSMS, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT)) == 0);
+	rewind(file);
+	MUNT_ASSERT(mhsm_snapshot_read(file, restored, TEST_SN_NROF_HSMS, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT)) == TEST_SN_NROF_HSMS);
+	fclose(file);
+
+	for (i = 0; i < TEST_SN_NROF_HSMS; i++) {
+		MUNT_ASSERT(mhsm_current_state(restored + i) == mhsm_current_state(hsms + i));
+		MUNT_ASSERT(restored_ctxs[i].timers[0].active == ctxs[i].timers[0].active);
+	}
+
+	return 0;
+}
+
+/* the state, the queued event and the timer of an HSM restored or not */
+static bool test_sn_unchanged(mhsm_hsm_t *hsm, test_sn_context_t *ctx)
+{
+	return mhsm_current_state(hsm) == &test_sn_idle &&
+		mhsm_queue_length(hsm) == 1 &&
+		MQUE_HEAD(mhsm_deferred_events(hsm)).arg == 5 &&
+		!ctx->timers[0].active;
+}
+
+char *test_truncated_snapshot()
+{
+	mhsm_hsm_t hsm, restored;
+	test_sn_context_t ctx, restored_ctx;
+	uint8_t buffer[64];
+	int length, size;
+
+	test_sn_initialise(&hsm, &ctx);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+	mhsm_dispatch_event_arg(&hsm, TEST_SN_EVENT_LATER, -7);
+	mhsm_dispatch_event(&hsm, TEST_SN_EVENT_GO);
+	length = mhsm_snapshot_save(&hsm, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), buffer, sizeof(buffer));
+	MUNT_ASSERT(length > 0);
+
+	test_sn_initialise(&restored, &restored_ctx);
+	mhsm_dispatch_event(&restored, MHSM_EVENT_INITIAL);
+	mhsm_dispatch_event_arg(&restored, TEST_SN_EVENT_LATER, 5);
+	MUNT_ASSERT(test_sn_unchanged(&restored, &restored_ctx));
+
+	/* an invalid snapshot leaves the HSM alone */
+	for (size = 0; size < length; size++) {
+		if (mhsm_snapshot_restore(&restored, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT), buffer, size) != -1)
+			/* the events of higher priorities are optional */
+			break;
+		MUNT_ASSERT(test_sn_unchanged(&restored, &restored_ctx));
+	}
+	MUNT_ASSERT(size >= length - 1);
+
+	return 0;
+}
+
+char *test_truncated_file()
+{
+	mhsm_hsm_t hsms[3], restored[3];
+	test_sn_context_t ctxs[3], restored_ctxs[3];
+	uint8_t data[256];
+	size_t size;
+	FILE *file;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		test_sn_initialise(hsms + i, ctxs + i);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+		mhsm_dispatch_event(hsms + i, TEST_SN_EVENT_GO);
+
+		test_sn_initialise(restored + i, restored_ctxs + i);
+		mhsm_dispatch_event(restored + i, MHSM_EVENT_INITIAL);
+		mhsm_dispatch_event_arg(restored + i, TEST_SN_EVENT_LATER, 5);
+	}
+
+	file = tmpfile();
+	MUNT_ASSERT(file != NULL);
+	MUNT_ASSERT(mhsm_snapshot_write(file, hsms, 3, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT)) == 0);
+	rewind(file);
+	size = fread(data, 1, sizeof(data), file);
+	fclose(file);
+	MUNT_ASSERT(size > 0 && size < sizeof(data));
+
+	/* the last snapshot is cut short, none is restored */
+	file = tmpfile();
+	MUNT_ASSERT(file != NULL);
+	MUNT_ASSERT(fwrite(data, 1, size - 1, file) == size - 1);
+	rewind(file);
+	MUNT_ASSERT(mhsm_snapshot_read(file, restored, 3, test_sn_states, TEST_SN_NROF_STATES, MTMR_NROF_TIMERS(TEST_SN_EVENT_TIMEOUT)) == -1);
+	fclose(file);
+
+	for (i = 0; i < 3; i++)
+		MUNT_ASSERT(test_sn_unchanged(restored + i, restored_ctxs + i));
+
+	return 0;
+}
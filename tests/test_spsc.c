@@ -0,0 +1,114 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/spsc.h"
+#include "mbb/debug.h"
+
+char *test_spsc_enqueue_dequeue()
+{
+	int i;
+
+	MSPSC_DEFINE_STRUCT(int, 5) queue;
+
+	MSPSC_INITIALISE(&queue);
+
+	MUNT_ASSERT(MSPSC_IS_EMPTY(&queue));
+
+	for (i = 1; i <= 5; i++) {
+		MUNT_ASSERT(!MSPSC_IS_FULL(&queue));
+		MSPSC_ENQUEUE(&queue, i);
+	}
+
+	MUNT_ASSERT(MSPSC_IS_FULL(&queue));
+	MUNT_ASSERT(MSPSC_LENGTH(&queue) == 5);
+
+	/* does nothing if full */
+	MSPSC_ENQUEUE(&queue, 6);
+	MUNT_ASSERT(MSPSC_LENGTH(&queue) == 5);
+
+	for (i = 1; i <= 5; i++) {
+		MUNT_ASSERT(!MSPSC_IS_EMPTY(&queue));
+		MUNT_ASSERT(MSPSC_HEAD(&queue) == i);
+		MSPSC_DEQUEUE(&queue);
+	}
+
+	MUNT_ASSERT(MSPSC_IS_EMPTY(&queue));
+
+	/* does nothing if empty */
+	MSPSC_DEQUEUE(&queue);
+	MUNT_ASSERT(MSPSC_LENGTH(&queue) == 0);
+
+	return 0;
+}
+
+char *test_spsc_publish()
+{
+	MSPSC_DEFINE_STRUCT(int, 4) queue = MSPSC_INITIALISER;
+
+	MSPSC_STAGE(&queue, 1);
+	MSPSC_STAGE(&queue, 2);
+
+	/* staged elements are invisible to the consumer */
+	MUNT_ASSERT(MSPSC_IS_EMPTY(&queue));
+
+	MSPSC_PUBLISH(&queue);
+	MUNT_ASSERT(MSPSC_LENGTH(&queue) == 2);
+	MUNT_ASSERT(!MSPSC_IS_EMPTY(&queue));
+	MUNT_ASSERT(MSPSC_HEAD(&queue) == 1);
+
+	MSPSC_STAGE(&queue, 3);
+	MSPSC_STAGE(&queue, 4);
+	MUNT_ASSERT(MSPSC_IS_FULL(&queue));
+
+	/* staged elements count against the capacity */
+	MSPSC_STAGE(&queue, 5);
+	MSPSC_PUBLISH(&queue);
+	MUNT_ASSERT(MSPSC_LENGTH(&queue) == 4);
+
+	/* the producer notices dequeued elements */
+	MSPSC_DEQUEUE(&queue);
+	MUNT_ASSERT(!MSPSC_IS_FULL(&queue));
+
+	return 0;
+}
+
+char *test_spsc_wrap_around()
+{
+	int i, expected = 0;
+
+	MSPSC_DEFINE_STRUCT(int, 3) queue = MSPSC_INITIALISER;
+
+	for (i = 0; i < 1000; i++) {
+		MSPSC_ENQUEUE(&queue, i);
+
+		if (i % 2 == 1) {
+			while (!MSPSC_IS_EMPTY(&queue)) {
+				MUNT_ASSERT(MSPSC_HEAD(&queue) == expected);
+				expected++;
+				MSPSC_DEQUEUE(&queue);
+			}
+		}
+	}
+
+	MUNT_ASSERT(expected == 1000);
+
+	return 0;
+}
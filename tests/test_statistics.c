@@ -0,0 +1,126 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+#include <string.h>
+
+/* only built if configured with --enable-statistics */
+
+enum {
+	TEST_ST_EVENT_IGNORE = MHSM_EVENT_CUSTOM,
+	TEST_ST_EVENT_HANDLE,
+	TEST_ST_EVENT_LATER,
+	TEST_ST_EVENT_GO
+};
+
+MHSM_DEFINE_STATE(test_st_top, NULL);
+MHSM_DEFINE_STATE(test_st_a, &test_st_top);
+MHSM_DEFINE_STATE(test_st_b, &test_st_top);
+
+mhsm_state_t *test_st_top_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case MHSM_EVENT_INITIAL:
+			return &test_st_a;
+	}
+
+	return &test_st_top;
+}
+
+mhsm_state_t *test_st_a_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_ST_EVENT_HANDLE:
+			return MHSM_HANDLED;
+		case TEST_ST_EVENT_LATER:
+			return NULL;
+		case TEST_ST_EVENT_GO:
+			return &test_st_b;
+	}
+
+	return &test_st_a;
+}
+
+mhsm_state_t *test_st_b_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_ST_EVENT_LATER:
+			return MHSM_HANDLED;
+	}
+
+	return &test_st_b;
+}
+
+char *test_statistics()
+{
+	mhsm_hsm_t hsm, full;
+	mhsm_stats_t total;
+	const mhsm_stats_t *stats;
+	int i;
+
+	mhsm_initialise(&hsm, NULL, &test_st_top);
+	stats = mhsm_stats(&hsm);
+
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+	MUNT_ASSERT(stats->dispatched == 0);
+	MUNT_ASSERT(stats->transitions == 1);
+	MUNT_ASSERT(stats->entries == 2);
+
+	mhsm_dispatch_event(&hsm, TEST_ST_EVENT_IGNORE);
+	mhsm_dispatch_event(&hsm, TEST_ST_EVENT_HANDLE);
+	MUNT_ASSERT(stats->dispatched == 2);
+	MUNT_ASSERT(stats->handled == 1);
+
+	mhsm_dispatch_event(&hsm, TEST_ST_EVENT_LATER);
+	MUNT_ASSERT(stats->deferred == 1);
+	MUNT_ASSERT(stats->max_queue_depth == 1);
+
+	/* the deferred event is dispatched again and handled by b */
+	mhsm_dispatch_event(&hsm, TEST_ST_EVENT_GO);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_st_b);
+	MUNT_ASSERT(stats->dispatched == 5);
+	MUNT_ASSERT(stats->handled == 3);
+	MUNT_ASSERT(stats->transitions == 2);
+	MUNT_ASSERT(stats->entries == 3);
+	MUNT_ASSERT(stats->exits == 1);
+	MUNT_ASSERT(stats->dropped == 0);
+
+	mhsm_initialise(&full, NULL, &test_st_top);
+	mhsm_dispatch_event(&full, MHSM_EVENT_INITIAL);
+	for (i = 0; i < MHSM_EVENT_QUEUE_LENGTH; i++)
+		MUNT_ASSERT(mhsm_dispatch_event(&full, TEST_ST_EVENT_LATER) == 0);
+	MUNT_ASSERT(mhsm_dispatch_event(&full, TEST_ST_EVENT_LATER) == -1);
+	MUNT_ASSERT(mhsm_stats(&full)->dropped == 1);
+	MUNT_ASSERT(mhsm_stats(&full)->max_queue_depth == MHSM_EVENT_QUEUE_LENGTH);
+
+	memset(&total, 0, sizeof(total));
+	mhsm_accumulate_stats(&total, &hsm);
+	mhsm_accumulate_stats(&total, &full);
+	MUNT_ASSERT(total.transitions == 3);
+	MUNT_ASSERT(total.dropped == 1);
+	MUNT_ASSERT(total.max_queue_depth == MHSM_EVENT_QUEUE_LENGTH);
+
+	mhsm_reset_stats(&hsm);
+	MUNT_ASSERT(stats->dispatched == 0 && stats->transitions == 0);
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/store.h"
+#include "mbb/timer_periodic.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+#include <unistd.h>
+
+#define TEST_ST_PATH		"test_store.dat"
+#define TEST_ST_NROF_SLOTS	1000
+/* an event id and argument taking 5 bytes each in a snapshot */
+#define TEST_ST_EVENT_LARGE	0x10000000
+#define TEST_ST_ARG_LARGE	INT32_MIN
+
+enum {
+	TEST_ST_EVENT_TIMEOUT = MHSM_EVENT_CUSTOM,
+	TEST_ST_EVENT_ON
+};
+
+typedef struct {
+	mtmr_prd_t timers[MTMR_NROF_TIMERS(TEST_ST_EVENT_TIMEOUT)];
+	uint32_t counter;
+} test_st_context_t;
+
+MHSM_DEFINE_STATE(test_st_off, NULL);
+MHSM_DEFINE_STATE(test_st_on, NULL);
+
+static mhsm_state_t *test_st_states[] = { &test_st_off, &test_st_on };
+
+mhsm_state_t *test_st_off_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	switch (event.id) {
+		case TEST_ST_EVENT_ON:
+			return &test_st_on;
+		case TEST_ST_EVENT_LARGE:
+			return NULL;
+	}
+
+	return &test_st_off;
+}
+
+mhsm_state_t *test_st_on_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_st_context_t *ctx = (test_st_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			ctx->counter++;
+			mhsm_start_timer(hsm, TEST_ST_EVENT_TIMEOUT, 1000);
+			break;
+		case TEST_ST_EVENT_TIMEOUT:
+			return &test_st_off;
+	}
+
+	return &test_st_on;
+}
+
+static int test_st_open(mhsm_store_t *store)
+{
+	return mhsm_store_open(store, TEST_ST_PATH, TEST_ST_NROF_SLOTS, sizeof(test_st_context_t), test_st_states, 2);
+}
+
+char *test_store_persistence()
+{
+	mhsm_store_t store;
+	mhsm_hsm_t hsm;
+	test_st_context_t *ctx;
+	size_t id;
+
+	unlink(TEST_ST_PATH);
+
+	MUNT_ASSERT(test_st_open(&store) == 0);
+	for (id = 0; id < TEST_ST_NROF_SLOTS; id += 7) {
+		MUNT_ASSERT(mhsm_store_attach(&store, id, &hsm, &test_st_off) == 0);
+		mtmr_prd_initialise_timers(&hsm, MTMR_NROF_TIMERS(TEST_ST_EVENT_TIMEOUT));
+		mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+		if (id % 2)
+			mhsm_dispatch_event(&hsm, TEST_ST_EVENT_ON);
+		mtmr_prd_increment_timers(&hsm, MTMR_NROF_TIMERS(TEST_ST_EVENT_TIMEOUT), 400);
+		MUNT_ASSERT(mhsm_store_save(&store, id, &hsm) == 0);
+	}
+	MUNT_ASSERT(mhsm_store_close(&store) == 0);
+
+	/* a store with different parameters is rejected */
+	MUNT_ASSERT(mhsm_store_open(&store, TEST_ST_PATH, TEST_ST_NROF_SLOTS + 1, sizeof(test_st_context_t), test_st_states, 2) == -1);
+
+	MUNT_ASSERT(test_st_open(&store) == 0);
+	MUNT_ASSERT(!mhsm_store_is_used(&store, 1));
+	for (id = 0; id < TEST_ST_NROF_SLOTS; id += 7) {
+		MUNT_ASSERT(mhsm_store_is_used(&store, id));
+		MUNT_ASSERT(mhsm_store_attach(&store, id, &hsm, &test_st_off) == 1);
+		mtmr_prd_resume_timers(&hsm);
+
+		ctx = (test_st_context_t*) mhsm_context(&hsm);
+		MUNT_ASSERT(ctx->counter == id % 2);
+		MUNT_ASSERT(mhsm_current_state(&hsm) == (id % 2 ? &test_st_on : &test_st_off));
+
+		/* timers continue where they left off */
+		mtmr_prd_increment_timers(&hsm, MTMR_NROF_TIMERS(TEST_ST_EVENT_TIMEOUT), 600);
+		MUNT_ASSERT(mhsm_current_state(&hsm) == &test_st_off);
+	}
+
+	mhsm_store_release(&store, 0);
+	MUNT_ASSERT(!mhsm_store_is_used(&store, 0));
+	MUNT_ASSERT(mhsm_store_close(&store) == 0);
+
+	unlink(TEST_ST_PATH);
+
+	return 0;
+}
+
+char *test_store_too_large()
+{
+#if MHSM_PRIORITY_LEVELS > 1
+	mhsm_store_t store;
+	mhsm_hsm_t hsm;
+	int i, p;
+
+	unlink(TEST_ST_PATH);
+
+	MUNT_ASSERT(test_st_open(&store) == 0);
+	MUNT_ASSERT(mhsm_store_attach(&store, 3, &hsm, &test_st_off) == 0);
+	mtmr_prd_initialise_timers(&hsm, MTMR_NROF_TIMERS(TEST_ST_EVENT_TIMEOUT));
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+	MUNT_ASSERT(mhsm_store_save(&store, 3, &hsm) == 0);
+
+	/* full queues of all priorities do not fit into the slot */
+	mhsm_dispatch_event(&hsm, TEST_ST_EVENT_ON);
+	mhsm_dispatch_event(&hsm, TEST_ST_EVENT_TIMEOUT);
+	for (p = 0; p < MHSM_PRIORITY_LEVELS; p++)
+		for (i = 0; i < MHSM_EVENT_QUEUE_LENGTH; i++)
+			mhsm_dispatch_event_prio(&hsm, TEST_ST_EVENT_LARGE, TEST_ST_ARG_LARGE, p);
+	MUNT_ASSERT(mhsm_store_save(&store, 3, &hsm) == -1);
+
+	/* the previous snapshot is still intact */
+	MUNT_ASSERT(mhsm_store_attach(&store, 3, &hsm, &test_st_off) == 1);
+	MUNT_ASSERT(mhsm_current_state(&hsm) == &test_st_off);
+	MUNT_ASSERT(MQUE_IS_EMPTY(mhsm_deferred_events(&hsm)));
+	MUNT_ASSERT(((test_st_context_t*) mhsm_context(&hsm))->counter == 1);
+
+	MUNT_ASSERT(mhsm_store_close(&store) == 0);
+	unlink(TEST_ST_PATH);
+#endif
+
+	return 0;
+}
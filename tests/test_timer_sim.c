@@ -0,0 +1,182 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/timer_sim.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+#define TEST_TS_NROF_HSMS 100
+
+enum {
+	TEST_TS_EVENT_TIMEOUT = MHSM_EVENT_CUSTOM,
+	TEST_TS_EVENT_OTHER_TIMEOUT,
+	TEST_TS_EVENT_RESTART
+};
+
+typedef struct {
+	mtmr_sim_t timers[MTMR_NROF_TIMERS(TEST_TS_EVENT_OTHER_TIMEOUT)];
+	uint32_t toggles;
+	uint64_t last_timeout;
+	uint32_t last_event;
+} test_ts_context_t;
+
+MHSM_DEFINE_STATE(test_ts_on, NULL);
+MHSM_DEFINE_STATE(test_ts_off, NULL);
+
+mhsm_state_t *test_ts_on_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_ts_context_t *ctx = (test_ts_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			mhsm_start_timer(hsm, TEST_TS_EVENT_TIMEOUT, 300);
+			break;
+		case TEST_TS_EVENT_TIMEOUT:
+			ctx->toggles++;
+			return &test_ts_off;
+	}
+
+	return &test_ts_on;
+}
+
+mhsm_state_t *test_ts_off_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_ts_context_t *ctx = (test_ts_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case MHSM_EVENT_ENTRY:
+			mhsm_start_timer(hsm, TEST_TS_EVENT_TIMEOUT, 700);
+			break;
+		case TEST_TS_EVENT_TIMEOUT:
+			ctx->toggles++;
+			return &test_ts_on;
+	}
+
+	return &test_ts_off;
+}
+
+MHSM_DEFINE_STATE(test_ts_idle, NULL);
+
+mhsm_state_t *test_ts_idle_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_ts_context_t *ctx = (test_ts_context_t*) mhsm_context(hsm);
+
+	switch (event.id) {
+		case TEST_TS_EVENT_RESTART:
+			mhsm_start_timer(hsm, TEST_TS_EVENT_TIMEOUT, event.arg);
+			break;
+		case TEST_TS_EVENT_TIMEOUT:
+		case TEST_TS_EVENT_OTHER_TIMEOUT:
+			ctx->toggles++;
+			ctx->last_event = event.id;
+			break;
+	}
+
+	return &test_ts_idle;
+}
+
+char *test_timer_sim_hour()
+{
+	static test_ts_context_t contexts[TEST_TS_NROF_HSMS];
+	static mhsm_hsm_t hsms[TEST_TS_NROF_HSMS];
+	mtmr_sim_t *heap[TEST_TS_NROF_HSMS];
+	mtmr_sim_clock_t clock;
+	uint64_t deadline;
+	int i;
+
+	mtmr_sim_initialise_clock(&clock, heap, TEST_TS_NROF_HSMS);
+
+	for (i = 0; i < TEST_TS_NROF_HSMS; i++) {
+		contexts[i].toggles = 0;
+		mhsm_initialise(hsms + i, contexts + i, &test_ts_on);
+		mtmr_sim_initialise_timers(hsms + i, MTMR_NROF_TIMERS(TEST_TS_EVENT_OTHER_TIMEOUT), &clock);
+		mhsm_dispatch_event(hsms + i, MHSM_EVENT_INITIAL);
+	}
+
+	MUNT_ASSERT(mtmr_sim_next_deadline(&clock, &deadline) && deadline == 300);
+
+	MUNT_ASSERT(mtmr_sim_advance(&clock, MTMR_ONE_HOUR) == 2 * 3600 * TEST_TS_NROF_HSMS);
+	MUNT_ASSERT(mtmr_sim_now(&clock) == MTMR_ONE_HOUR);
+	for (i = 0; i < TEST_TS_NROF_HSMS; i++) {
+		MUNT_ASSERT(contexts[i].toggles == 2 * 3600);
+		MUNT_ASSERT(mhsm_current_state(hsms + i) == &test_ts_on);
+	}
+
+	MUNT_ASSERT(mtmr_sim_run_next(&clock) == 1);
+	MUNT_ASSERT(mtmr_sim_now(&clock) == MTMR_ONE_HOUR + 300);
+	MUNT_ASSERT(mhsm_current_state(hsms) == &test_ts_off);
+
+	return 0;
+}
+
+char *test_timer_sim_restart()
+{
+	test_ts_context_t context;
+	mtmr_sim_t *heap[1];
+	mtmr_sim_clock_t clock;
+	mhsm_hsm_t hsm;
+
+	mtmr_sim_initialise_clock(&clock, heap, 1);
+	context.toggles = 0;
+	mhsm_initialise(&hsm, &context, &test_ts_idle);
+	mtmr_sim_initialise_timers(&hsm, MTMR_NROF_TIMERS(TEST_TS_EVENT_OTHER_TIMEOUT), &clock);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	/* restarting replaces the pending timeout */
+	mhsm_dispatch_event_arg(&hsm, TEST_TS_EVENT_RESTART, 500);
+	mhsm_dispatch_event_arg(&hsm, TEST_TS_EVENT_RESTART, 100);
+	MUNT_ASSERT(mtmr_sim_advance(&clock, 1000) == 1);
+	MUNT_ASSERT(context.toggles == 1);
+
+	/* the heap holds a single timer */
+	MUNT_ASSERT(mhsm_start_timer(&hsm, TEST_TS_EVENT_TIMEOUT, 10) == 0);
+	MUNT_ASSERT(mhsm_start_timer(&hsm, TEST_TS_EVENT_OTHER_TIMEOUT, 10) == -1);
+	MUNT_ASSERT(mtmr_sim_run_next(&clock) == 1);
+	MUNT_ASSERT(mtmr_sim_run_next(&clock) == 0);
+	MUNT_ASSERT(mtmr_sim_now(&clock) == 1010);
+
+	return 0;
+}
+
+char *test_timer_sim_order()
+{
+	test_ts_context_t context;
+	mtmr_sim_t *heap[2];
+	mtmr_sim_clock_t clock;
+	mhsm_hsm_t hsm;
+
+	mtmr_sim_initialise_clock(&clock, heap, 2);
+	context.toggles = 0;
+	mhsm_initialise(&hsm, &context, &test_ts_idle);
+	mtmr_sim_initialise_timers(&hsm, MTMR_NROF_TIMERS(TEST_TS_EVENT_OTHER_TIMEOUT), &clock);
+	mhsm_dispatch_event(&hsm, MHSM_EVENT_INITIAL);
+
+	/* timers expiring at the same time fire in the order they were started */
+	mhsm_start_timer(&hsm, TEST_TS_EVENT_OTHER_TIMEOUT, 50);
+	mhsm_start_timer(&hsm, TEST_TS_EVENT_TIMEOUT, 50);
+	MUNT_ASSERT(mtmr_sim_run_next(&clock) == 1);
+	MUNT_ASSERT(context.last_event == TEST_TS_EVENT_OTHER_TIMEOUT);
+	MUNT_ASSERT(mtmr_sim_run_next(&clock) == 1);
+	MUNT_ASSERT(context.last_event == TEST_TS_EVENT_TIMEOUT);
+	MUNT_ASSERT(mtmr_sim_now(&clock) == 50);
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+/* * Copyright (C) 2015 Jan Weil
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mbb/test.h"
+#include "mbb/trace.h"
+#include "mbb/registry.h"
+#include "mbb/clock.h"
+#include "mbb/hsm.h"
+#include "mbb/debug.h"
+
+#define TEST_TR_NROF_HSMS 4
+
+typedef struct {
+	int32_t sum;
+	uint32_t nrof_events;
+} test_tr_context_t;
+
+MHSM_DEFINE_STATE(test_tr_state, NULL);
+
+mhsm_state_t *test_tr_state_fun(mhsm_hsm_t *hsm, mhsm_event_t event)
+{
+	test_tr_context_t *ctx = (test_tr_context_t*) mhsm_context(hsm);
+
+	if (event.id >= MHSM_EVENT_CUSTOM) {
+		ctx->sum += event.arg * (int32_t) event.id;
+		ctx->nrof_events++;
+	}
+
+	return &test_tr_state;
+}
+
+static int test_tr_start_timer(mhsm_hsm_t *hsm, uint32_t event_id, uint32_t period_msecs)
+{
+	return 0;
+}
+
+static mhsm_registry_shard_t test_tr_shards[2];
+static mhsm_registry_entry_t test_tr_entries[2 * 8];
+static mhsm_hsm_t test_tr_hsms[TEST_TR_NROF_HSMS];
+static test_tr_context_t test_tr_contexts[TEST_TR_NROF_HSMS];
+
+static void test_tr_setup(mhsm_registry_t *registry)
+{
+	int i;
+
+	mhsm_registry_initialise(registry, test_tr_shards, 2, test_tr_entries, 8);
+	for (i = 0; i < TEST_TR_NROF_HSMS; i++) {
+		test_tr_contexts[i].sum = 0;
+		test_tr_contexts[i].nrof_events = 0;
+		mhsm_initialise(test_tr_hsms + i, test_tr_contexts + i, &test_tr_state);
+		mhsm_dispatch_event(test_tr_hsms + i, MHSM_EVENT_INITIAL);
+		mhsm_registry_insert(registry, 1000 + i, test_tr_hsms + i);
+	}
+}
+
+char *test_trace()
+{
+	test_tr_context_t recorded[TEST_TR_NROF_HSMS];
+	mhsm_trace_recorder_t recorder;
+	mhsm_trace_reader_t reader;
+	mhsm_trace_record_t record;
+	mhsm_registry_t registry;
+	uint64_t start;
+	FILE *file;
+	int i;
+
+	file = tmpfile();
+	MUNT_ASSERT(file != NULL);
+
+	test_tr_setup(&registry);
+	MUNT_ASSERT(mhsm_trace_open_recorder(&recorder, file) == 0);
+	mhsm_registry_set_hook(&registry, mhsm_trace_hook, &recorder);
+
+	for (i = 0; i < 100; i++)
+		mhsm_registry_dispatch(&registry, 1000 + i % TEST_TR_NROF_HSMS, MHSM_EVENT_CUSTOM + i % 3, i - 50);
+	/* unknown keys are recorded, too */
+	mhsm_registry_dispatch(&registry, 1ull << 40, MHSM_EVENT_CUSTOM, 0);
+	start = mclk_now();
+	while (mclk_now() - start < 2000000)
+		;
+	mhsm_registry_dispatch(&registry, 1000, MHSM_EVENT_CUSTOM, -1000000);
+	MUNT_ASSERT(recorder.nrof_records == 102);
+
+	for (i = 0; i < TEST_TR_NROF_HSMS; i++)
+		recorded[i] = test_tr_contexts[i];
+
+	/* check the first record */
+	rewind(file);
+	MUNT_ASSERT(mhsm_trace_open_reader(&reader, file) == 0);
+	MUNT_ASSERT(mhsm_trace_read(&reader, &record) == 1);
+	MUNT_ASSERT(record.key == 1000 && record.id == MHSM_EVENT_CUSTOM && record.arg == -50);
+
+	/* replay as fast as possible */
+	rewind(file);
+	test_tr_setup(&registry);
+	MUNT_ASSERT(mhsm_trace_open_reader(&reader, file) == 0);
+	MUNT_ASSERT(mhsm_trace_replay(&reader, &registry, 0) == 102);
+	MUNT_ASSERT(reader.skipped == 1);
+	for (i = 0; i < TEST_TR_NROF_HSMS; i++) {
+		MUNT_ASSERT(test_tr_contexts[i].sum == recorded[i].sum);
+		MUNT_ASSERT(test_tr_contexts[i].nrof_events == recorded[i].nrof_events);
+	}
+
+	/* replay at the original pace */
+	rewind(file);
+	test_tr_setup(&registry);
+	MUNT_ASSERT(mhsm_trace_open_reader(&reader, file) == 0);
+	start = mclk_now();
+	MUNT_ASSERT(mhsm_trace_replay(&reader, &registry, 1) == 102);
+	MUNT_ASSERT(mclk_now() - start >= 2000000);
+	MUNT_ASSERT(test_tr_contexts[0].sum == recorded[0].sum);
+
+	/* timer events are not recorded, so HSMs using timers are refused */
+	rewind(file);
+	test_tr_setup(&registry);
+	MUNT_ASSERT(mhsm_set_timer_callback(test_tr_hsms, test_tr_start_timer) == 0);
+	MUNT_ASSERT(mhsm_trace_open_reader(&reader, file) == 0);
+	MUNT_ASSERT(mhsm_trace_replay(&reader, &registry, 0) == -1);
+	MUNT_ASSERT(test_tr_contexts[0].nrof_events == 0);
+
+	fclose(file);
+
+	return 0;
+}